@@ -8,6 +8,8 @@
 #ifndef ILEXER_H
 #define ILEXER_H
 
+#include "Sci_Position.h"
+
 #ifdef SCI_NAMESPACE
 namespace Scintilla {
 #endif
@@ -18,7 +20,14 @@ namespace Scintilla {
 	#define SCI_METHOD
 #endif
 
-enum { dvOriginal=0 };
+/**
+ * Version returns the interface that a document object implements and each version's
+ * interface derives from the previous one's. An IDocument reporting dvRangePointer is an
+ * IDocumentRangePointer and an IDocumentLargeFile reporting dvRangePointer is an
+ * IDocumentLargeFileRangePointer. Positions are never converted by a cast: a lexer receives
+ * an IDocumentLargeFile only through ILexerLargeFile, as chosen by the lexer's own Version.
+ */
+enum { dvOriginal=0, dvRangePointer=1 };
 
 class IDocument {
 public:
@@ -43,7 +52,70 @@ public:
 	virtual bool SCI_METHOD IsDBCSLeadByte(char ch) const = 0;
 };
 
-enum { lvOriginal=0 };
+/**
+ * IDocuments that return dvRangePointer or later from Version can be read in place.
+ * RangePointer moves the gap when it is inside the range so lexers should only
+ * ask for ranges that do not contain GapPosition and copy the others.
+ */
+class IDocumentRangePointer : public IDocument {
+public:
+	virtual const char * SCI_METHOD BufferPointer() = 0;
+	virtual const char * SCI_METHOD RangePointer(int position, int rangeLength) = 0;
+	virtual int SCI_METHOD GapPosition() const = 0;
+};
+
+/**
+ * Document interface with positions and line numbers that are Sci_Position wide.
+ * Lexers that return lvLargeFile from Version are called through ILexerLargeFile
+ * with this interface so they can process documents larger than 2 gigabytes.
+ */
+class IDocumentLargeFile {
+public:
+	virtual int SCI_METHOD Version() const = 0;
+	virtual void SCI_METHOD SetErrorStatus(int status) = 0;
+	virtual Sci_Position SCI_METHOD Length() const = 0;
+	virtual void SCI_METHOD GetCharRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const = 0;
+	virtual char SCI_METHOD StyleAt(Sci_Position position) const = 0;
+	virtual Sci_Position SCI_METHOD LineFromPosition(Sci_Position position) const = 0;
+	virtual Sci_Position SCI_METHOD LineStart(Sci_Position line) const = 0;
+	virtual int SCI_METHOD GetLevel(Sci_Position line) const = 0;
+	virtual int SCI_METHOD SetLevel(Sci_Position line, int level) = 0;
+	virtual int SCI_METHOD GetLineState(Sci_Position line) const = 0;
+	virtual int SCI_METHOD SetLineState(Sci_Position line, int state) = 0;
+	virtual void SCI_METHOD StartStyling(Sci_Position position, char mask) = 0;
+	virtual bool SCI_METHOD SetStyleFor(Sci_Position length, char style) = 0;
+	virtual bool SCI_METHOD SetStyles(Sci_Position length, const char *styles) = 0;
+	virtual void SCI_METHOD DecorationSetCurrentIndicator(int indicator) = 0;
+	virtual void SCI_METHOD DecorationFillRange(Sci_Position position, int value, Sci_Position fillLength) = 0;
+	virtual void SCI_METHOD ChangeLexerState(Sci_Position start, Sci_Position end) = 0;
+	virtual int SCI_METHOD CodePage() const = 0;
+	virtual bool SCI_METHOD IsDBCSLeadByte(char ch) const = 0;
+};
+
+/**
+ * IDocumentLargeFiles that return dvRangePointer or later from Version can be read in place.
+ */
+class IDocumentLargeFileRangePointer : public IDocumentLargeFile {
+public:
+	virtual const char * SCI_METHOD BufferPointer() = 0;
+	virtual const char * SCI_METHOD RangePointer(Sci_Position position, Sci_Position rangeLength) = 0;
+	virtual Sci_Position SCI_METHOD GapPosition() const = 0;
+};
+
+/**
+ * Builds a document from successive pieces of text, such as blocks read from a file.
+ * Until ConvertToDocument is called the document is not attached to any window so
+ * it may be filled from a thread other than the one that owns the windows.
+ */
+class ILoader {
+public:
+	virtual int SCI_METHOD Release() = 0;
+	// Returns a status code from SC_STATUS_*
+	virtual int SCI_METHOD AddData(const char *data, Sci_Position length) = 0;
+	virtual void * SCI_METHOD ConvertToDocument() = 0;
+};
+
+enum { lvOriginal=0, lvLargeFile=1 };
 
 class ILexer {
 public:
@@ -56,6 +128,16 @@ public:
 	virtual void * SCI_METHOD PrivateCall(int operation, void *pointer) = 0;
 };
 
+/**
+ * Lexers that return lvLargeFile from Version implement these methods which are
+ * called instead of Lex and Fold.
+ */
+class ILexerLargeFile : public ILexer {
+public:
+	virtual void SCI_METHOD LexLargeFile(Sci_PositionU startPos, Sci_Position lengthDoc, int initStyle, IDocumentLargeFile *pAccess) = 0;
+	virtual void SCI_METHOD FoldLargeFile(Sci_PositionU startPos, Sci_Position lengthDoc, int initStyle, IDocumentLargeFile *pAccess) = 0;
+};
+
 #ifdef SCI_NAMESPACE
 }
 #endif
@@ -0,0 +1,24 @@
+// Scintilla source code edit control
+/** @file Sci_Position.h
+ ** Define the Sci_Position type used for positions and line numbers in the document
+ ** and in the interface to lexers.
+ **/
+// Copyright 2010 by Neil Hodgson <neilh@scintilla.org>
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef SCI_POSITION_H
+#define SCI_POSITION_H
+
+#include <stddef.h>
+
+// Define SCI_LARGE_FILE_SUPPORT to hold documents larger than 2 gigabytes.
+// This widens positions and line numbers in the storage layer and document.
+#ifdef SCI_LARGE_FILE_SUPPORT
+typedef ptrdiff_t Sci_Position;
+typedef size_t Sci_PositionU;
+#else
+typedef int Sci_Position;
+typedef unsigned int Sci_PositionU;
+#endif
+
+#endif
@@ -265,6 +265,12 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SCI_SETLINESTATE 2092
 #define SCI_GETLINESTATE 2093
 #define SCI_GETMAXLINESTATE 2094
+#define SC_IDLESTYLING_NONE 0
+#define SC_IDLESTYLING_TOVISIBLE 1
+#define SC_IDLESTYLING_AFTERVISIBLE 2
+#define SC_IDLESTYLING_ALL 3
+#define SCI_SETIDLESTYLING 2627
+#define SCI_GETIDLESTYLING 2628
 #define SCI_GETCARETLINEVISIBLE 2095
 #define SCI_SETCARETLINEVISIBLE 2096
 #define SCI_GETCARETLINEBACK 2097
@@ -388,8 +394,12 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SCI_REPLACETARGET 2194
 #define SCI_REPLACETARGETRE 2195
 #define SCI_SEARCHINTARGET 2197
+#define SCI_SEARCHALLINTARGET 2621
+#define SCI_COUNTINTARGET 2622
 #define SCI_SETSEARCHFLAGS 2198
 #define SCI_GETSEARCHFLAGS 2199
+#define SCI_GETREGEXCACHEHITS 2623
+#define SCI_GETREGEXCACHEMISSES 2624
 #define SCI_CALLTIPSHOW 2200
 #define SCI_CALLTIPCANCEL 2201
 #define SCI_CALLTIPACTIVE 2202
@@ -580,6 +590,7 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SCI_CREATEDOCUMENT 2375
 #define SCI_ADDREFDOCUMENT 2376
 #define SCI_RELEASEDOCUMENT 2377
+#define SCI_CREATELOADER 2631
 #define SCI_GETMODEVENTMASK 2378
 #define SCI_SETFOCUS 2380
 #define SCI_GETFOCUS 2381
@@ -695,8 +706,16 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SCI_INDICATOREND 2509
 #define SCI_SETPOSITIONCACHE 2514
 #define SCI_GETPOSITIONCACHE 2515
+#define SC_POSITIONCACHE_HITS 0
+#define SC_POSITIONCACHE_MISSES 1
+#define SC_POSITIONCACHE_EVICTIONS 2
+#define SC_POSITIONCACHE_ENTRIES 3
+#define SCI_GETPOSITIONCACHESTATISTIC 2629
 #define SCI_COPYALLOWLINE 2519
 #define SCI_GETCHARACTERPOINTER 2520
+#define SCI_GETRANGEPOINTER 2625
+#define SCI_GETGAPPOSITION 2626
+#define SCI_STREAMTEXT 2630
 #define SCI_SETKEYSUNICODE 2521
 #define SCI_GETKEYSUNICODE 2522
 #define SCI_INDICSETALPHA 2523
@@ -784,6 +803,9 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SCI_ROTATESELECTION 2606
 #define SCI_SWAPMAINANCHORCARET 2607
 #define SCI_CHANGELEXERSTATE 2617
+#define SCI_ATTACHREADONLYTEXT 2618
+#define SCI_SETUNDOMEMORYLIMIT 2619
+#define SCI_GETUNDOMEMORYLIMIT 2620
 #define SCI_STARTRECORD 3001
 #define SCI_STOPRECORD 3002
 #define SCI_SETLEXER 4001
@@ -820,7 +842,8 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SC_MOD_CHANGEANNOTATION 0x20000
 #define SC_MOD_CONTAINER 0x40000
 #define SC_MOD_LEXERSTATE 0x80000
-#define SC_MODEVENTMASKALL 0xFFFFF
+#define SC_MOD_CHANGELINEENDS 0x100000
+#define SC_MODEVENTMASKALL 0x1FFFFF
 #define SCEN_CHANGE 768
 #define SCEN_SETFOCUS 512
 #define SCEN_KILLFOCUS 256
@@ -901,6 +924,16 @@ struct Sci_TextToFind {
 	struct Sci_CharacterRange chrgText;
 };
 
+/* Called by SCI_STREAMTEXT with successive pieces of a range of text.
+ * Return 0 to continue or any other value to stop. */
+typedef int (*Sci_TextStreamFn)(void *context, const char *text, long length);
+
+struct Sci_TextStream {
+	struct Sci_CharacterRange chrg;
+	Sci_TextStreamFn fnStream;
+	void *context;
+};
+
 #define CharacterRange Sci_CharacterRange
 #define TextRange Sci_TextRange
 #define TextToFind Sci_TextToFind
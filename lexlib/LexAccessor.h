@@ -15,6 +15,7 @@ namespace Scintilla {
 class LexAccessor {
 private:
 	IDocument *pAccess;
+	IDocumentRangePointer *pAccessRange;	///< Set when the text can be read in place
 	enum {extremePosition=0x7FFFFFFF};
 	/** @a bufferSize is a trade off between time taken to copy the characters
 	 * and retrieval overhead.
@@ -22,6 +23,7 @@ private:
 	 * in case there is some backtracking. */
 	enum {bufferSize=4000, slopSize=bufferSize/8};
 	char buf[bufferSize+1];
+	const char *text;	///< buf or the document text from startPos to endPos
 	int startPos;
 	int endPos;
 	int codePage;
@@ -35,6 +37,21 @@ private:
 	int startPosStyling;
 
 	void Fill(int position) {
+		if (pAccessRange) {
+			// Read in place from position up to the gap or the end, or back to the start
+			const int gapPosition = pAccessRange->GapPosition();
+			if ((position >= 0) && (position < lenDoc)) {
+				if (position < gapPosition) {
+					startPos = 0;
+					endPos = (gapPosition < lenDoc) ? gapPosition : lenDoc;
+				} else {
+					startPos = gapPosition;
+					endPos = lenDoc;
+				}
+				text = pAccessRange->RangePointer(startPos, endPos-startPos);
+				return;
+			}
+		}
 		startPos = position - slopSize;
 		if (startPos + bufferSize > lenDoc)
 			startPos = lenDoc - bufferSize;
@@ -46,20 +63,29 @@ private:
 
 		pAccess->GetCharRange(buf, startPos, endPos-startPos);
 		buf[endPos-startPos] = '\0';
+		text = buf;
+	}
+	/// Any IDocument call that changes the document may send a notification and the
+	/// container's handler may move the gap or edit, so text read in place is read again.
+	void Notified() {
+		if (text != buf)
+			startPos = extremePosition;
 	}
 
 public:
 	LexAccessor(IDocument *pAccess_) :
-		pAccess(pAccess_), startPos(extremePosition), endPos(0),
+		pAccess(pAccess_), pAccessRange(0), text(buf), startPos(extremePosition), endPos(0),
 		codePage(pAccess->CodePage()), lenDoc(pAccess->Length()),
 		mask(127), validLen(0), chFlags(0), chWhile(0),
 		startSeg(0), startPosStyling(0) {
+		if (pAccess->Version() >= dvRangePointer)
+			pAccessRange = static_cast<IDocumentRangePointer *>(pAccess);
 	}
 	char operator[](int position) {
 		if (position < startPos || position >= endPos) {
 			Fill(position);
 		}
-		return buf[position - startPos];
+		return text[position - startPos];
 	}
 	/** Safe version of operator[], returning a defined value for invalid position. */
 	char SafeGetCharAt(int position, char chDefault=' ') {
@@ -70,7 +96,7 @@ public:
 				return chDefault;
 			}
 		}
-		return buf[position - startPos];
+		return text[position - startPos];
 	}
 	bool IsLeadByte(char ch) {
 		return pAccess->IsDBCSLeadByte(ch);
@@ -100,6 +126,7 @@ public:
 		return lenDoc;
 	}
 	void Flush() {
+		// Also drops text read in place as SetStyles sends SC_MOD_CHANGESTYLE
 		startPos = extremePosition;
 		if (validLen > 0) {
 			pAccess->SetStyles(validLen, styleBuf);
@@ -111,13 +138,16 @@ public:
 		return pAccess->GetLineState(line);
 	}
 	int SetLineState(int line, int state) {
-		return pAccess->SetLineState(line, state);
+		const int stateOld = pAccess->SetLineState(line, state);
+		Notified();
+		return stateOld;
 	}
 	// Style setting
 	void StartAt(unsigned int start, char chMask=31) {
 		// Store the mask specified for use with StyleAt.
 		mask = chMask;
 		pAccess->StartStyling(start, chMask);
+		Notified();
 		startPosStyling = start;
 	}
 	void SetFlags(char chFlags_, char chWhile_) {
@@ -143,6 +173,7 @@ public:
 			if (validLen + (pos - startSeg + 1) >= bufferSize) {
 				// Too big for buffer so send directly
 				pAccess->SetStyleFor(pos - startSeg + 1, static_cast<char>(chAttr));
+				Notified();
 			} else {
 				if (chAttr != chWhile)
 					chFlags = 0;
@@ -157,14 +188,17 @@ public:
 	}
 	void SetLevel(int line, int level) {
 		pAccess->SetLevel(line, level);
+		Notified();
 	}
 	void IndicatorFill(int start, int end, int indicator, int value) {
 		pAccess->DecorationSetCurrentIndicator(indicator);
 		pAccess->DecorationFillRange(start, value, end - start);
+		Notified();
 	}
 
 	void ChangeLexerState(int start, int end) {
 		pAccess->ChangeLexerState(start, end);
+		Notified();
 	}
 };
 
@@ -81,9 +81,25 @@ void WordList::Clear() {
 		delete []list;
 		delete []words;
 	}
+	delete []table;
+	delete []hashes;
 	words = 0;
 	list = 0;
 	len = 0;
+	table = 0;
+	hashes = 0;
+	tableMask = 0;
+}
+
+/// FNV-1a hash of a NUL terminated string.
+static inline unsigned int HashWord(const char *s) {
+	unsigned int hash = 2166136261u;
+	while (*s) {
+		hash ^= static_cast<unsigned char>(*s);
+		hash *= 16777619u;
+		s++;
+	}
+	return hash;
 }
 
 extern "C" int cmpString(const void *a1, const void *a2) {
@@ -108,29 +124,35 @@ void WordList::Set(const char *s) {
 		unsigned char indexChar = words[l][0];
 		starts[indexChar] = l;
 	}
+	// Hash every word into a table at most half full so that a lookup of a word
+	// not in the list usually stops at the first or second slot.
+	unsigned int tableSize = 16;
+	while (tableSize < static_cast<unsigned int>(len) * 2)
+		tableSize *= 2;
+	tableMask = tableSize - 1;
+	table = new int[tableSize];
+	for (unsigned int t = 0; t < tableSize; t++)
+		table[t] = -1;
+	hashes = new unsigned int[len];
+	for (int w = 0; w < len; w++) {
+		hashes[w] = HashWord(words[w]);
+		unsigned int slot = hashes[w] & tableMask;
+		while (table[slot] >= 0)
+			slot = (slot + 1) & tableMask;
+		table[slot] = w;
+	}
 }
 
 bool WordList::InList(const char *s) const {
 	if (0 == words)
 		return false;
-	unsigned char firstChar = s[0];
-	int j = starts[firstChar];
-	if (j >= 0) {
-		while ((unsigned char)words[j][0] == firstChar) {
-			if (s[1] == words[j][1]) {
-				const char *a = words[j] + 1;
-				const char *b = s + 1;
-				while (*a && *a == *b) {
-					a++;
-					b++;
-				}
-				if (!*a && !*b)
-					return true;
-			}
-			j++;
-		}
+	const unsigned int hash = HashWord(s);
+	for (unsigned int slot = hash & tableMask; table[slot] >= 0; slot = (slot + 1) & tableMask) {
+		const int w = table[slot];
+		if ((hashes[w] == hash) && (strcmp(words[w], s) == 0))
+			return true;
 	}
-	j = starts['^'];
+	int j = starts['^'];
 	if (j >= 0) {
 		while (words[j][0] == '^') {
 			const char *a = words[j] + 1;
@@ -22,8 +22,12 @@ public:
 	int len;
 	bool onlyLineEnds;	///< Delimited by any white space or only line ends
 	int starts[256];
+	int *table;	///< Open addressed hash table of indices into words, -1 for empty slots
+	unsigned int *hashes;	///< Hash of each word
+	unsigned int tableMask;
 	WordList(bool onlyLineEnds_ = false) :
-		words(0), list(0), len(0), onlyLineEnds(onlyLineEnds_)
+		words(0), list(0), len(0), onlyLineEnds(onlyLineEnds_),
+		table(0), hashes(0), tableMask(0)
 		{}
 	~WordList() { Clear(); }
 	operator bool() const { return len ? true : false; }
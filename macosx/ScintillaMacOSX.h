@@ -19,6 +19,7 @@
 #include <vector>
 
 #include "Platform.h"
+#include "Sci_Position.h"
 #include "Scintilla.h"
 #include "PlatMacOSX.h"
 
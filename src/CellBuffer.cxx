@@ -10,8 +10,11 @@
 #include <stdlib.h>
 #include <stdarg.h>
 
+#include <algorithm>
+
 #include "Platform.h"
 
+#include "Sci_Position.h"
 #include "Scintilla.h"
 #include "SplitVector.h"
 #include "Partitioning.h"
@@ -40,11 +43,11 @@ void LineVector::SetPerLine(PerLine *pl) {
 	perLine = pl;
 }
 
-void LineVector::InsertText(int line, int delta) {
+void LineVector::InsertText(Sci_Position line, Sci_Position delta) {
 	starts.InsertText(line, delta);
 }
 
-void LineVector::InsertLine(int line, int position, bool lineStart) {
+void LineVector::InsertLine(Sci_Position line, Sci_Position position, bool lineStart) {
 	starts.InsertPartition(line, position);
 	if (perLine) {
 		if ((line > 0) && lineStart)
@@ -53,18 +56,27 @@ void LineVector::InsertLine(int line, int position, bool lineStart) {
 	}
 }
 
-void LineVector::SetLineStart(int line, int position) {
+void LineVector::InsertLines(Sci_Position line, const Sci_Position *positions, Sci_Position lines, bool lineStart) {
+	starts.InsertPartitions(line, positions, lines);
+	if (perLine) {
+		if ((line > 0) && lineStart)
+			line--;
+		perLine->InsertLines(line, lines);
+	}
+}
+
+void LineVector::SetLineStart(Sci_Position line, Sci_Position position) {
 	starts.SetPartitionStartPosition(line, position);
 }
 
-void LineVector::RemoveLine(int line) {
+void LineVector::RemoveLine(Sci_Position line) {
 	starts.RemovePartition(line);
 	if (perLine) {
 		perLine->RemoveLine(line);
 	}
 }
 
-int LineVector::LineFromPosition(int pos) const {
+Sci_Position LineVector::LineFromPosition(Sci_Position pos) const {
 	return starts.PartitionFromPosition(pos);
 }
 
@@ -76,12 +88,7 @@ Action::Action() {
 	mayCoalesce = false;
 }
 
-Action::~Action() {
-	Destroy();
-}
-
-void Action::Create(actionType at_, int position_, char *data_, int lenData_, bool mayCoalesce_) {
-	delete []data;
+void Action::Create(actionType at_, Sci_Position position_, const char *data_, Sci_Position lenData_, bool mayCoalesce_) {
 	position = position_;
 	at = at_;
 	data = data_;
@@ -89,28 +96,6 @@ void Action::Create(actionType at_, int position_, char *data_, int lenData_, bo
 	mayCoalesce = mayCoalesce_;
 }
 
-void Action::Destroy() {
-	delete []data;
-	data = 0;
-}
-
-void Action::Grab(Action *source) {
-	delete []data;
-
-	position = source->position;
-	at = source->at;
-	data = source->data;
-	lenData = source->lenData;
-	mayCoalesce = source->mayCoalesce;
-
-	// Ownership of source data transferred to this
-	source->position = 0;
-	source->at = startAction;
-	source->data = 0;
-	source->lenData = 0;
-	source->mayCoalesce = true;
-}
-
 // The undo history stores a sequence of user operations that represent the user's view of the
 // commands executed on the text.
 // Each user operation contains a sequence of text insertion and text deletion actions.
@@ -129,14 +114,20 @@ void Action::Grab(Action *source) {
 // unless it looks as if the new action is caused by the user typing or deleting a stream of text.
 // Sequences that look like typing or deletion are coalesced into a single user operation.
 
+static const int actionsInitial = 100;
+
 UndoHistory::UndoHistory() {
 
-	lenActions = 100;
+	lenActions = actionsInitial;
 	actions = new Action[lenActions];
 	maxAction = 0;
 	currentAction = 0;
 	undoSequenceDepth = 0;
 	savePoint = 0;
+	blockFirst = 0;
+	blockLast = 0;
+	memoryBlocks = 0;
+	memoryLimit = 0;
 
 	actions[currentAction].Create(startAction);
 }
@@ -144,6 +135,130 @@ UndoHistory::UndoHistory() {
 UndoHistory::~UndoHistory() {
 	delete []actions;
 	actions = 0;
+	FreeTextBlocks(blockFirst);
+}
+
+static const Sci_Position textBlockInitial = 1024;
+static const Sci_Position textBlockMaximum = 1024 * 1024;
+
+char *UndoHistory::AllocateText(Sci_Position length) {
+	if (!blockLast || ((blockLast->size - blockLast->used) < length)) {
+		Sci_Position size = blockLast ? blockLast->size * 2 : textBlockInitial;
+		if (size > textBlockMaximum)
+			size = textBlockMaximum;
+		// A block larger than the part of the limit dropped at once could never be freed
+		if ((memoryLimit > 0) && (size > memoryLimit / 8))
+			size = std::max(memoryLimit / 8, textBlockInitial);
+		if (size < length)
+			size = length;
+		UndoTextBlock *block = new UndoTextBlock;
+		block->next = 0;
+		block->text = new char[size];
+		block->size = size;
+		block->used = 0;
+		if (blockLast)
+			blockLast->next = block;
+		else
+			blockFirst = block;
+		blockLast = block;
+		memoryBlocks += size;
+	}
+	char *text = blockLast->text + blockLast->used;
+	blockLast->used += length;
+	return text;
+}
+
+void UndoHistory::FreeTextBlocks(UndoTextBlock *block) {
+	while (block) {
+		UndoTextBlock *next = block->next;
+		memoryBlocks -= block->size;
+		delete []block->text;
+		delete block;
+		block = next;
+	}
+}
+
+// Actions from act onwards are being replaced so the space used by their text can be reused.
+void UndoHistory::DiscardTextFrom(int act) {
+	for (; act <= maxAction; act++) {
+		if (actions[act].data) {
+			const char *textDiscard = actions[act].data;
+			for (UndoTextBlock *block = blockFirst; block; block = block->next) {
+				if ((textDiscard >= block->text) && (textDiscard < (block->text + block->size))) {
+					block->used = textDiscard - block->text;
+					FreeTextBlocks(block->next);
+					block->next = 0;
+					blockLast = block;
+					return;
+				}
+			}
+			return;
+		}
+	}
+}
+
+// Drop whole groups of actions before the current one until a quarter of the limit is
+// free so that the remaining actions are moved down infrequently.
+void UndoHistory::DropOldestGroups() {
+	if ((memoryLimit <= 0) || (MemoryUse() <= memoryLimit))
+		return;
+	const Sci_Position memoryTarget = memoryLimit - memoryLimit / 4;
+	int actDrop = 0;	// The start action ending the last group dropped
+	UndoTextBlock *blockKeep = blockFirst;	// The block holding the oldest text kept
+	Sci_Position memoryFreed = 0;	// Size of the blocks before blockKeep
+	int actText = 0;	// The first action after the dropped groups which has text
+	int act = 1;
+	while (act < currentAction) {
+		while ((act < currentAction) && (actions[act].at != startAction))
+			act++;
+		if (act >= currentAction)
+			break;
+		if (actText <= act) {
+			for (actText = act + 1; (actText <= maxAction) && !actions[actText].data; actText++)
+				;
+		}
+		const char *textKeep = (actText <= maxAction) ? actions[actText].data : 0;
+		// Text is freed in whole blocks and the last block is always kept
+		while ((blockKeep != blockLast) &&
+			(!textKeep || (textKeep < blockKeep->text) || (textKeep >= (blockKeep->text + blockKeep->size)))) {
+			memoryFreed += blockKeep->size;
+			blockKeep = blockKeep->next;
+		}
+		actDrop = act;
+		const Sci_Position memoryAfter = memoryBlocks - memoryFreed +
+			(maxAction + 1 - actDrop) * static_cast<Sci_Position>(sizeof(Action));
+		if (memoryAfter <= memoryTarget)
+			break;
+		act++;
+	}
+	if (actDrop == 0)
+		return;
+	for (act = actDrop; act <= maxAction; act++)
+		actions[act - actDrop] = actions[act];
+	maxAction -= actDrop;
+	currentAction -= actDrop;
+	if (savePoint >= actDrop)
+		savePoint -= actDrop;
+	else
+		savePoint = -1;
+	while (blockFirst != blockKeep) {
+		UndoTextBlock *block = blockFirst;
+		blockFirst = block->next;
+		block->next = 0;
+		FreeTextBlocks(block);
+	}
+	// Give back the action array when it is mostly unused
+	if ((lenActions > actionsInitial) && ((maxAction + 1) * 4 < lenActions))
+		ResizeActions(std::max((maxAction + 1) * 2, actionsInitial));
+}
+
+void UndoHistory::ResizeActions(int lenActionsNew) {
+	Action *actionsNew = new Action[lenActionsNew];
+	for (int act = 0; act <= maxAction; act++)
+		actionsNew[act] = actions[act];
+	delete []actions;
+	lenActions = lenActionsNew;
+	actions = actionsNew;
 }
 
 void UndoHistory::EnsureUndoRoom() {
@@ -151,17 +266,11 @@ void UndoHistory::EnsureUndoRoom() {
 	// as two actions may be created by the calling function
 	if (currentAction >= (lenActions - 2)) {
 		// Run out of undo nodes so extend the array
-		int lenActionsNew = lenActions * 2;
-		Action *actionsNew = new Action[lenActionsNew];
-		for (int act = 0; act <= currentAction; act++)
-			actionsNew[act].Grab(&actions[act]);
-		delete []actions;
-		lenActions = lenActionsNew;
-		actions = actionsNew;
+		ResizeActions(lenActions * 2);
 	}
 }
 
-void UndoHistory::AppendAction(actionType at, int position, char *data, int lengthData,
+char *UndoHistory::AppendAction(actionType at, Sci_Position position, Sci_Position lengthData,
 	bool &startSequence, bool mayCoalesce) {
 	EnsureUndoRoom();
 	//Platform::DebugPrintf("%% %d action %d %d %d\n", at, position, lengthData, currentAction);
@@ -225,10 +334,14 @@ void UndoHistory::AppendAction(actionType at, int position, char *data, int leng
 		currentAction++;
 	}
 	startSequence = oldCurrentAction != currentAction;
+	DiscardTextFrom(currentAction);
+	char *data = (lengthData > 0) ? AllocateText(lengthData) : 0;
 	actions[currentAction].Create(at, position, data, lengthData, mayCoalesce);
 	currentAction++;
 	actions[currentAction].Create(startAction);
 	maxAction = currentAction;
+	DropOldestGroups();
+	return data;
 }
 
 void UndoHistory::BeginUndoAction() {
@@ -263,14 +376,30 @@ void UndoHistory::DropUndoSequence() {
 }
 
 void UndoHistory::DeleteUndoHistory() {
-	for (int i = 1; i < maxAction; i++)
-		actions[i].Destroy();
+	FreeTextBlocks(blockFirst);
+	blockFirst = 0;
+	blockLast = 0;
 	maxAction = 0;
 	currentAction = 0;
+	if (lenActions > actionsInitial)
+		ResizeActions(actionsInitial);
 	actions[currentAction].Create(startAction);
 	savePoint = 0;
 }
 
+void UndoHistory::SetMemoryLimit(Sci_Position limit) {
+	memoryLimit = limit;
+	DropOldestGroups();
+}
+
+Sci_Position UndoHistory::GetMemoryLimit() const {
+	return memoryLimit;
+}
+
+Sci_Position UndoHistory::MemoryUse() const {
+	return memoryBlocks + (maxAction + 1) * static_cast<Sci_Position>(sizeof(Action));
+}
+
 void UndoHistory::SetSavePoint() {
 	savePoint = currentAction;
 }
@@ -331,53 +460,88 @@ void UndoHistory::CompletedRedoStep() {
 
 CellBuffer::CellBuffer() {
 	readOnly = false;
+	textExternal = 0;
+	lengthExternal = 0;
 	collectingUndo = true;
 }
 
 CellBuffer::~CellBuffer() {
 }
 
-char CellBuffer::CharAt(int position) const {
+char CellBuffer::CharAt(Sci_Position position) const {
+	if (textExternal) {
+		if ((position < 0) || (position >= lengthExternal))
+			return 0;
+		return textExternal[position];
+	}
 	return substance.ValueAt(position);
 }
 
-void CellBuffer::GetCharRange(char *buffer, int position, int lengthRetrieve) const {
+void CellBuffer::GetCharRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const {
 	if (lengthRetrieve < 0)
 		return;
 	if (position < 0)
 		return;
-	if ((position + lengthRetrieve) > substance.Length()) {
-		Platform::DebugPrintf("Bad GetCharRange %d for %d of %d\n", position,
-		                      lengthRetrieve, substance.Length());
+	if ((position + lengthRetrieve) > Length()) {
+		Platform::DebugPrintf("Bad GetCharRange %d for %d of %d\n", static_cast<int>(position),
+		                      static_cast<int>(lengthRetrieve), static_cast<int>(Length()));
 		return;
 	}
-
-	for (int i=0; i<lengthRetrieve; i++) {
-		*buffer++ = substance.ValueAt(position + i);
+	if (textExternal) {
+		memcpy(buffer, textExternal + position, lengthRetrieve);
+		return;
 	}
+
+	substance.GetRange(buffer, position, lengthRetrieve);
 }
 
-char CellBuffer::StyleAt(int position) const {
+char CellBuffer::StyleAt(Sci_Position position) const {
 	return style.ValueAt(position);
 }
 
 const char *CellBuffer::BufferPointer() {
+	if (textExternal)
+		return textExternal;
 	return substance.BufferPointer();
 }
 
+const char *CellBuffer::SegmentPointer(Sci_Position position, Sci_Position &lengthSegment) const {
+	if (textExternal) {
+		if ((position < 0) || (position > lengthExternal)) {
+			lengthSegment = 0;
+			return textExternal;
+		}
+		lengthSegment = lengthExternal - position;
+		return textExternal + position;
+	}
+	return substance.SegmentPointer(position, lengthSegment);
+}
+
+const char *CellBuffer::RangePointer(Sci_Position position, Sci_Position rangeLength) {
+	if (textExternal) {
+		if ((position < 0) || (rangeLength < 0) || (position + rangeLength > lengthExternal))
+			return 0;
+		return textExternal + position;
+	}
+	return substance.RangePointer(position, rangeLength);
+}
+
+// Attached text has no gap so the end is reported
+Sci_Position CellBuffer::GapPosition() const {
+	if (textExternal)
+		return lengthExternal;
+	return substance.GapPosition();
+}
+
 // The char* returned is to an allocation owned by the undo history
-const char *CellBuffer::InsertString(int position, const char *s, int insertLength, bool &startSequence) {
+const char *CellBuffer::InsertString(Sci_Position position, const char *s, Sci_Position insertLength, bool &startSequence) {
 	char *data = 0;
 	// InsertString and DeleteChars are the bottleneck though which all changes occur
-	if (!readOnly) {
+	if (!IsReadOnly()) {
 		if (collectingUndo) {
 			// Save into the undo/redo stack, but only the characters - not the formatting
-			// This takes up about half load time
-			data = new char[insertLength];
-			for (int i = 0; i < insertLength; i++) {
-				data[i] = s[i];
-			}
-			uh.AppendAction(insertAction, position, data, insertLength, startSequence);
+			data = uh.AppendAction(insertAction, position, insertLength, startSequence);
+			memcpy(data, s, insertLength);
 		}
 
 		BasicInsertString(position, s, insertLength);
@@ -385,8 +549,10 @@ const char *CellBuffer::InsertString(int position, const char *s, int insertLeng
 	return data;
 }
 
-bool CellBuffer::SetStyleAt(int position, char styleValue, char mask) {
+bool CellBuffer::SetStyleAt(Sci_Position position, char styleValue, char mask) {
 	styleValue &= mask;
+	if (textExternal && (position < lengthExternal))
+		style.EnsureLength(position + 1);
 	char curVal = style.ValueAt(position);
 	if ((curVal & mask) != styleValue) {
 		style.SetValueAt(position, static_cast<char>((curVal & ~mask) | styleValue));
@@ -396,8 +562,10 @@ bool CellBuffer::SetStyleAt(int position, char styleValue, char mask) {
 	}
 }
 
-bool CellBuffer::SetStyleFor(int position, int lengthStyle, char styleValue, char mask) {
+bool CellBuffer::SetStyleFor(Sci_Position position, Sci_Position lengthStyle, char styleValue, char mask) {
 	bool changed = false;
+	if (textExternal && (position + lengthStyle <= lengthExternal))
+		style.EnsureLength(position + lengthStyle);
 	PLATFORM_ASSERT(lengthStyle == 0 ||
 		(lengthStyle > 0 && lengthStyle + position <= style.Length()));
 	while (lengthStyle--) {
@@ -412,18 +580,15 @@ bool CellBuffer::SetStyleFor(int position, int lengthStyle, char styleValue, cha
 }
 
 // The char* returned is to an allocation owned by the undo history
-const char *CellBuffer::DeleteChars(int position, int deleteLength, bool &startSequence) {
+const char *CellBuffer::DeleteChars(Sci_Position position, Sci_Position deleteLength, bool &startSequence) {
 	// InsertString and DeleteChars are the bottleneck though which all changes occur
 	PLATFORM_ASSERT(deleteLength > 0);
 	char *data = 0;
-	if (!readOnly) {
+	if (!IsReadOnly()) {
 		if (collectingUndo) {
 			// Save into the undo/redo stack, but only the characters - not the formatting
-			data = new char[deleteLength];
-			for (int i = 0; i < deleteLength; i++) {
-				data[i] = substance.ValueAt(position + i);
-			}
-			uh.AppendAction(removeAction, position, data, deleteLength, startSequence);
+			data = uh.AppendAction(removeAction, position, deleteLength, startSequence);
+			substance.GetRange(data, position, deleteLength);
 		}
 
 		BasicDeleteChars(position, deleteLength);
@@ -431,24 +596,65 @@ const char *CellBuffer::DeleteChars(int position, int deleteLength, bool &startS
 	return data;
 }
 
-int CellBuffer::Length() const {
+void CellBuffer::ChangeLineEnds(Sci_Position position, char *ends, Sci_Position lines, bool &startSequence) {
+	if (!IsReadOnly()) {
+		BasicChangeLineEnds(position, ends, lines);
+		if (collectingUndo) {
+			char *data = uh.AppendAction(lineEndsAction, position, lines, startSequence, false);
+			memcpy(data, ends, lines);
+		}
+	}
+}
+
+int CellBuffer::LineEndMode(Sci_Position line) const {
+	if ((line < 0) || (line >= Lines() - 1))
+		return -1;
+	const Sci_Position lineEnd = LineStart(line + 1);
+	if (CharAt(lineEnd - 1) == '\r')
+		return SC_EOL_CR;
+	if ((lineEnd - 2 >= LineStart(line)) && (CharAt(lineEnd - 2) == '\r'))
+		return SC_EOL_CRLF;
+	return SC_EOL_LF;
+}
+
+Sci_Position CellBuffer::Length() const {
+	if (textExternal)
+		return lengthExternal;
 	return substance.Length();
 }
 
-void CellBuffer::Allocate(int newSize) {
+void CellBuffer::Allocate(Sci_Position newSize) {
 	substance.ReAllocate(newSize);
 	style.ReAllocate(newSize);
 }
 
+/**
+ * Replace the contents and undo history with text owned by the caller which must
+ * remain valid until detached by attaching other text or a null pointer.
+ * Only the line starts are computed; the text is not copied.
+ */
+void CellBuffer::AttachExternal(const char *s, Sci_Position length) {
+	substance.DeleteAll();
+	style.DeleteAll();
+	lv.Init();
+	uh.DeleteUndoHistory();
+	textExternal = s;
+	lengthExternal = s ? length : 0;
+	if (lengthExternal <= 0)
+		return;
+	lv.InsertText(0, lengthExternal);
+	AddLineStarts(1, 0, s, lengthExternal, '\0', true);
+}
+
 void CellBuffer::SetPerLine(PerLine *pl) {
 	lv.SetPerLine(pl);
 }
 
-int CellBuffer::Lines() const {
+Sci_Position CellBuffer::Lines() const {
 	return lv.Lines();
 }
 
-int CellBuffer::LineStart(int line) const {
+Sci_Position CellBuffer::LineStart(Sci_Position line) const {
 	if (line < 0)
 		return 0;
 	else if (line >= Lines())
@@ -458,7 +664,7 @@ int CellBuffer::LineStart(int line) const {
 }
 
 bool CellBuffer::IsReadOnly() const {
-	return readOnly;
+	return readOnly || (textExternal != 0);
 }
 
 void CellBuffer::SetReadOnly(bool set) {
@@ -475,15 +681,56 @@ bool CellBuffer::IsSavePoint() {
 
 // Without undo
 
-void CellBuffer::InsertLine(int line, int position, bool lineStart) {
+void CellBuffer::InsertLine(Sci_Position line, Sci_Position position, bool lineStart) {
 	lv.InsertLine(line, position, lineStart);
 }
 
-void CellBuffer::RemoveLine(int line) {
+void CellBuffer::RemoveLine(Sci_Position line) {
 	lv.RemoveLine(line);
 }
 
-void CellBuffer::BasicInsertString(int position, const char *s, int insertLength) {
+/**
+ * Add a line for each line end in s which has been inserted at position.
+ * Line starts are gathered into blocks so the line index and per line data
+ * are extended once per block rather than once per line.
+ * @return the line after the last line added.
+ */
+Sci_Position CellBuffer::AddLineStarts(Sci_Position lineInsert, Sci_Position position, const char *s, Sci_Position insertLength,
+	char chPrev, bool atLineStart) {
+	const int blockSize = 1024;
+	Sci_Position starts[blockSize];
+	int startsUsed = 0;
+	for (Sci_Position i = 0; i < insertLength; i++) {
+		const char ch = s[i];
+		if (static_cast<unsigned char>(ch) <= '\r') {
+			if (ch == '\r') {
+				starts[startsUsed++] = (position + i) + 1;
+			} else if (ch == '\n') {
+				if (chPrev != '\r') {
+					starts[startsUsed++] = (position + i) + 1;
+				} else if (startsUsed > 0) {
+					// Patch up what was end of line
+					starts[startsUsed - 1] = (position + i) + 1;
+				} else {
+					lv.SetLineStart(lineInsert - 1, (position + i) + 1);
+				}
+			}
+			if (startsUsed == blockSize) {
+				lv.InsertLines(lineInsert, starts, startsUsed, atLineStart);
+				lineInsert += startsUsed;
+				startsUsed = 0;
+			}
+		}
+		chPrev = ch;
+	}
+	if (startsUsed > 0) {
+		lv.InsertLines(lineInsert, starts, startsUsed, atLineStart);
+		lineInsert += startsUsed;
+	}
+	return lineInsert;
+}
+
+void CellBuffer::BasicInsertString(Sci_Position position, const char *s, Sci_Position insertLength) {
 	if (insertLength == 0)
 		return;
 	PLATFORM_ASSERT(insertLength > 0);
@@ -491,7 +738,7 @@ void CellBuffer::BasicInsertString(int position, const char *s, int insertLength
 	substance.InsertFromArray(position, s, 0, insertLength);
 	style.InsertValue(position, insertLength, 0);
 
-	int lineInsert = lv.LineFromPosition(position) + 1;
+	Sci_Position lineInsert = lv.LineFromPosition(position) + 1;
 	bool atLineStart = lv.LineStart(lineInsert-1) == position;
 	// Point all the lines after the insertion point further along in the buffer
 	lv.InsertText(lineInsert-1, insertLength);
@@ -502,33 +749,17 @@ void CellBuffer::BasicInsertString(int position, const char *s, int insertLength
 		InsertLine(lineInsert, position, false);
 		lineInsert++;
 	}
-	char ch = ' ';
-	for (int i = 0; i < insertLength; i++) {
-		ch = s[i];
-		if (ch == '\r') {
-			InsertLine(lineInsert, (position + i) + 1, atLineStart);
-			lineInsert++;
-		} else if (ch == '\n') {
-			if (chPrev == '\r') {
-				// Patch up what was end of line
-				lv.SetLineStart(lineInsert - 1, (position + i) + 1);
-			} else {
-				InsertLine(lineInsert, (position + i) + 1, atLineStart);
-				lineInsert++;
-			}
-		}
-		chPrev = ch;
-	}
+	lineInsert = AddLineStarts(lineInsert, position, s, insertLength, chPrev, atLineStart);
 	// Joining two lines where last insertion is cr and following substance starts with lf
 	if (chAfter == '\n') {
-		if (ch == '\r') {
+		if (s[insertLength - 1] == '\r') {
 			// End of line already in buffer so drop the newly created one
 			RemoveLine(lineInsert - 1);
 		}
 	}
 }
 
-void CellBuffer::BasicDeleteChars(int position, int deleteLength) {
+void CellBuffer::BasicDeleteChars(Sci_Position position, Sci_Position deleteLength) {
 	if (deleteLength == 0)
 		return;
 
@@ -540,7 +771,7 @@ void CellBuffer::BasicDeleteChars(int position, int deleteLength) {
 		// Have to fix up line positions before doing deletion as looking at text in buffer
 		// to work out which lines have been removed
 
-		int lineRemove = lv.LineFromPosition(position) + 1;
+		Sci_Position lineRemove = lv.LineFromPosition(position) + 1;
 		lv.InsertText(lineRemove-1, - (deleteLength));
 		char chPrev = substance.ValueAt(position - 1);
 		char chBefore = chPrev;
@@ -554,7 +785,7 @@ void CellBuffer::BasicDeleteChars(int position, int deleteLength) {
 		}
 
 		char ch = chNext;
-		for (int i = 0; i < deleteLength; i++) {
+		for (Sci_Position i = 0; i < deleteLength; i++) {
 			chNext = substance.ValueAt(position + i + 1);
 			if (ch == '\r') {
 				if (chNext != '\n') {
@@ -583,6 +814,63 @@ void CellBuffer::BasicDeleteChars(int position, int deleteLength) {
 	style.DeleteRange(position, deleteLength);
 }
 
+/**
+ * Rewrite the text and styles of the lines in one pass and replace them with a single
+ * gap move. Line ends keep the style of their first character. As each line still has
+ * a line end, only the following line starts move and per line data is unaffected.
+ */
+void CellBuffer::BasicChangeLineEnds(Sci_Position position, char *ends, Sci_Position lines) {
+	if (lines <= 0)
+		return;
+	const Sci_Position line = lv.LineFromPosition(position);
+	PLATFORM_ASSERT(lv.LineStart(line) == position);
+	PLATFORM_ASSERT(line + lines < lv.Lines());
+	const Sci_Position lengthOld = lv.LineStart(line + lines) - position;
+	// Each line end grows by at most one byte
+	char *text = new char[lengthOld + lines];
+	char *styles = new char[lengthOld + lines];
+	Sci_Position lengthNew = 0;
+	Sci_Position lineStart = position;
+	// Starts of later lines have already moved by delta
+	Sci_Position delta = 0;
+	for (Sci_Position i = 0; i < lines; i++) {
+		const Sci_Position lineEnd = lv.LineStart(line + i + 1) - delta;
+		int modeOld = SC_EOL_LF;
+		if (substance.ValueAt(lineEnd - 1) == '\r')
+			modeOld = SC_EOL_CR;
+		else if ((lineEnd - 2 >= lineStart) && (substance.ValueAt(lineEnd - 2) == '\r'))
+			modeOld = SC_EOL_CRLF;
+		const Sci_Position lengthEndOld = (modeOld == SC_EOL_CRLF) ? 2 : 1;
+		const Sci_Position lengthContent = lineEnd - lengthEndOld - lineStart;
+		substance.GetRange(text + lengthNew, lineStart, lengthContent);
+		style.GetRange(styles + lengthNew, lineStart, lengthContent);
+		lengthNew += lengthContent;
+		const char styleEnd = style.ValueAt(lineEnd - lengthEndOld);
+		const int modeNew = ends[i];
+		if (modeNew != SC_EOL_LF) {
+			styles[lengthNew] = styleEnd;
+			text[lengthNew++] = '\r';
+		}
+		if (modeNew != SC_EOL_CR) {
+			styles[lengthNew] = styleEnd;
+			text[lengthNew++] = '\n';
+		}
+		const Sci_Position lengthEndNew = (modeNew == SC_EOL_CRLF) ? 2 : 1;
+		if (lengthEndNew != lengthEndOld) {
+			lv.InsertText(line + i, lengthEndNew - lengthEndOld);
+			delta += lengthEndNew - lengthEndOld;
+		}
+		ends[i] = static_cast<char>(modeOld);
+		lineStart = lineEnd;
+	}
+	substance.DeleteRange(position, lengthOld);
+	substance.InsertFromArray(position, text, 0, lengthNew);
+	style.DeleteRange(position, lengthOld);
+	style.InsertFromArray(position, styles, 0, lengthNew);
+	delete []text;
+	delete []styles;
+}
+
 bool CellBuffer::SetUndoCollection(bool collectUndo) {
 	collectingUndo = collectUndo;
 	uh.DropUndoSequence();
@@ -603,13 +891,21 @@ void CellBuffer::EndUndoAction() {
 
 void CellBuffer::AddUndoAction(int token, bool mayCoalesce) {
 	bool startSequence;
-	uh.AppendAction(containerAction, token, 0, 0, startSequence, mayCoalesce);
+	uh.AppendAction(containerAction, token, 0, startSequence, mayCoalesce);
 }
 
 void CellBuffer::DeleteUndoHistory() {
 	uh.DeleteUndoHistory();
 }
 
+void CellBuffer::SetUndoMemoryLimit(Sci_Position limit) {
+	uh.SetMemoryLimit(limit);
+}
+
+Sci_Position CellBuffer::GetUndoMemoryLimit() const {
+	return uh.GetMemoryLimit();
+}
+
 bool CellBuffer::CanUndo() {
 	return uh.CanUndo();
 }
@@ -628,6 +924,9 @@ void CellBuffer::PerformUndoStep() {
 		BasicDeleteChars(actionStep.position, actionStep.lenData);
 	} else if (actionStep.at == removeAction) {
 		BasicInsertString(actionStep.position, actionStep.data, actionStep.lenData);
+	} else if (actionStep.at == lineEndsAction) {
+		// The saved modes and the current line ends are exchanged so redo can do the same
+		BasicChangeLineEnds(actionStep.position, const_cast<char *>(actionStep.data), actionStep.lenData);
 	}
 	uh.CompletedUndoStep();
 }
@@ -650,6 +949,8 @@ void CellBuffer::PerformRedoStep() {
 		BasicInsertString(actionStep.position, actionStep.data, actionStep.lenData);
 	} else if (actionStep.at == removeAction) {
 		BasicDeleteChars(actionStep.position, actionStep.lenData);
+	} else if (actionStep.at == lineEndsAction) {
+		BasicChangeLineEnds(actionStep.position, const_cast<char *>(actionStep.data), actionStep.lenData);
 	}
 	uh.CompletedRedoStep();
 }
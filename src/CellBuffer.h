@@ -17,8 +17,9 @@ class PerLine {
 public:
 	virtual ~PerLine() {}
 	virtual void Init()=0;
-	virtual void InsertLine(int)=0;
-	virtual void RemoveLine(int)=0;
+	virtual void InsertLine(Sci_Position)=0;
+	virtual void InsertLines(Sci_Position line, Sci_Position lines)=0;
+	virtual void RemoveLine(Sci_Position)=0;
 };
 
 /**
@@ -26,7 +27,11 @@ public:
  */
 class LineVector {
 
+#ifdef SCI_LINE_INDEX_BLOCKED
+	PartitioningBlocked starts;
+#else
 	Partitioning starts;
+#endif
 	PerLine *perLine;
 
 public:
@@ -36,15 +41,16 @@ public:
 	void Init();
 	void SetPerLine(PerLine *pl);
 
-	void InsertText(int line, int delta);
-	void InsertLine(int line, int position, bool lineStart);
-	void SetLineStart(int line, int position);
-	void RemoveLine(int line);
-	int Lines() const {
+	void InsertText(Sci_Position line, Sci_Position delta);
+	void InsertLine(Sci_Position line, Sci_Position position, bool lineStart);
+	void InsertLines(Sci_Position line, const Sci_Position *positions, Sci_Position lines, bool lineStart);
+	void SetLineStart(Sci_Position line, Sci_Position position);
+	void RemoveLine(Sci_Position line);
+	Sci_Position Lines() const {
 		return starts.Partitions();
 	}
-	int LineFromPosition(int pos) const;
-	int LineStart(int line) const {
+	Sci_Position LineFromPosition(Sci_Position pos) const;
+	Sci_Position LineStart(Sci_Position line) const {
 		return starts.PositionFromPartition(line);
 	}
 
@@ -65,24 +71,33 @@ public:
 
 };
 
-enum actionType { insertAction, removeAction, startAction, containerAction };
+enum actionType { insertAction, removeAction, startAction, containerAction, lineEndsAction };
 
 /**
  * Actions are used to store all the information required to perform one undo/redo step.
+ * The text of an action is held in the UndoHistory's text blocks.
+ * A lineEndsAction holds one SC_EOL_* mode for each of lenData lines from position.
  */
 class Action {
 public:
 	actionType at;
-	int position;
-	char *data;
-	int lenData;
+	Sci_Position position;
+	const char *data;
+	Sci_Position lenData;
 	bool mayCoalesce;
 
 	Action();
-	~Action();
-	void Create(actionType at_, int position_=0, char *data_=0, int lenData_=0, bool mayCoalesce_=true);
-	void Destroy();
-	void Grab(Action *source);
+	void Create(actionType at_, Sci_Position position_=0, const char *data_=0, Sci_Position lenData_=0, bool mayCoalesce_=true);
+};
+
+/**
+ * A block of memory holding the text of consecutive actions.
+ */
+struct UndoTextBlock {
+	UndoTextBlock *next;
+	char *text;
+	Sci_Position size;
+	Sci_Position used;
 };
 
 /**
@@ -96,19 +111,37 @@ class UndoHistory {
 	int undoSequenceDepth;
 	int savePoint;
 
+	// The text of actions is appended to a list of blocks in the same order as the actions
+	// so that there is no allocation per action and dropped text is freed in whole blocks.
+	UndoTextBlock *blockFirst;
+	UndoTextBlock *blockLast;
+	Sci_Position memoryBlocks;
+	Sci_Position memoryLimit;	///< 0 for no limit
+
+	void ResizeActions(int lenActionsNew);
 	void EnsureUndoRoom();
+	char *AllocateText(Sci_Position length);
+	void FreeTextBlocks(UndoTextBlock *block);
+	void DiscardTextFrom(int act);
+	void DropOldestGroups();
 
 public:
 	UndoHistory();
 	~UndoHistory();
 
-	void AppendAction(actionType at, int position, char *data, int length, bool &startSequence, bool mayCoalesce=true);
+	/// Returns space for lengthData bytes of text which the caller fills in.
+	char *AppendAction(actionType at, Sci_Position position, Sci_Position lengthData, bool &startSequence, bool mayCoalesce=true);
 
 	void BeginUndoAction();
 	void EndUndoAction();
 	void DropUndoSequence();
 	void DeleteUndoHistory();
 
+	/// When the memory used exceeds the limit the oldest undo groups are dropped.
+	void SetMemoryLimit(Sci_Position limit);
+	Sci_Position GetMemoryLimit() const;
+	Sci_Position MemoryUse() const;
+
 	/// The save point is a marker in the undo stack where the container has stated that
 	/// the buffer was saved. Undo and redo can move over the save point.
 	void SetSavePoint();
@@ -137,38 +170,58 @@ private:
 	SplitVector<char> style;
 	bool readOnly;
 
+	/// Text owned by the container, such as a memory mapped file, shown read-only without copying.
+	/// Styles for it are only allocated as far as they have been set.
+	const char *textExternal;
+	Sci_Position lengthExternal;
+
 	bool collectingUndo;
 	UndoHistory uh;
 
 	LineVector lv;
 
+	Sci_Position AddLineStarts(Sci_Position lineInsert, Sci_Position position, const char *s, Sci_Position insertLength,
+		char chPrev, bool atLineStart);
+
 public:
 
 	CellBuffer();
 	~CellBuffer();
 
 	/// Retrieving positions outside the range of the buffer works and returns 0
-	char CharAt(int position) const;
-	void GetCharRange(char *buffer, int position, int lengthRetrieve) const;
-	char StyleAt(int position) const;
+	char CharAt(Sci_Position position) const;
+	void GetCharRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const;
+	char StyleAt(Sci_Position position) const;
 	const char *BufferPointer();
-
-	int Length() const;
-	void Allocate(int newSize);
+	/// Text from position up to the gap or the end without moving the gap.
+	const char *SegmentPointer(Sci_Position position, Sci_Position &lengthSegment) const;
+	const char *RangePointer(Sci_Position position, Sci_Position rangeLength);
+	Sci_Position GapPosition() const;
+
+	Sci_Position Length() const;
+	void Allocate(Sci_Position newSize);
+	void AttachExternal(const char *s, Sci_Position length);
+	bool IsExternal() const { return textExternal != 0; }
 	void SetPerLine(PerLine *pl);
-	int Lines() const;
-	int LineStart(int line) const;
-	int LineFromPosition(int pos) const { return lv.LineFromPosition(pos); }
-	void InsertLine(int line, int position, bool lineStart);
-	void RemoveLine(int line);
-	const char *InsertString(int position, const char *s, int insertLength, bool &startSequence);
+	Sci_Position Lines() const;
+	Sci_Position LineStart(Sci_Position line) const;
+	Sci_Position LineFromPosition(Sci_Position pos) const { return lv.LineFromPosition(pos); }
+	void InsertLine(Sci_Position line, Sci_Position position, bool lineStart);
+	void RemoveLine(Sci_Position line);
+	const char *InsertString(Sci_Position position, const char *s, Sci_Position insertLength, bool &startSequence);
 
 	/// Setting styles for positions outside the range of the buffer is safe and has no effect.
 	/// @return true if the style of a character is changed.
-	bool SetStyleAt(int position, char styleValue, char mask='\377');
-	bool SetStyleFor(int position, int length, char styleValue, char mask);
+	bool SetStyleAt(Sci_Position position, char styleValue, char mask='\377');
+	bool SetStyleFor(Sci_Position position, Sci_Position length, char styleValue, char mask);
+
+	const char *DeleteChars(Sci_Position position, Sci_Position deleteLength, bool &startSequence);
 
-	const char *DeleteChars(int position, int deleteLength, bool &startSequence);
+	/// Change the ends of lines starting at position to the SC_EOL_* modes in ends
+	/// which receives the previous modes. The number of lines does not change.
+	void ChangeLineEnds(Sci_Position position, char *ends, Sci_Position lines, bool &startSequence);
+	/// @return the SC_EOL_* mode of a line end or -1 for the last line.
+	int LineEndMode(Sci_Position line) const;
 
 	bool IsReadOnly() const;
 	void SetReadOnly(bool set);
@@ -179,8 +232,9 @@ public:
 	bool IsSavePoint();
 
 	/// Actions without undo
-	void BasicInsertString(int position, const char *s, int insertLength);
-	void BasicDeleteChars(int position, int deleteLength);
+	void BasicInsertString(Sci_Position position, const char *s, Sci_Position insertLength);
+	void BasicDeleteChars(Sci_Position position, Sci_Position deleteLength);
+	void BasicChangeLineEnds(Sci_Position position, char *ends, Sci_Position lines);
 
 	bool SetUndoCollection(bool collectUndo);
 	bool IsCollectingUndo() const;
@@ -188,6 +242,8 @@ public:
 	void EndUndoAction();
 	void AddUndoAction(int token, bool mayCoalesce);
 	void DeleteUndoHistory();
+	void SetUndoMemoryLimit(Sci_Position limit);
+	Sci_Position GetUndoMemoryLimit() const;
 
 	/// To perform an undo, StartUndo is called to retrieve the number of steps, then UndoStep is
 	/// called that many times. Similarly for redo.
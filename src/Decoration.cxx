@@ -9,8 +9,11 @@
 #include <stdlib.h>
 #include <stdarg.h>
 
+#include <vector>
+
 #include "Platform.h"
 
+#include "Sci_Position.h"
 #include "Scintilla.h"
 #include "SplitVector.h"
 #include "Partitioning.h"
@@ -21,89 +24,346 @@
 using namespace Scintilla;
 #endif
 
-Decoration::Decoration(int indicator_) : next(0), indicator(indicator_) {
+RunChanges::RunChanges() : root(0), seed(1) {
+}
+
+RunChanges::~RunChanges() {
+	DeleteAll(root);
+}
+
+void RunChanges::DeleteAll(Node *node) {
+	if (node) {
+		DeleteAll(node->left);
+		DeleteAll(node->right);
+		delete node;
+	}
+}
+
+void RunChanges::Update(Node *node) {
+	node->count = 1 + Count(node->left) + Count(node->right);
+	node->maskTree = node->mask;
+	if (node->left)
+		node->maskTree |= node->left->maskTree;
+	if (node->right)
+		node->maskTree |= node->right->maskTree;
+}
+
+/// Split into the first run runs and the rest.
+void RunChanges::Split(Node *node, Sci_Position run, Node *&before, Node *&after) {
+	if (!node) {
+		before = 0;
+		after = 0;
+		return;
+	}
+	if (Count(node->left) < run) {
+		Split(node->right, run - Count(node->left) - 1, node->right, after);
+		before = node;
+	} else {
+		Split(node->left, run, before, node->left);
+		after = node;
+	}
+	Update(node);
+}
+
+RunChanges::Node *RunChanges::Merge(Node *before, Node *after) {
+	if (!before)
+		return after;
+	if (!after)
+		return before;
+	if (before->priority > after->priority) {
+		before->right = Merge(before->right, after);
+		Update(before);
+		return before;
+	} else {
+		after->left = Merge(before, after->left);
+		Update(after);
+		return after;
+	}
+}
+
+void RunChanges::SetMask(Node *node, Sci_Position run, int mask) {
+	const Sci_Position countLeft = Count(node->left);
+	if (run < countLeft)
+		SetMask(node->left, run, mask);
+	else if (run > countLeft)
+		SetMask(node->right, run - countLeft - 1, mask);
+	else
+		node->mask = mask;
+	Update(node);
+}
+
+/// The first run from run onwards in the subtree with a change in mask or -1.
+Sci_Position RunChanges::First(const Node *node, Sci_Position run, int mask) {
+	if (!node || !(node->maskTree & mask) || (run >= node->count))
+		return -1;
+	const Sci_Position countLeft = Count(node->left);
+	if (run < countLeft) {
+		const Sci_Position found = First(node->left, run, mask);
+		if (found >= 0)
+			return found;
+	}
+	if ((run <= countLeft) && (node->mask & mask))
+		return countLeft;
+	const Sci_Position found = First(node->right, (run > countLeft) ? run - countLeft - 1 : 0, mask);
+	return (found >= 0) ? countLeft + 1 + found : -1;
 }
 
-Decoration::~Decoration() {
+/// The last run up to run in the subtree with a change in mask or -1.
+Sci_Position RunChanges::Last(const Node *node, Sci_Position run, int mask) {
+	if (!node || !(node->maskTree & mask) || (run < 0))
+		return -1;
+	const Sci_Position countLeft = Count(node->left);
+	if (run > countLeft) {
+		const Sci_Position found = Last(node->right, run - countLeft - 1, mask);
+		if (found >= 0)
+			return countLeft + 1 + found;
+	}
+	if ((run >= countLeft) && (node->mask & mask))
+		return countLeft;
+	return Last(node->left, run, mask);
 }
 
-bool Decoration::Empty() {
-	return rs.starts->Partitions() == 1;
+void RunChanges::Insert(Sci_Position run, int mask) {
+	Node *node = new Node;
+	seed = seed * 1103515245 + 12345;
+	node->priority = seed >> 8;
+	node->mask = mask;
+	node->left = 0;
+	node->right = 0;
+	Update(node);
+	Node *before;
+	Node *after;
+	Split(root, run, before, after);
+	root = Merge(Merge(before, node), after);
 }
 
-DecorationList::DecorationList() : currentIndicator(0), currentValue(1), current(0),
-	lengthDocument(0), root(0), clickNotified(false) {
+void RunChanges::Remove(Sci_Position run) {
+	Node *before;
+	Node *node;
+	Node *after;
+	Split(root, run, before, after);
+	Split(after, 1, node, after);
+	delete node;
+	root = Merge(before, after);
+}
+
+void RunChanges::SetMask(Sci_Position run, int mask) {
+	SetMask(root, run, mask);
+}
+
+/// The first run after run where an indicator in mask changes or -1.
+Sci_Position RunChanges::Next(Sci_Position run, int mask) const {
+	return First(root, run + 1, mask);
+}
+
+/// The last run up to run where an indicator in mask changes or -1.
+Sci_Position RunChanges::Previous(Sci_Position run, int mask) const {
+	return Last(root, run, mask);
+}
+
+DecorationList::DecorationList() : currentIndicator(0), currentValue(1), clickNotified(false) {
+	// Set 0, with every indicator off, is used by the single empty run
+	values.resize(indicators, 0);
+	masks.push_back(0);
+	uses.push_back(1);
+	chains.push_back(-1);
+	buckets.resize(16, -1);
+	buckets[HashValues(&values[0]) & (buckets.size() - 1)] = 0;
+	for (int indicator = 0; indicator < indicators; indicator++)
+		runsOn[indicator] = 0;
+	changes.Insert(0, 0);
 }
 
 DecorationList::~DecorationList() {
-	Decoration *deco = root;
-	while (deco) {
-		Decoration *decoNext = deco->next;
-		delete deco;
-		deco = decoNext;
+}
+
+unsigned int DecorationList::HashValues(const int *valuesSet) {
+	unsigned int hash = 2166136261u;
+	for (int indicator = 0; indicator < indicators; indicator++) {
+		hash ^= static_cast<unsigned int>(valuesSet[indicator]);
+		hash *= 16777619u;
 	}
-	root = 0;
-	current = 0;
+	return hash;
 }
 
-Decoration *DecorationList::DecorationFromIndicator(int indicator) {
-	for (Decoration *deco=root; deco; deco = deco->next) {
-		if (deco->indicator == indicator) {
-			return deco;
+int DecorationList::FindOrAddSet(const int *valuesSet) {
+	const unsigned int hash = HashValues(valuesSet);
+	for (int set = buckets[hash & (buckets.size() - 1)]; set >= 0; set = chains[set]) {
+		if (memcmp(&values[set * indicators], valuesSet, indicators * sizeof(int)) == 0)
+			return set;
+	}
+	int set;
+	if (setsFree.empty()) {
+		set = static_cast<int>(masks.size());
+		values.resize(values.size() + indicators);
+		masks.push_back(0);
+		uses.push_back(0);
+		chains.push_back(-1);
+	} else {
+		set = setsFree.back();
+		setsFree.pop_back();
+	}
+	int mask = 0;
+	for (int indicator = 0; indicator < indicators; indicator++) {
+		values[set * indicators + indicator] = valuesSet[indicator];
+		if (valuesSet[indicator])
+			mask |= 1 << indicator;
+	}
+	masks[set] = mask;
+	uses[set] = 0;
+	const size_t setsUsed = masks.size() - setsFree.size();
+	if (setsUsed > buckets.size()) {
+		// Rehash into twice as many buckets
+		buckets.assign(buckets.size() * 2, -1);
+		for (size_t s = 0; s < masks.size(); s++)
+			chains[s] = -2;
+		for (size_t f = 0; f < setsFree.size(); f++)
+			chains[setsFree[f]] = -1;
+		for (int s = 0; s < static_cast<int>(masks.size()); s++) {
+			if (chains[s] == -2) {
+				const unsigned int bucket = HashValues(&values[s * indicators]) & (buckets.size() - 1);
+				chains[s] = buckets[bucket];
+				buckets[bucket] = s;
+			}
 		}
+	} else {
+		const unsigned int bucket = hash & (buckets.size() - 1);
+		chains[set] = buckets[bucket];
+		buckets[bucket] = set;
 	}
-	return 0;
+	return set;
 }
 
-Decoration *DecorationList::Create(int indicator, int length) {
-	currentIndicator = indicator;
-	Decoration *decoNew = new Decoration(indicator);
-	decoNew->rs.InsertSpace(0, length);
+void DecorationList::FreeSet(int set) {
+	const unsigned int bucket = HashValues(&values[set * indicators]) & (buckets.size() - 1);
+	if (buckets[bucket] == set) {
+		buckets[bucket] = chains[set];
+	} else {
+		int prev = buckets[bucket];
+		while (chains[prev] != set)
+			prev = chains[prev];
+		chains[prev] = chains[set];
+	}
+	chains[set] = -1;
+	setsFree.push_back(set);
+}
+
+void DecorationList::UseSet(int set, Sci_Position delta) {
+	uses[set] += delta;
+	int indicator = 0;
+	for (unsigned int mask = masks[set]; mask; indicator++, mask >>= 1) {
+		if (mask & 1)
+			runsOn[indicator] += delta;
+	}
+	if ((uses[set] == 0) && (set != 0))
+		FreeSet(set);
+}
 
-	Decoration *decoPrev = 0;
-	Decoration *deco = root;
+int DecorationList::SetWithValue(int set, int indicator, int value) {
+	if (values[set * indicators + indicator] == value)
+		return set;
+	int valuesSet[indicators];
+	memcpy(valuesSet, &values[set * indicators], sizeof(valuesSet));
+	valuesSet[indicator] = value;
+	return FindOrAddSet(valuesSet);
+}
 
-	while (deco && (deco->indicator < indicator)) {
-		decoPrev = deco;
-		deco = deco->next;
+// Text inserted between two runs continues each indicator from before unless it is off after,
+// so text added at either end of an indicator's range is outside it.
+int DecorationList::SetInserted(int setBefore, int setAfter) {
+	if ((setBefore == setAfter) || (masks[setAfter] == 0))
+		return setAfter;
+	int valuesSet[indicators];
+	for (int indicator = 0; indicator < indicators; indicator++) {
+		valuesSet[indicator] = values[setAfter * indicators + indicator] ?
+			values[setBefore * indicators + indicator] : 0;
 	}
-	if (decoPrev == 0) {
-		decoNew->next = root;
-		root = decoNew;
-	} else {
-		decoNew->next = deco;
-		decoPrev->next = decoNew;
+	return FindOrAddSet(valuesSet);
+}
+
+int DecorationList::SetOfRun(Sci_Position run) const {
+	return runs.styles->ValueAt(run);
+}
+
+// Mask of the indicators with different values in the two sets
+int DecorationList::ChangedBetween(int setBefore, int setAfter) const {
+	if (setBefore == setAfter)
+		return 0;
+	int changed = 0;
+	int indicator = 0;
+	for (unsigned int mask = masks[setBefore] | masks[setAfter]; mask; indicator++, mask >>= 1) {
+		if ((mask & 1) && (values[setBefore * indicators + indicator] != values[setAfter * indicators + indicator]))
+			changed |= 1 << indicator;
 	}
-	return decoNew;
+	return changed;
 }
 
-void DecorationList::Delete(int indicator) {
-	Decoration *decoToDelete = 0;
-	if (root) {
-		if (root->indicator == indicator) {
-			decoToDelete = root;
-			root = root->next;
-		} else {
-			Decoration *deco=root;
-			while (deco->next && !decoToDelete) {
-				if (deco->next && deco->next->indicator == indicator) {
-					decoToDelete = deco->next;
-					deco->next = decoToDelete->next;
-				} else {
-					deco = deco->next;
-				}
-			}
+void DecorationList::UpdateChange(Sci_Position run) {
+	if ((run > 0) && (run < runs.starts->Partitions()))
+		changes.SetMask(run, ChangedBetween(SetOfRun(run - 1), SetOfRun(run)));
+}
+
+void DecorationList::SetRun(Sci_Position run, int set) {
+	const int setOld = SetOfRun(run);
+	if (set != setOld) {
+		UseSet(set, 1);
+		runs.styles->SetValueAt(run, set);
+		UseSet(setOld, -1);
+		UpdateChange(run);
+		UpdateChange(run + 1);
+	}
+}
+
+Sci_Position DecorationList::SplitRun(Sci_Position position) {
+	const Sci_Position partitions = runs.starts->Partitions();
+	const Sci_Position run = runs.SplitRun(position);
+	if (runs.starts->Partitions() > partitions) {
+		UseSet(SetOfRun(run), 1);
+		changes.Insert(run, 0);
+	}
+	return run;
+}
+
+void DecorationList::RemoveRun(Sci_Position run) {
+	const int set = SetOfRun(run);
+	runs.RemoveRun(run);
+	changes.Remove(run);
+	UpdateChange(run);
+	UseSet(set, -1);
+}
+
+void DecorationList::RemoveRunIfEmpty(Sci_Position run) {
+	if ((run < runs.starts->Partitions()) && (runs.starts->Partitions() > 1)) {
+		if (runs.starts->PositionFromPartition(run) == runs.starts->PositionFromPartition(run+1)) {
+			RemoveRun(run);
 		}
 	}
-	if (decoToDelete) {
-		delete decoToDelete;
-		current = 0;
+}
+
+void DecorationList::RemoveRunIfSameAsPrevious(Sci_Position run) {
+	if ((run > 0) && (run < runs.starts->Partitions())) {
+		if (SetOfRun(run-1) == SetOfRun(run)) {
+			RemoveRun(run);
+		}
 	}
 }
 
+// Start of the range with one value of indicator around position, but not before start
+Sci_Position DecorationList::StartInRange(int indicator, Sci_Position start, Sci_Position position) {
+	const Sci_Position run = changes.Previous(runs.starts->PartitionFromPosition(position), 1 << indicator);
+	const Sci_Position startRun = (run > 0) ? runs.starts->PositionFromPartition(run) : 0;
+	return (startRun > start) ? startRun : start;
+}
+
+// End of the range with one value of indicator from position, but not after end
+Sci_Position DecorationList::EndInRange(int indicator, Sci_Position position, Sci_Position end) {
+	const Sci_Position run = changes.Next(runs.starts->PartitionFromPosition(position), 1 << indicator);
+	const Sci_Position endRun = (run >= 0) ? runs.starts->PositionFromPartition(run) : runs.Length();
+	return (endRun < end) ? endRun : end;
+}
+
 void DecorationList::SetCurrentIndicator(int indicator) {
 	currentIndicator = indicator;
-	current = DecorationFromIndicator(indicator);
 	currentValue = 1;
 }
 
@@ -111,78 +371,144 @@ void DecorationList::SetCurrentValue(int value) {
 	currentValue = value ? value : 1;
 }
 
-bool DecorationList::FillRange(int &position, int value, int &fillLength) {
-	if (!current) {
-		current = DecorationFromIndicator(currentIndicator);
-		if (!current) {
-			current = Create(currentIndicator, lengthDocument);
+bool DecorationList::FillRange(Sci_Position &position, int value, Sci_Position &fillLength) {
+	const int indicator = currentIndicator;
+	if ((indicator < 0) || (indicator >= indicators))
+		return false;
+	if ((value == 0) && (runsOn[indicator] == 0))
+		return false;
+	Sci_Position end = position + fillLength;
+	if (end > runs.Length())
+		end = runs.Length();
+	if (ValueAt(indicator, end) == value) {
+		// End already has value so trim range.
+		end = StartInRange(indicator, position, end);
+		if (position >= end) {
+			// Whole range is already same as value so no action
+			return false;
 		}
+		fillLength = end - position;
 	}
-	bool changed = current->rs.FillRange(position, value, fillLength);
-	if (current->Empty()) {
-		Delete(currentIndicator);
+	if (ValueAt(indicator, position) == value) {
+		// Start is in expected value so trim range.
+		position = EndInRange(indicator, position, end);
+		fillLength = end - position;
 	}
-	return changed;
-}
-
-void DecorationList::InsertSpace(int position, int insertLength) {
-	lengthDocument += insertLength;
-	for (Decoration *deco=root; deco; deco = deco->next) {
-		deco->rs.InsertSpace(position, insertLength);
+	if (position < end) {
+		const Sci_Position runStart = SplitRun(position);
+		const Sci_Position runEnd = (end < runs.Length()) ? SplitRun(end) : runs.starts->Partitions();
+		for (Sci_Position run = runStart; run < runEnd; run++) {
+			SetRun(run, SetWithValue(SetOfRun(run), indicator, value));
+		}
+		// Join runs that now have the same values, going backwards so runs still to be checked do not move
+		for (Sci_Position run = runEnd; run >= runStart; run--) {
+			RemoveRunIfSameAsPrevious(run);
+		}
 	}
+	return true;
 }
 
-void DecorationList::DeleteRange(int position, int deleteLength) {
-	lengthDocument -= deleteLength;
-	Decoration *deco;
-	for (deco=root; deco; deco = deco->next) {
-		deco->rs.DeleteRange(position, deleteLength);
+void DecorationList::InsertSpace(Sci_Position position, Sci_Position insertLength) {
+	if ((position > 0) && (position >= runs.Length())) {
+		// Text added at the end of the document is outside every indicator
+		Sci_Position last = runs.starts->Partitions() - 1;
+		if (SetOfRun(last) != 0) {
+			runs.starts->InsertPartition(last + 1, position);
+			runs.styles->InsertValue(last + 1, 1, 0);
+			UseSet(0, 1);
+			changes.Insert(last + 1, ChangedBetween(SetOfRun(last), 0));
+			last++;
+		}
+		runs.starts->InsertText(last, insertLength);
+		return;
+	}
+	const Sci_Position run = runs.RunFromPosition(position);
+	if (runs.starts->PositionFromPartition(run) == position) {
+		const int setAfter = SetOfRun(run);
+		const int setBefore = (run > 0) ? SetOfRun(run - 1) : 0;
+		const int setInserted = SetInserted(setBefore, setAfter);
+		if ((run > 0) && (setInserted == setBefore)) {
+			runs.starts->InsertText(run - 1, insertLength);
+		} else if (setInserted == setAfter) {
+			runs.starts->InsertText(run, insertLength);
+		} else {
+			// Start a new run for the inserted text
+			runs.starts->InsertPartition(run + 1, position);
+			runs.styles->InsertValue(run + 1, 1, setAfter);
+			UseSet(setAfter, 1);
+			changes.Insert(run + 1, 0);
+			SetRun(run, setInserted);
+			runs.starts->InsertText(run, insertLength);
+		}
+	} else {
+		runs.starts->InsertText(run, insertLength);
 	}
-	DeleteAnyEmpty();
 }
 
-void DecorationList::DeleteAnyEmpty() {
-	Decoration *deco = root;
-	while (deco) {
-		if (deco->Empty()) {
-			Delete(deco->indicator);
-			deco = root;
-		} else {
-			deco = deco->next;
+void DecorationList::DeleteRange(Sci_Position position, Sci_Position deleteLength) {
+	const Sci_Position end = position + deleteLength;
+	Sci_Position runStart = runs.RunFromPosition(position);
+	Sci_Position runEnd = runs.RunFromPosition(end);
+	if (runStart == runEnd) {
+		// Deleting from inside one run, which is only emptied when it is the last
+		runs.starts->InsertText(runStart, -deleteLength);
+		RemoveRunIfEmpty(runStart);
+	} else {
+		runStart = SplitRun(position);
+		runEnd = SplitRun(end);
+		runs.starts->InsertText(runStart, -deleteLength);
+		// Remove each old run over the range
+		for (Sci_Position run=runStart; run<runEnd; run++) {
+			RemoveRun(runStart);
 		}
+		RemoveRunIfEmpty(runStart);
+		RemoveRunIfSameAsPrevious(runStart);
+	}
+	if (runs.Length() == 0) {
+		// An empty document has no indicators
+		SetRun(0, 0);
 	}
 }
 
-int DecorationList::AllOnFor(int position) {
+// Indicators that are on anywhere in the document
+int DecorationList::AllOn() const {
 	int mask = 0;
-	for (Decoration *deco=root; deco; deco = deco->next) {
-		if (deco->rs.ValueAt(position)) {
-			mask |= 1 << deco->indicator;
-		}
+	for (int indicator = 0; indicator < indicators; indicator++) {
+		if (runsOn[indicator])
+			mask |= 1 << indicator;
 	}
 	return mask;
 }
 
-int DecorationList::ValueAt(int indicator, int position) {
-	Decoration *deco = DecorationFromIndicator(indicator);
-	if (deco) {
-		return deco->rs.ValueAt(position);
-	}
-	return 0;
+int DecorationList::AllOnFor(Sci_Position position) {
+	return masks[runs.ValueAt(position)];
 }
 
-int DecorationList::Start(int indicator, int position) {
-	Decoration *deco = DecorationFromIndicator(indicator);
-	if (deco) {
-		return deco->rs.StartRun(position);
+// Indicators that are on anywhere from start up to end
+int DecorationList::AllOnForRange(Sci_Position start, Sci_Position end) {
+	Sci_Position run = runs.starts->PartitionFromPosition(start);
+	const Sci_Position partitions = runs.starts->Partitions();
+	int mask = masks[SetOfRun(run)];
+	while ((++run < partitions) && (runs.starts->PositionFromPartition(run) < end)) {
+		mask |= masks[SetOfRun(run)];
 	}
-	return 0;
+	return mask;
 }
 
-int DecorationList::End(int indicator, int position) {
-	Decoration *deco = DecorationFromIndicator(indicator);
-	if (deco) {
-		return deco->rs.EndRun(position);
-	}
-	return 0;
+int DecorationList::ValueAt(int indicator, Sci_Position position) {
+	if ((indicator < 0) || (indicator >= indicators))
+		return 0;
+	return values[runs.ValueAt(position) * indicators + indicator];
+}
+
+Sci_Position DecorationList::Start(int indicator, Sci_Position position) {
+	if ((indicator < 0) || (indicator >= indicators) || (runsOn[indicator] == 0))
+		return 0;
+	return StartInRange(indicator, 0, position);
+}
+
+Sci_Position DecorationList::End(int indicator, Sci_Position position) {
+	if ((indicator < 0) || (indicator >= indicators) || (runsOn[indicator] == 0))
+		return 0;
+	return EndInRange(indicator, position, runs.Length());
 }
@@ -11,29 +11,81 @@
 namespace Scintilla {
 #endif
 
-class Decoration {
+/**
+ * For each run, a mask of the indicators whose values change from the previous run.
+ * Runs are nodes of a treap ordered by run number where each node holds the number of
+ * runs and the union of the masks in its subtree, so runs are added or removed in O(log n)
+ * and the next or previous change of an indicator is found in O(log n) by skipping the
+ * subtrees where it does not change.
+ */
+class RunChanges {
+	struct Node {
+		unsigned int priority;
+		int mask;
+		int maskTree;
+		Sci_Position count;
+		Node *left;
+		Node *right;
+	};
+	Node *root;
+	unsigned int seed;
+	static Sci_Position Count(const Node *node) { return node ? node->count : 0; }
+	static void Update(Node *node);
+	static void Split(Node *node, Sci_Position run, Node *&before, Node *&after);
+	static Node *Merge(Node *before, Node *after);
+	static void SetMask(Node *node, Sci_Position run, int mask);
+	static Sci_Position First(const Node *node, Sci_Position run, int mask);
+	static Sci_Position Last(const Node *node, Sci_Position run, int mask);
+	static void DeleteAll(Node *node);
 public:
-	Decoration *next;
-	RunStyles rs;
-	int indicator;
-
-	Decoration(int indicator_);
-	~Decoration();
-
-	bool Empty();
+	RunChanges();
+	~RunChanges();
+	void Insert(Sci_Position run, int mask);
+	void Remove(Sci_Position run);
+	void SetMask(Sci_Position run, int mask);
+	Sci_Position Next(Sci_Position run, int mask) const;
+	Sci_Position Previous(Sci_Position run, int mask) const;
 };
 
+/// The values of all the indicators held as one set of runs.
+/// Each run refers to a value set with the value of every indicator and runs with
+/// the same values share a set, so text changes update a single RunStyles however
+/// many indicators are in use and the indicators on a line are found by visiting the
+/// runs on that line. The runs where each indicator changes are indexed by changes.
+
 class DecorationList {
+	enum { indicators = INDIC_MAX + 1 };
 	int currentIndicator;
 	int currentValue;
-	Decoration *current;
-	int lengthDocument;
-	Decoration *DecorationFromIndicator(int indicator);
-	Decoration *Create(int indicator, int length);
-	void Delete(int indicator);
-	void DeleteAnyEmpty();
+	RunStyles runs;	///< The value of each run is the number of its value set
+	// For each value set: the value of each indicator, a mask of the indicators that are on,
+	// how many runs use it and the next set in the same hash bucket.
+	// Set 0 has every indicator off and is never freed.
+	std::vector<int> values;
+	std::vector<int> masks;
+	std::vector<Sci_Position> uses;
+	std::vector<int> chains;
+	std::vector<int> buckets;
+	std::vector<int> setsFree;
+	Sci_Position runsOn[indicators];	///< How many runs each indicator is on in
+	RunChanges changes;
+
+	static unsigned int HashValues(const int *valuesSet);
+	int FindOrAddSet(const int *valuesSet);
+	void FreeSet(int set);
+	void UseSet(int set, Sci_Position delta);
+	int SetWithValue(int set, int indicator, int value);
+	int SetInserted(int setBefore, int setAfter);
+	int SetOfRun(Sci_Position run) const;
+	int ChangedBetween(int setBefore, int setAfter) const;
+	void UpdateChange(Sci_Position run);
+	void SetRun(Sci_Position run, int set);
+	Sci_Position SplitRun(Sci_Position position);
+	void RemoveRun(Sci_Position run);
+	void RemoveRunIfEmpty(Sci_Position run);
+	void RemoveRunIfSameAsPrevious(Sci_Position run);
+	Sci_Position StartInRange(int indicator, Sci_Position start, Sci_Position position);
 public:
-	Decoration *root;
 	bool clickNotified;
 
 	DecorationList();
@@ -46,15 +98,18 @@ public:
 	int GetCurrentValue() const { return currentValue; }
 
 	// Returns true if some values may have changed
-	bool FillRange(int &position, int value, int &fillLength);
+	bool FillRange(Sci_Position &position, int value, Sci_Position &fillLength);
 
-	void InsertSpace(int position, int insertLength);
-	void DeleteRange(int position, int deleteLength);
+	void InsertSpace(Sci_Position position, Sci_Position insertLength);
+	void DeleteRange(Sci_Position position, Sci_Position deleteLength);
 
-	int AllOnFor(int position);
-	int ValueAt(int indicator, int position);
-	int Start(int indicator, int position);
-	int End(int indicator, int position);
+	int AllOn() const;
+	int AllOnFor(Sci_Position position);
+	int AllOnForRange(Sci_Position start, Sci_Position end);
+	int ValueAt(int indicator, Sci_Position position);
+	Sci_Position Start(int indicator, Sci_Position position);
+	Sci_Position End(int indicator, Sci_Position position);
+	Sci_Position EndInRange(int indicator, Sci_Position position, Sci_Position end);
 };
 
 #ifdef SCI_NAMESPACE
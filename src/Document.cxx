@@ -13,6 +13,8 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <new>
 
 // With Borland C++ 5.5, including <string> includes Windows.h leading to defining
 // FindText to FindTextA which makes calls here to Document::FindText fail.
@@ -64,7 +66,7 @@ static inline bool IsUpperCase(char ch) {
 	return isascii(ch) && isupper(ch);
 }
 
-void LexInterface::Colourise(int start, int end) {
+void LexInterface::Colourise(Position start, Position end) {
 	ElapsedTime et;
 	if (pdoc && instance && !performingStyle) {
 		// Protect against reentrance, which may occur, for example, when
@@ -72,10 +74,10 @@ void LexInterface::Colourise(int start, int end) {
 		// code looks for child lines which may trigger styling.
 		performingStyle = true;
 
-		int lengthDoc = pdoc->Length();
+		Position lengthDoc = pdoc->Length();
 		if (end == -1)
 			end = lengthDoc;
-		int len = end - start;
+		Position len = end - start;
 
 		PLATFORM_ASSERT(len >= 0);
 		PLATFORM_ASSERT(start + len <= lengthDoc);
@@ -85,8 +87,14 @@ void LexInterface::Colourise(int start, int end) {
 			styleStart = pdoc->StyleAt(start - 1) & pdoc->stylingBitsMask;
 
 		if (len > 0) {
-			instance->Lex(start, len, styleStart, pdoc);
-			instance->Fold(start, len, styleStart, pdoc);
+			if (instance->Version() >= lvLargeFile) {
+				ILexerLargeFile *lexerLarge = static_cast<ILexerLargeFile *>(instance);
+				lexerLarge->LexLargeFile(start, len, styleStart, pdoc);
+				lexerLarge->FoldLargeFile(start, len, styleStart, pdoc);
+			} else {
+				instance->Lex(static_cast<unsigned int>(start), static_cast<int>(len), styleStart, &accessOriginal);
+				instance->Fold(static_cast<unsigned int>(start), static_cast<int>(len), styleStart, &accessOriginal);
+			}
 		}
 
 		performingStyle = false;
@@ -94,6 +102,94 @@ void LexInterface::Colourise(int start, int end) {
 	Platform::DebugPrintf("Style:%d %9.6g \n", performingStyle, et.Duration());
 }
 
+int SCI_METHOD DocumentAccessOriginal::Version() const {
+	return dvRangePointer;
+}
+
+void SCI_METHOD DocumentAccessOriginal::SetErrorStatus(int status) {
+	pdoc->SetErrorStatus(status);
+}
+
+int SCI_METHOD DocumentAccessOriginal::Length() const {
+	return static_cast<int>(pdoc->Length());
+}
+
+void SCI_METHOD DocumentAccessOriginal::GetCharRange(char *buffer, int position, int lengthRetrieve) const {
+	pdoc->GetCharRange(buffer, position, lengthRetrieve);
+}
+
+char SCI_METHOD DocumentAccessOriginal::StyleAt(int position) const {
+	return pdoc->StyleAt(position);
+}
+
+int SCI_METHOD DocumentAccessOriginal::LineFromPosition(int position) const {
+	return static_cast<int>(pdoc->LineFromPosition(position));
+}
+
+int SCI_METHOD DocumentAccessOriginal::LineStart(int line) const {
+	return static_cast<int>(pdoc->LineStart(line));
+}
+
+int SCI_METHOD DocumentAccessOriginal::GetLevel(int line) const {
+	return pdoc->GetLevel(line);
+}
+
+int SCI_METHOD DocumentAccessOriginal::SetLevel(int line, int level) {
+	return pdoc->SetLevel(line, level);
+}
+
+int SCI_METHOD DocumentAccessOriginal::GetLineState(int line) const {
+	return pdoc->GetLineState(line);
+}
+
+int SCI_METHOD DocumentAccessOriginal::SetLineState(int line, int state) {
+	return pdoc->SetLineState(line, state);
+}
+
+void SCI_METHOD DocumentAccessOriginal::StartStyling(int position, char mask) {
+	pdoc->StartStyling(position, mask);
+}
+
+bool SCI_METHOD DocumentAccessOriginal::SetStyleFor(int length, char style) {
+	return pdoc->SetStyleFor(length, style);
+}
+
+bool SCI_METHOD DocumentAccessOriginal::SetStyles(int length, const char *styles) {
+	return pdoc->SetStyles(length, styles);
+}
+
+void SCI_METHOD DocumentAccessOriginal::DecorationSetCurrentIndicator(int indicator) {
+	pdoc->DecorationSetCurrentIndicator(indicator);
+}
+
+void SCI_METHOD DocumentAccessOriginal::DecorationFillRange(int position, int value, int fillLength) {
+	pdoc->DecorationFillRange(position, value, fillLength);
+}
+
+void SCI_METHOD DocumentAccessOriginal::ChangeLexerState(int start, int end) {
+	pdoc->ChangeLexerState(start, end);
+}
+
+int SCI_METHOD DocumentAccessOriginal::CodePage() const {
+	return pdoc->CodePage();
+}
+
+bool SCI_METHOD DocumentAccessOriginal::IsDBCSLeadByte(char ch) const {
+	return pdoc->IsDBCSLeadByte(ch);
+}
+
+const char * SCI_METHOD DocumentAccessOriginal::BufferPointer() {
+	return pdoc->BufferPointer();
+}
+
+const char * SCI_METHOD DocumentAccessOriginal::RangePointer(int position, int rangeLength) {
+	return pdoc->RangePointer(position, rangeLength);
+}
+
+int SCI_METHOD DocumentAccessOriginal::GapPosition() const {
+	return static_cast<int>(pdoc->GapPosition());
+}
+
 Document::Document() {
 	refCount = 0;
 #ifdef unix
@@ -107,6 +203,7 @@ Document::Document() {
 	stylingMask = 0;
 	endStyled = 0;
 	styleClock = 0;
+	durationStyleOneLine = 0.00001;
 	enteredModification = 0;
 	enteredStyling = 0;
 	enteredReadOnlyCount = 0;
@@ -121,6 +218,7 @@ Document::Document() {
 
 	matchesValid = false;
 	regex = 0;
+	lineEndsFirst = 0;
 
 	perLineData[ldMarkers] = new LineMarkers();
 	perLineData[ldLevels] = new LineLevels();
@@ -157,14 +255,21 @@ void Document::Init() {
 	}
 }
 
-void Document::InsertLine(int line) {
+void Document::InsertLine(Sci_Position line) {
 	for (int j=0; j<ldSize; j++) {
 		if (perLineData[j])
 			perLineData[j]->InsertLine(line);
 	}
 }
 
-void Document::RemoveLine(int line) {
+void Document::InsertLines(Sci_Position line, Sci_Position lines) {
+	for (int j=0; j<ldSize; j++) {
+		if (perLineData[j])
+			perLineData[j]->InsertLines(line, lines);
+	}
+}
+
+void Document::RemoveLine(Sci_Position line) {
 	for (int j=0; j<ldSize; j++) {
 		if (perLineData[j])
 			perLineData[j]->RemoveLine(line);
@@ -172,29 +277,49 @@ void Document::RemoveLine(int line) {
 }
 
 // Increase reference count and return its previous value.
-int Document::AddRef() {
+int SCI_METHOD Document::AddRef() {
 	return refCount++;
 }
 
 // Decrease reference count and return its previous value.
 // Delete the document if reference count reaches zero.
-int Document::Release() {
+int SCI_METHOD Document::Release() {
 	int curRefCount = --refCount;
 	if (curRefCount == 0)
 		delete this;
 	return curRefCount;
 }
 
+// Append text to a document created by SCI_CREATELOADER. Undo collection is off and
+// there are no watchers so the text goes straight into the buffer and line index.
+int SCI_METHOD Document::AddData(const char *data, Sci_Position length) {
+	try {
+		InsertString(Length(), data, length);
+	} catch (std::bad_alloc &) {
+		return SC_STATUS_BADALLOC;
+	} catch (...) {
+		return SC_STATUS_FAILURE;
+	}
+	return SC_STATUS_OK;
+}
+
+// Finish loading: later changes are undoable and the loaded text is the save point.
+void * SCI_METHOD Document::ConvertToDocument() {
+	SetUndoCollection(true);
+	SetSavePoint();
+	return this;
+}
+
 void Document::SetSavePoint() {
 	cb.SetSavePoint();
 	NotifySavePoint(true);
 }
 
-int Document::GetMark(int line) {
+int Document::GetMark(Sci_Position line) {
 	return static_cast<LineMarkers *>(perLineData[ldMarkers])->MarkValue(line);
 }
 
-int Document::AddMark(int line, int markerNum) {
+int Document::AddMark(Sci_Position line, int markerNum) {
 	if (line <= LinesTotal()) {
 		int prev = static_cast<LineMarkers *>(perLineData[ldMarkers])->
 			AddMark(line, markerNum, LinesTotal());
@@ -206,7 +331,7 @@ int Document::AddMark(int line, int markerNum) {
 	}
 }
 
-void Document::AddMarkSet(int line, int valueSet) {
+void Document::AddMarkSet(Sci_Position line, int valueSet) {
 	unsigned int m = valueSet;
 	for (int i = 0; m; i++, m >>= 1)
 		if (m & 1)
@@ -216,7 +341,7 @@ void Document::AddMarkSet(int line, int valueSet) {
 	NotifyModified(mh);
 }
 
-void Document::DeleteMark(int line, int markerNum) {
+void Document::DeleteMark(Sci_Position line, int markerNum) {
 	static_cast<LineMarkers *>(perLineData[ldMarkers])->DeleteMark(line, markerNum, false);
 	DocModification mh(SC_MOD_CHANGEMARKER, LineStart(line), 0, 0, 0, line);
 	NotifyModified(mh);
@@ -230,27 +355,33 @@ void Document::DeleteMarkFromHandle(int markerHandle) {
 }
 
 void Document::DeleteAllMarks(int markerNum) {
-	for (int line = 0; line < LinesTotal(); line++) {
-		static_cast<LineMarkers *>(perLineData[ldMarkers])->DeleteMark(line, markerNum, true);
-	}
+	static_cast<LineMarkers *>(perLineData[ldMarkers])->DeleteAllMarks(markerNum);
 	DocModification mh(SC_MOD_CHANGEMARKER, 0, 0, 0, 0);
 	mh.line = -1;
 	NotifyModified(mh);
 }
 
-int Document::LineFromHandle(int markerHandle) {
+Sci_Position Document::LineFromHandle(int markerHandle) {
 	return static_cast<LineMarkers *>(perLineData[ldMarkers])->LineFromHandle(markerHandle);
 }
 
-int SCI_METHOD Document::LineStart(int line) const {
+Sci_Position Document::MarkerNext(Sci_Position lineStart, int mask) const {
+	return static_cast<LineMarkers *>(perLineData[ldMarkers])->MarkerNext(lineStart, mask);
+}
+
+Sci_Position Document::MarkerPrevious(Sci_Position lineStart, int mask) const {
+	return static_cast<LineMarkers *>(perLineData[ldMarkers])->MarkerPrevious(lineStart, mask);
+}
+
+Position SCI_METHOD Document::LineStart(Sci_Position line) const {
 	return cb.LineStart(line);
 }
 
-int Document::LineEnd(int line) const {
+Position Document::LineEnd(Sci_Position line) const {
 	if (line == LinesTotal() - 1) {
 		return LineStart(line + 1);
 	} else {
-		int position = LineStart(line + 1) - 1;
+		Position position = LineStart(line + 1) - 1;
 		// When line terminator is CR+LF, may need to go back one more
 		if ((position > LineStart(line)) && (cb.CharAt(position - 1) == '\r')) {
 			position--;
@@ -266,23 +397,23 @@ void SCI_METHOD Document::SetErrorStatus(int status) {
 	}
 }
 
-int SCI_METHOD Document::LineFromPosition(int pos) const {
+Sci_Position SCI_METHOD Document::LineFromPosition(Position pos) const {
 	return cb.LineFromPosition(pos);
 }
 
-int Document::LineEndPosition(int position) const {
+Position Document::LineEndPosition(Position position) const {
 	return LineEnd(LineFromPosition(position));
 }
 
-bool Document::IsLineEndPosition(int position) const {
+bool Document::IsLineEndPosition(Position position) const {
 	return LineEnd(LineFromPosition(position)) == position;
 }
 
-int Document::VCHomePosition(int position) const {
-	int line = LineFromPosition(position);
-	int startPosition = LineStart(line);
-	int endLine = LineEnd(line);
-	int startText = startPosition;
+Position Document::VCHomePosition(Position position) const {
+	Sci_Position line = LineFromPosition(position);
+	Position startPosition = LineStart(line);
+	Position endLine = LineEnd(line);
+	Position startText = startPosition;
 	while (startText < endLine && (cb.CharAt(startText) == ' ' || cb.CharAt(startText) == '\t'))
 		startText++;
 	if (position == startText)
@@ -291,7 +422,7 @@ int Document::VCHomePosition(int position) const {
 		return startText;
 }
 
-int SCI_METHOD Document::SetLevel(int line, int level) {
+int SCI_METHOD Document::SetLevel(Sci_Position line, int level) {
 	int prev = static_cast<LineLevels *>(perLineData[ldLevels])->SetLevel(line, level, LinesTotal());
 	if (prev != level) {
 		DocModification mh(SC_MOD_CHANGEFOLD | SC_MOD_CHANGEMARKER,
@@ -303,7 +434,7 @@ int SCI_METHOD Document::SetLevel(int line, int level) {
 	return prev;
 }
 
-int SCI_METHOD Document::GetLevel(int line) const {
+int SCI_METHOD Document::GetLevel(Sci_Position line) const {
 	return static_cast<LineLevels *>(perLineData[ldLevels])->GetLevel(line);
 }
 
@@ -318,11 +449,11 @@ static bool IsSubordinate(int levelStart, int levelTry) {
 		return (levelStart & SC_FOLDLEVELNUMBERMASK) < (levelTry & SC_FOLDLEVELNUMBERMASK);
 }
 
-int Document::GetLastChild(int lineParent, int level) {
+Sci_Position Document::GetLastChild(Sci_Position lineParent, int level) {
 	if (level == -1)
 		level = GetLevel(lineParent) & SC_FOLDLEVELNUMBERMASK;
-	int maxLine = LinesTotal();
-	int lineMaxSubord = lineParent;
+	Sci_Position maxLine = LinesTotal();
+	Sci_Position lineMaxSubord = lineParent;
 	while (lineMaxSubord < maxLine - 1) {
 		EnsureStyledTo(LineStart(lineMaxSubord + 2));
 		if (!IsSubordinate(level, GetLevel(lineMaxSubord + 1)))
@@ -340,9 +471,9 @@ int Document::GetLastChild(int lineParent, int level) {
 	return lineMaxSubord;
 }
 
-int Document::GetFoldParent(int line) {
+Sci_Position Document::GetFoldParent(Sci_Position line) {
 	int level = GetLevel(line) & SC_FOLDLEVELNUMBERMASK;
-	int lineLook = line - 1;
+	Sci_Position lineLook = line - 1;
 	while ((lineLook > 0) && (
 	            (!(GetLevel(lineLook) & SC_FOLDLEVELHEADERFLAG)) ||
 	            ((GetLevel(lineLook) & SC_FOLDLEVELNUMBERMASK) >= level))
@@ -357,11 +488,16 @@ int Document::GetFoldParent(int line) {
 	}
 }
 
-int Document::ClampPositionIntoDocument(int pos) {
-	return Platform::Clamp(pos, 0, Length());
+Position Document::ClampPositionIntoDocument(Position pos) {
+	if (pos < 0)
+		return 0;
+	else if (pos > Length())
+		return Length();
+	else
+		return pos;
 }
 
-bool Document::IsCrLf(int pos) {
+bool Document::IsCrLf(Position pos) {
 	if (pos < 0)
 		return false;
 	if (pos >= (Length() - 1))
@@ -371,7 +507,7 @@ bool Document::IsCrLf(int pos) {
 
 static const int maxBytesInDBCSCharacter=5;
 
-int Document::LenChar(int pos) {
+int Document::LenChar(Position pos) {
 	if (pos < 0) {
 		return 1;
 	} else if (IsCrLf(pos)) {
@@ -385,9 +521,9 @@ int Document::LenChar(int pos) {
 			len = 4;
 		else if (ch >= (0x80 + 0x40 + 0x20))
 			len = 3;
-		int lengthDoc = Length();
+		Position lengthDoc = Length();
 		if ((pos + len) > lengthDoc)
-			return lengthDoc -pos;
+			return static_cast<int>(lengthDoc - pos);
 		else
 			return len;
 	} else if (dbcsCodePage) {
@@ -421,8 +557,8 @@ static int BytesFromLead(int leadByte) {
 	return 0;
 }
 
-bool Document::InGoodUTF8(int pos, int &start, int &end) {
-	int lead = pos;
+bool Document::InGoodUTF8(Position pos, Position &start, Position &end) {
+	Position lead = pos;
 	while ((lead>0) && (pos-lead < 4) && IsTrailByte(static_cast<unsigned char>(cb.CharAt(lead-1))))
 		lead--;
 	start = 0;
@@ -435,12 +571,12 @@ bool Document::InGoodUTF8(int pos, int &start, int &end) {
 		return false;
 	} else {
 		int trailBytes = bytes - 1;
-		int len = pos - lead + 1;
+		Position len = pos - lead + 1;
 		if (len > trailBytes)
 			// pos too far from lead
 			return false;
 		// Check that there are enough trails for this lead
-		int trail = pos + 1;
+		Position trail = pos + 1;
 		while ((trail-lead<trailBytes) && (trail < Length())) {
 			if (!IsTrailByte(static_cast<unsigned char>(cb.CharAt(trail)))) {
 				return false;
@@ -457,7 +593,7 @@ bool Document::InGoodUTF8(int pos, int &start, int &end) {
 // When lines are terminated with \r\n pairs which should be treated as one character.
 // When displaying DBCS text such as Japanese.
 // If moving, move the position in the indicated direction.
-int Document::MovePositionOutsideChar(int pos, int moveDir, bool checkLineEnd) {
+Position Document::MovePositionOutsideChar(Position pos, int moveDir, bool checkLineEnd) {
 	//Platform::DebugPrintf("NoCRLF %d %d\n", pos, moveDir);
 	// If out of range, just return minimum/maximum value.
 	if (pos <= 0)
@@ -478,8 +614,8 @@ int Document::MovePositionOutsideChar(int pos, int moveDir, bool checkLineEnd) {
 	if (dbcsCodePage) {
 		if (SC_CP_UTF8 == dbcsCodePage) {
 			unsigned char ch = static_cast<unsigned char>(cb.CharAt(pos));
-			int startUTF = pos;
-			int endUTF = pos;
+			Position startUTF = pos;
+			Position endUTF = pos;
 			if (IsTrailByte(ch) && InGoodUTF8(pos, startUTF, endUTF)) {
 				// ch is a trail byte within a UTF-8 character
 				if (moveDir > 0)
@@ -490,7 +626,7 @@ int Document::MovePositionOutsideChar(int pos, int moveDir, bool checkLineEnd) {
 		} else {
 			// Anchor DBCS calculations at start of line because start of line can
 			// not be a DBCS trail byte.
-			int posCheck = LineStart(LineFromPosition(pos));
+			Position posCheck = LineStart(LineFromPosition(pos));
 			while (posCheck < pos) {
 				char mbstr[maxBytesInDBCSCharacter+1];
 				int i;
@@ -525,7 +661,7 @@ bool SCI_METHOD Document::IsDBCSLeadByte(char ch) const {
 	return Platform::IsDBCSLeadByte(dbcsCodePage, ch);
 }
 
-void Document::ModifiedAt(int pos) {
+void Document::ModifiedAt(Position pos) {
 	if (endStyled > pos)
 		endStyled = pos;
 }
@@ -541,7 +677,7 @@ void Document::CheckReadOnly() {
 // Document only modified by gateways DeleteChars, InsertString, Undo, Redo, and SetStyleAt.
 // SetStyleAt does not change the persistent state of a document
 
-bool Document::DeleteChars(int pos, int len) {
+bool Document::DeleteChars(Position pos, Position len) {
 	if (len == 0)
 		return false;
 	if ((pos + len) > Length())
@@ -557,7 +693,7 @@ bool Document::DeleteChars(int pos, int len) {
 			        SC_MOD_BEFOREDELETE | SC_PERFORMED_USER,
 			        pos, len,
 			        0, 0));
-			int prevLinesTotal = LinesTotal();
+			Sci_Position prevLinesTotal = LinesTotal();
 			bool startSavePoint = cb.IsSavePoint();
 			bool startSequence = false;
 			const char *text = cb.DeleteChars(pos, len, startSequence);
@@ -581,7 +717,7 @@ bool Document::DeleteChars(int pos, int len) {
 /**
  * Insert a string with a length.
  */
-bool Document::InsertString(int position, const char *s, int insertLength) {
+bool Document::InsertString(Position position, const char *s, Position insertLength) {
 	if (insertLength <= 0) {
 		return false;
 	}
@@ -596,7 +732,7 @@ bool Document::InsertString(int position, const char *s, int insertLength) {
 			        SC_MOD_BEFOREINSERT | SC_PERFORMED_USER,
 			        position, insertLength,
 			        0, s));
-			int prevLinesTotal = LinesTotal();
+			Sci_Position prevLinesTotal = LinesTotal();
 			bool startSavePoint = cb.IsSavePoint();
 			bool startSequence = false;
 			const char *text = cb.InsertString(position, s, insertLength, startSequence);
@@ -614,8 +750,60 @@ bool Document::InsertString(int position, const char *s, int insertLength) {
 	return !cb.IsReadOnly();
 }
 
-int Document::Undo() {
-	int newPos = -1;
+/**
+ * Show text owned by the container, such as a memory mapped file, without copying it.
+ * The document is read-only while text is attached. Attaching a null pointer leaves
+ * an empty editable document.
+ */
+bool Document::AttachReadOnlyText(const char *s, Position length) {
+	if (enteredModification != 0)
+		return false;
+	enteredModification++;
+	bool startSavePoint = cb.IsSavePoint();
+	Position lengthPrevious = Length();
+	if (lengthPrevious > 0) {
+		NotifyModified(DocModification(SC_MOD_BEFOREDELETE | SC_PERFORMED_USER, 0, lengthPrevious, 0, 0));
+		Sci_Position prevLinesTotal = LinesTotal();
+		cb.AttachExternal(0, 0);
+		ModifiedAt(0);
+		NotifyModified(DocModification(SC_MOD_DELETETEXT | SC_PERFORMED_USER, 0, lengthPrevious,
+			LinesTotal() - prevLinesTotal, 0));
+	}
+	if (s && (length > 0)) {
+		NotifyModified(DocModification(SC_MOD_BEFOREINSERT | SC_PERFORMED_USER, 0, length, 0, s));
+		Sci_Position prevLinesTotal = LinesTotal();
+		cb.AttachExternal(s, length);
+		ModifiedAt(0);
+		NotifyModified(DocModification(SC_MOD_INSERTTEXT | SC_PERFORMED_USER, 0, length,
+			LinesTotal() - prevLinesTotal, s));
+	} else {
+		cb.AttachExternal(0, 0);
+	}
+	if (!startSavePoint)
+		NotifySavePoint(true);
+	enteredModification--;
+	return true;
+}
+
+void Document::PerformLineEndsStep(const Action &action, int performed, int step, int steps, bool multiLine) {
+	if (performed == SC_PERFORMED_UNDO)
+		cb.PerformUndoStep();
+	else
+		cb.PerformRedoStep();
+	int modFlags = performed;
+	if (steps > 1)
+		modFlags |= SC_MULTISTEPUNDOREDO;
+	if (step == steps - 1) {
+		modFlags |= SC_LASTSTEPINUNDOREDO;
+		if (multiLine)
+			modFlags |= SC_MULTILINEUNDOREDO;
+	}
+	// Performing the step left the line ends from before it in the action
+	NotifyLineEndsChanged(modFlags, LineFromPosition(action.position), action.data, action.lenData);
+}
+
+Position Document::Undo() {
+	Position newPos = -1;
 	CheckReadOnly();
 	if (enteredModification == 0) {
 		enteredModification++;
@@ -625,21 +813,26 @@ int Document::Undo() {
 			int steps = cb.StartUndo();
 			//Platform::DebugPrintf("Steps=%d\n", steps);
 			for (int step = 0; step < steps; step++) {
-				const int prevLinesTotal = LinesTotal();
+				const Sci_Position prevLinesTotal = LinesTotal();
 				const Action &action = cb.GetUndoStep();
+				if (action.at == lineEndsAction) {
+					// Selections were moved to the same place in their lines so leave newPos
+					PerformLineEndsStep(action, SC_PERFORMED_UNDO, step, steps, multiLine);
+					continue;
+				}
 				if (action.at == removeAction) {
 					NotifyModified(DocModification(
 									SC_MOD_BEFOREINSERT | SC_PERFORMED_UNDO, action));
 				} else if (action.at == containerAction) {
 					DocModification dm(SC_MOD_CONTAINER | SC_PERFORMED_UNDO);
-					dm.token = action.position;
+					dm.token = static_cast<int>(action.position);
 					NotifyModified(dm);
 				} else {
 					NotifyModified(DocModification(
 									SC_MOD_BEFOREDELETE | SC_PERFORMED_UNDO, action));
 				}
 				cb.PerformUndoStep();
-				int cellPosition = action.position;
+				Position cellPosition = action.position;
 				if (action.at != containerAction) {
 					ModifiedAt(cellPosition);
 					newPos = cellPosition;
@@ -655,7 +848,7 @@ int Document::Undo() {
 				}
 				if (steps > 1)
 					modFlags |= SC_MULTISTEPUNDOREDO;
-				const int linesAdded = LinesTotal() - prevLinesTotal;
+				const Sci_Position linesAdded = LinesTotal() - prevLinesTotal;
 				if (linesAdded != 0)
 					multiLine = true;
 				if (step == steps - 1) {
@@ -676,8 +869,8 @@ int Document::Undo() {
 	return newPos;
 }
 
-int Document::Redo() {
-	int newPos = -1;
+Position Document::Redo() {
+	Position newPos = -1;
 	CheckReadOnly();
 	if (enteredModification == 0) {
 		enteredModification++;
@@ -686,14 +879,19 @@ int Document::Redo() {
 			bool multiLine = false;
 			int steps = cb.StartRedo();
 			for (int step = 0; step < steps; step++) {
-				const int prevLinesTotal = LinesTotal();
+				const Sci_Position prevLinesTotal = LinesTotal();
 				const Action &action = cb.GetRedoStep();
+				if (action.at == lineEndsAction) {
+					// Selections were moved to the same place in their lines so leave newPos
+					PerformLineEndsStep(action, SC_PERFORMED_REDO, step, steps, multiLine);
+					continue;
+				}
 				if (action.at == insertAction) {
 					NotifyModified(DocModification(
 									SC_MOD_BEFOREINSERT | SC_PERFORMED_REDO, action));
 				} else if (action.at == containerAction) {
 					DocModification dm(SC_MOD_CONTAINER | SC_PERFORMED_REDO);
-					dm.token = action.position;
+					dm.token = static_cast<int>(action.position);
 					NotifyModified(dm);
 				} else {
 					NotifyModified(DocModification(
@@ -714,7 +912,7 @@ int Document::Redo() {
 				}
 				if (steps > 1)
 					modFlags |= SC_MULTISTEPUNDOREDO;
-				const int linesAdded = LinesTotal() - prevLinesTotal;
+				const Sci_Position linesAdded = LinesTotal() - prevLinesTotal;
 				if (linesAdded != 0)
 					multiLine = true;
 				if (step == steps - 1) {
@@ -739,7 +937,7 @@ int Document::Redo() {
 /**
  * Insert a single character.
  */
-bool Document::InsertChar(int pos, char ch) {
+bool Document::InsertChar(Position pos, char ch) {
 	char chs[1];
 	chs[0] = ch;
 	return InsertString(pos, chs, 1);
@@ -748,26 +946,26 @@ bool Document::InsertChar(int pos, char ch) {
 /**
  * Insert a null terminated string.
  */
-bool Document::InsertCString(int position, const char *s) {
+bool Document::InsertCString(Position position, const char *s) {
 	return InsertString(position, s, strlen(s));
 }
 
-void Document::ChangeChar(int pos, char ch) {
+void Document::ChangeChar(Position pos, char ch) {
 	DeleteChars(pos, 1);
 	InsertChar(pos, ch);
 }
 
-void Document::DelChar(int pos) {
+void Document::DelChar(Position pos) {
 	DeleteChars(pos, LenChar(pos));
 }
 
-void Document::DelCharBack(int pos) {
+void Document::DelCharBack(Position pos) {
 	if (pos <= 0) {
 		return;
 	} else if (IsCrLf(pos - 2)) {
 		DeleteChars(pos - 2, 2);
 	} else if (dbcsCodePage) {
-		int startChar = MovePositionOutsideChar(pos - 1, -1, false);
+		Position startChar = MovePositionOutsideChar(pos - 1, -1, false);
 		DeleteChars(startChar, pos - startChar);
 	} else {
 		DeleteChars(pos - 1, 1);
@@ -799,12 +997,12 @@ static void CreateIndentation(char *linebuf, int length, int indent, int tabSize
 	*linebuf = '\0';
 }
 
-int Document::GetLineIndentation(int line) {
+int Document::GetLineIndentation(Sci_Position line) {
 	int indent = 0;
 	if ((line >= 0) && (line < LinesTotal())) {
-		int lineStart = LineStart(line);
-		int length = Length();
-		for (int i = lineStart; i < length; i++) {
+		Position lineStart = LineStart(line);
+		Position length = Length();
+		for (Position i = lineStart; i < length; i++) {
 			char ch = cb.CharAt(i);
 			if (ch == ' ')
 				indent++;
@@ -817,37 +1015,37 @@ int Document::GetLineIndentation(int line) {
 	return indent;
 }
 
-void Document::SetLineIndentation(int line, int indent) {
+void Document::SetLineIndentation(Sci_Position line, int indent) {
 	int indentOfLine = GetLineIndentation(line);
 	if (indent < 0)
 		indent = 0;
 	if (indent != indentOfLine) {
 		char linebuf[1000];
 		CreateIndentation(linebuf, sizeof(linebuf), indent, tabInChars, !useTabs);
-		int thisLineStart = LineStart(line);
-		int indentPos = GetLineIndentPosition(line);
+		Position thisLineStart = LineStart(line);
+		Position indentPos = GetLineIndentPosition(line);
 		UndoGroup ug(this);
 		DeleteChars(thisLineStart, indentPos - thisLineStart);
 		InsertCString(thisLineStart, linebuf);
 	}
 }
 
-int Document::GetLineIndentPosition(int line) const {
+Position Document::GetLineIndentPosition(Sci_Position line) const {
 	if (line < 0)
 		return 0;
-	int pos = LineStart(line);
-	int length = Length();
+	Position pos = LineStart(line);
+	Position length = Length();
 	while ((pos < length) && isindentchar(cb.CharAt(pos))) {
 		pos++;
 	}
 	return pos;
 }
 
-int Document::GetColumn(int pos) {
+int Document::GetColumn(Position pos) {
 	int column = 0;
-	int line = LineFromPosition(pos);
+	Sci_Position line = LineFromPosition(pos);
 	if ((line >= 0) && (line < LinesTotal())) {
-		for (int i = LineStart(line); i < pos;) {
+		for (Position i = LineStart(line); i < pos;) {
 			char ch = cb.CharAt(i);
 			if (ch == '\t') {
 				column = NextTab(column, tabInChars);
@@ -867,8 +1065,8 @@ int Document::GetColumn(int pos) {
 	return column;
 }
 
-int Document::FindColumn(int line, int column) {
-	int position = LineStart(line);
+Position Document::FindColumn(Sci_Position line, int column) {
+	Position position = LineStart(line);
 	if ((line >= 0) && (line < LinesTotal())) {
 		int columnCurrent = 0;
 		while ((columnCurrent < column) && (position < Length())) {
@@ -889,9 +1087,9 @@ int Document::FindColumn(int line, int column) {
 	return position;
 }
 
-void Document::Indent(bool forwards, int lineBottom, int lineTop) {
+void Document::Indent(bool forwards, Sci_Position lineBottom, Sci_Position lineTop) {
 	// Dedent - suck white space off the front of the line to dedent by equivalent of a tab
-	for (int line = lineBottom; line >= lineTop; line--) {
+	for (Sci_Position line = lineBottom; line >= lineTop; line--) {
 		int indentOfLine = GetLineIndentation(line);
 		if (forwards) {
 			if (LineStart(line) < LineEnd(line)) {
@@ -930,51 +1128,137 @@ char *Document::TransformLineEnds(int *pLenOut, const char *s, size_t len, int e
 		}
 	}
 	*dptr++ = '\0';
-	*pLenOut = (dptr - dest) - 1;
+	*pLenOut = static_cast<int>(dptr - dest) - 1;
 	return dest;
 }
 
+/**
+ * Change every line end to eolModeSet in one pass. The lines from the first to the last
+ * line end that differs are rewritten as a single undo action and reported as one
+ * SC_MOD_CHANGELINEENDS that leaves the number of lines unchanged.
+ */
 void Document::ConvertLineEnds(int eolModeSet) {
-	UndoGroup ug(this);
-
-	for (int pos = 0; pos < Length(); pos++) {
-		if (cb.CharAt(pos) == '\r') {
-			if (cb.CharAt(pos + 1) == '\n') {
-				// CRLF
-				if (eolModeSet == SC_EOL_CR) {
-					DeleteChars(pos + 1, 1); // Delete the LF
-				} else if (eolModeSet == SC_EOL_LF) {
-					DeleteChars(pos, 1); // Delete the CR
-				} else {
-					pos++;
-				}
-			} else {
-				// CR
-				if (eolModeSet == SC_EOL_CRLF) {
-					InsertString(pos + 1, "\n", 1); // Insert LF
-					pos++;
-				} else if (eolModeSet == SC_EOL_LF) {
-					InsertString(pos, "\n", 1); // Insert LF
-					DeleteChars(pos + 1, 1); // Delete CR
-				}
-			}
-		} else if (cb.CharAt(pos) == '\n') {
-			// LF
-			if (eolModeSet == SC_EOL_CRLF) {
-				InsertString(pos, "\r", 1); // Insert CR
-				pos++;
-			} else if (eolModeSet == SC_EOL_CR) {
-				InsertString(pos, "\r", 1); // Insert CR
-				DeleteChars(pos + 1, 1); // Delete LF
-			}
+	if ((eolModeSet != SC_EOL_CRLF) && (eolModeSet != SC_EOL_CR) && (eolModeSet != SC_EOL_LF))
+		return;
+	CheckReadOnly();
+	if ((enteredModification != 0) || cb.IsReadOnly())
+		return;
+	Sci_Position lineFirst = -1;
+	Sci_Position lineLast = -1;
+	const Sci_Position lines = LinesTotal();
+	for (Sci_Position line = 0; line < lines - 1; line++) {
+		if (cb.LineEndMode(line) != eolModeSet) {
+			if (lineFirst < 0)
+				lineFirst = line;
+			lineLast = line;
+		}
+	}
+	if (lineFirst < 0)
+		return;
+	enteredModification++;
+	const Sci_Position linesChange = lineLast - lineFirst + 1;
+	char *ends = new char[linesChange];
+	memset(ends, eolModeSet, linesChange);
+	bool startSavePoint = cb.IsSavePoint();
+	bool startSequence = false;
+	// Changing the line ends leaves the previous line ends in ends
+	cb.ChangeLineEnds(LineStart(lineFirst), ends, linesChange, startSequence);
+	if (startSavePoint && cb.IsCollectingUndo())
+		NotifySavePoint(!startSavePoint);
+	NotifyLineEndsChanged(SC_PERFORMED_USER | (startSequence?SC_STARTACTION:0),
+		lineFirst, ends, linesChange);
+	delete []ends;
+	enteredModification--;
+}
+
+/**
+ * The line ends of lines from line have changed from endsBefore. Indicators are moved
+ * as the separate edits of each line end by earlier versions did, or as their undo did.
+ * Watchers are sent SC_MOD_CHANGELINEENDS and may move positions from before the change
+ * with MovePositionForLineEnds.
+ */
+void Document::NotifyLineEndsChanged(int modFlags, Sci_Position line, const char *endsBefore, Sci_Position lines) {
+	const Position position = LineStart(line);
+	ModifiedAt(position);
+	lineEndsFirst = line;
+	lineEndsStartsBefore.resize(lines + 1);
+	lineEndsStartsBefore[0] = position;
+	Position delta = 0;
+	for (Sci_Position i = 0; i < lines; i++) {
+		const Position lengthEndBefore = (endsBefore[i] == SC_EOL_CRLF) ? 2 : 1;
+		delta += LineStart(line + i + 1) - LineEnd(line + i) - lengthEndBefore;
+		lineEndsStartsBefore[i + 1] = LineStart(line + i + 1) - delta;
+	}
+	if (decorations.AllOn() == 0) {
+		// Without indicators the decorations only need the change in length
+		if (delta > 0)
+			decorations.InsertSpace(position, delta);
+		else if (delta < 0)
+			decorations.DeleteRange(position, -delta);
+	} else if (modFlags & SC_PERFORMED_UNDO) {
+		// Undo reverses the edits from the last line back so earlier lines are still as before
+		for (Sci_Position i = lines - 1; i >= 0; i--) {
+			const Position lengthContent = LineEnd(line + i) - LineStart(line + i);
+			MoveIndicatorsForLineEnd(lineEndsStartsBefore[i] + lengthContent, endsBefore[i],
+				cb.LineEndMode(line + i), true);
 		}
+	} else {
+		for (Sci_Position i = 0; i < lines; i++) {
+			MoveIndicatorsForLineEnd(LineEnd(line + i), endsBefore[i], cb.LineEndMode(line + i), false);
+		}
+	}
+	NotifyModified(DocModification(SC_MOD_CHANGELINEENDS | modFlags, position,
+		LineStart(line + lines) - position, 0, 0, line));
+	lineEndsStartsBefore.clear();
+}
+
+/**
+ * Move indicators for the line end at lineEnd changing from modeBefore to mode as inserting
+ * and deleting its bytes would. Changing between CR and LF inserted the new byte before
+ * deleting the old one, so undoing that inserts the byte back after the other one.
+ */
+void Document::MoveIndicatorsForLineEnd(Position lineEnd, int modeBefore, int mode, bool undo) {
+	if (mode == SC_EOL_CRLF) {
+		if (modeBefore == SC_EOL_CR)
+			decorations.InsertSpace(lineEnd + 1, 1);
+		else if (modeBefore == SC_EOL_LF)
+			decorations.InsertSpace(lineEnd, 1);
+	} else if (modeBefore == SC_EOL_CRLF) {
+		decorations.DeleteRange(lineEnd + ((mode == SC_EOL_CR) ? 1 : 0), 1);
+	} else if (mode != modeBefore) {
+		decorations.InsertSpace(lineEnd + (undo ? 1 : 0), 1);
+		decorations.DeleteRange(lineEnd + (undo ? 0 : 1), 1);
 	}
+}
 
+/**
+ * During SC_MOD_CHANGELINEENDS, move pos from before the change to the same offset in its
+ * line or to the end of its line when it was inside the line end.
+ */
+Position Document::MovePositionForLineEnds(Position pos) const {
+	if (lineEndsStartsBefore.empty() || (pos <= lineEndsStartsBefore.front()))
+		return pos;
+	const Sci_Position lines = lineEndsStartsBefore.size() - 1;
+	if (pos >= lineEndsStartsBefore.back())
+		return pos + LineStart(lineEndsFirst + lines) - lineEndsStartsBefore.back();
+	// Find the changed line containing pos
+	Sci_Position lower = 0;
+	Sci_Position upper = lines;
+	while (upper - lower > 1) {
+		const Sci_Position middle = (lower + upper) / 2;
+		if (lineEndsStartsBefore[middle] <= pos)
+			lower = middle;
+		else
+			upper = middle;
+	}
+	const Sci_Position line = lineEndsFirst + lower;
+	const Position moved = LineStart(line) + pos - lineEndsStartsBefore[lower];
+	return (moved < LineEnd(line)) ? moved : LineEnd(line);
 }
 
-bool Document::IsWhiteLine(int line) const {
-	int currentChar = LineStart(line);
-	int endLine = LineEnd(line);
+bool Document::IsWhiteLine(Sci_Position line) const {
+	Position currentChar = LineStart(line);
+	Position endLine = LineEnd(line);
 	while (currentChar < endLine) {
 		if (cb.CharAt(currentChar) != ' ' && cb.CharAt(currentChar) != '\t') {
 			return false;
@@ -984,8 +1268,8 @@ bool Document::IsWhiteLine(int line) const {
 	return true;
 }
 
-int Document::ParaUp(int pos) {
-	int line = LineFromPosition(pos);
+Position Document::ParaUp(Position pos) {
+	Sci_Position line = LineFromPosition(pos);
 	line--;
 	while (line >= 0 && IsWhiteLine(line)) { // skip empty lines
 		line--;
@@ -997,8 +1281,8 @@ int Document::ParaUp(int pos) {
 	return LineStart(line);
 }
 
-int Document::ParaDown(int pos) {
-	int line = LineFromPosition(pos);
+Position Document::ParaDown(Position pos) {
+	Sci_Position line = LineFromPosition(pos);
 	while (line < LinesTotal() && !IsWhiteLine(line)) { // skip non-empty lines
 		line++;
 	}
@@ -1021,7 +1305,7 @@ CharClassify::cc Document::WordCharClass(unsigned char ch) {
  * Used by commmands that want to select whole words.
  * Finds the start of word at pos when delta < 0 or the end of the word when delta >= 0.
  */
-int Document::ExtendWordSelect(int pos, int delta, bool onlyWordCharacters) {
+Position Document::ExtendWordSelect(Position pos, int delta, bool onlyWordCharacters) {
 	CharClassify::cc ccStart = CharClassify::ccWord;
 	if (delta < 0) {
 		if (!onlyWordCharacters)
@@ -1044,7 +1328,7 @@ int Document::ExtendWordSelect(int pos, int delta, bool onlyWordCharacters) {
  * additional movement to transit white space.
  * Used by cursor movement by word commands.
  */
-int Document::NextWordStart(int pos, int delta) {
+Position Document::NextWordStart(Position pos, int delta) {
 	if (delta < 0) {
 		while (pos > 0 && (WordCharClass(cb.CharAt(pos - 1)) == CharClassify::ccSpace))
 			pos--;
@@ -1071,7 +1355,7 @@ int Document::NextWordStart(int pos, int delta) {
  * additional movement to transit white space.
  * Used by cursor movement by word commands.
  */
-int Document::NextWordEnd(int pos, int delta) {
+Position Document::NextWordEnd(Position pos, int delta) {
 	if (delta < 0) {
 		if (pos > 0) {
 			CharClassify::cc ccStart = WordCharClass(cb.CharAt(pos-1));
@@ -1102,7 +1386,7 @@ int Document::NextWordEnd(int pos, int delta) {
  * Check that the character at the given position is a word or punctuation character and that
  * the previous character is of a different character class.
  */
-bool Document::IsWordStartAt(int pos) {
+bool Document::IsWordStartAt(Position pos) {
 	if (pos > 0) {
 		CharClassify::cc ccPos = WordCharClass(CharAt(pos));
 		return (ccPos == CharClassify::ccWord || ccPos == CharClassify::ccPunctuation) &&
@@ -1115,7 +1399,7 @@ bool Document::IsWordStartAt(int pos) {
  * Check that the character at the given position is a word or punctuation character and that
  * the next character is of a different character class.
  */
-bool Document::IsWordEndAt(int pos) {
+bool Document::IsWordEndAt(Position pos) {
 	if (pos < Length()) {
 		CharClassify::cc ccPrev = WordCharClass(CharAt(pos-1));
 		return (ccPrev == CharClassify::ccWord || ccPrev == CharClassify::ccPunctuation) &&
@@ -1128,7 +1412,7 @@ bool Document::IsWordEndAt(int pos) {
  * Check that the given range is has transitions between character classes at both
  * ends and where the characters on the inside are word or punctuation characters.
  */
-bool Document::IsWordAt(int start, int end) {
+bool Document::IsWordAt(Position start, Position end) {
 	return IsWordStartAt(start) && IsWordEndAt(end);
 }
 
@@ -1143,7 +1427,7 @@ static bool GoodTrailByte(int v) {
 	return (v >= 0x80) && (v < 0xc0);
 }
 
-size_t Document::ExtractChar(int pos, char *bytes) {
+size_t Document::ExtractChar(Position pos, char *bytes) {
 	unsigned char ch = static_cast<unsigned char>(cb.CharAt(pos));
 	size_t widthChar = UTF8CharLength(ch);
 	bytes[0] = ch;
@@ -1190,7 +1474,257 @@ void CaseFolderTable::StandardASCII() {
 	}
 }
 
-bool Document::MatchesWordOptions(bool word, bool wordStart, int pos, int length) {
+/**
+ * Finds a sequence of bytes in a cell buffer without calling CharAt for each byte.
+ * Text is read through pointers into the two parts of the buffer either side of the
+ * gap. Only windows that cross the gap, or that need case folding, are copied.
+ * Short patterns are found with memchr on their first byte and longer patterns
+ * with Boyer-Moore-Horspool, which is run right to left for backward searches.
+ */
+class ByteSearch {
+	const CellBuffer &cb;
+	std::vector<char> pattern;
+	int lengthPattern;
+	bool folding;
+	char foldTable[256];	// Folded value of each byte when folding
+	int shiftForward[256];
+	int shiftBackward[256];
+	std::vector<char> window;
+	Position windowStart;
+	Position windowLength;
+	enum { windowFirst = 0x100, windowSize = 0x10000, longPattern = 8 };
+
+	const char *Text(Position start, Position &lengthText, bool mayShorten);
+	int FindInText(const char *text, int lengthText) const;
+	int FindInTextBackward(const char *text, int lengthText) const;
+public:
+	/// A case folder is only given for case insensitive searches.
+	ByteSearch(const CellBuffer &cb_, const char *search, int lengthSearch, CaseFolder *pcf);
+	int Length() const { return lengthPattern; }
+	Position Forward(Position start, Position last);
+	Position Backward(Position last, Position start);
+};
+
+ByteSearch::ByteSearch(const CellBuffer &cb_, const char *search, int lengthSearch, CaseFolder *pcf) :
+	cb(cb_), pattern(search, search + lengthSearch), lengthPattern(lengthSearch), folding(pcf != 0),
+	windowStart(0), windowLength(0) {
+	pattern.push_back('\0');
+	if (folding) {
+		// Bytes are folded independently
+		pcf->Fold(&pattern[0], pattern.size(), search, lengthSearch);
+		for (int ch = 0; ch < 256; ch++) {
+			const char chMixed = static_cast<char>(ch);
+			char folded[2];
+			pcf->Fold(folded, sizeof(folded), &chMixed, 1);
+			foldTable[ch] = folded[0];
+		}
+	}
+	for (int ch = 0; ch < 256; ch++) {
+		shiftForward[ch] = lengthPattern;
+		shiftBackward[ch] = lengthPattern;
+	}
+	for (int i = 0; i < lengthPattern - 1; i++)
+		shiftForward[static_cast<unsigned char>(pattern[i])] = lengthPattern - 1 - i;
+	for (int i = lengthPattern - 1; i > 0; i--)
+		shiftBackward[static_cast<unsigned char>(pattern[i])] = i;
+}
+
+/**
+ * Text of a window which is copied only when it crosses the gap or needs folding.
+ * A copied window is kept so that searching on from a match reuses it. When mayShorten
+ * is set, less text than asked for may be returned from the kept window.
+ */
+const char *ByteSearch::Text(Position start, Position &lengthText, bool mayShorten) {
+	if (!folding) {
+		Position lengthSegment = 0;
+		const char *segment = cb.SegmentPointer(start, lengthSegment);
+		if (lengthSegment >= lengthText)
+			return segment;
+	}
+	if ((start >= windowStart) && (start < windowStart + windowLength)) {
+		const Position lengthKept = windowStart + windowLength - start;
+		if ((lengthKept >= lengthText) || (mayShorten && (lengthKept >= lengthPattern))) {
+			if (lengthText > lengthKept)
+				lengthText = lengthKept;
+			return &window[start - windowStart];
+		}
+	}
+	window.resize(lengthText);
+	cb.GetCharRange(&window[0], start, lengthText);
+	if (folding) {
+		for (Position i = 0; i < lengthText; i++)
+			window[i] = foldTable[static_cast<unsigned char>(window[i])];
+	}
+	windowStart = start;
+	windowLength = lengthText;
+	return &window[0];
+}
+
+int ByteSearch::FindInText(const char *text, int lengthText) const {
+	const int lastStart = lengthText - lengthPattern;
+	if (lengthPattern < longPattern) {
+		const char first = pattern[0];
+		const char *textStart = text;
+		const char *textEnd = text + lastStart + 1;
+		while (textStart < textEnd) {
+			const char *candidate = static_cast<const char *>(
+				memchr(textStart, first, textEnd - textStart));
+			if (!candidate)
+				return -1;
+			if (memcmp(candidate + 1, &pattern[1], lengthPattern - 1) == 0)
+				return static_cast<int>(candidate - text);
+			textStart = candidate + 1;
+		}
+	} else {
+		const char last = pattern[lengthPattern - 1];
+		for (int candidate = 0; candidate <= lastStart;) {
+			const char ch = text[candidate + lengthPattern - 1];
+			if ((ch == last) && (memcmp(text + candidate, &pattern[0], lengthPattern - 1) == 0))
+				return candidate;
+			candidate += shiftForward[static_cast<unsigned char>(ch)];
+		}
+	}
+	return -1;
+}
+
+int ByteSearch::FindInTextBackward(const char *text, int lengthText) const {
+	const char first = pattern[0];
+	if (lengthPattern < longPattern) {
+		for (int candidate = lengthText - lengthPattern; candidate >= 0; candidate--) {
+			if ((text[candidate] == first) && (memcmp(text + candidate + 1, &pattern[1], lengthPattern - 1) == 0))
+				return candidate;
+		}
+	} else {
+		for (int candidate = lengthText - lengthPattern; candidate >= 0;) {
+			const char ch = text[candidate];
+			if ((ch == first) && (memcmp(text + candidate + 1, &pattern[1], lengthPattern - 1) == 0))
+				return candidate;
+			candidate -= shiftBackward[static_cast<unsigned char>(ch)];
+		}
+	}
+	return -1;
+}
+
+/// @return the first match starting from start to last or -1.
+Position ByteSearch::Forward(Position start, Position last) {
+	if (lengthPattern == 0)
+		return (start <= last) ? start : -1;
+	// Windows grow so that a nearby match does not copy much text
+	Position limit = windowFirst;
+	while (start <= last) {
+		Position candidates = last - start + 1;
+		if (candidates > limit)
+			candidates = limit;
+		Position lengthText = candidates + lengthPattern - 1;
+		const char *text = Text(start, lengthText, true);
+		const int found = FindInText(text, static_cast<int>(lengthText));
+		if (found >= 0)
+			return start + found;
+		start += lengthText - lengthPattern + 1;
+		if (limit < windowSize)
+			limit *= 2;
+	}
+	return -1;
+}
+
+/// @return the last match starting from last back to start or -1.
+Position ByteSearch::Backward(Position last, Position start) {
+	if (lengthPattern == 0)
+		return (start <= last) ? last : -1;
+	Position limit = windowFirst;
+	while (start <= last) {
+		Position candidates = last - start + 1;
+		if (candidates > limit)
+			candidates = limit;
+		const Position windowFrom = last - candidates + 1;
+		Position lengthText = candidates + lengthPattern - 1;
+		const char *text = Text(windowFrom, lengthText, false);
+		const int found = FindInTextBackward(text, static_cast<int>(lengthText));
+		if (found >= 0)
+			return windowFrom + found;
+		last = windowFrom - 1;
+		if (limit < windowSize)
+			limit *= 2;
+	}
+	return -1;
+}
+
+/**
+ * Find the first or last match of a ByteSearch from startPos to endPos which is at the
+ * start of a character and satisfies the word options.
+ */
+Position Document::FindBytes(ByteSearch &searcher, bool forward, Position startPos, Position endPos,
+	bool word, bool wordStart) {
+	const int increment = forward ? 1 : -1;
+	const int lengthFind = searcher.Length();
+	const Position endSearch = forward ? endPos - lengthFind + 1 : endPos;
+	const Position limitPos = (startPos > endPos) ? startPos : endPos;
+	// Last position at which a match fits inside the range
+	const Position lastStart = forward ? (endSearch - 1) : (limitPos - lengthFind);
+	Position pos = forward ? startPos : (startPos - 1);
+	if (!forward && (pos > lastStart))
+		pos = lastStart;
+	while (forward ? (pos <= lastStart) : (pos >= endSearch)) {
+		pos = forward ? searcher.Forward(pos, lastStart) : searcher.Backward(pos, endSearch);
+		if (pos < 0)
+			break;
+		// With DBCS, only matches at the start of a character count, except for the
+		// first backward position which is not moved
+		const bool atCharacter = !dbcsCodePage || (!forward && (pos == startPos - 1)) ||
+			(MovePositionOutsideChar(pos, increment, false) == pos);
+		if (atCharacter && MatchesWordOptions(word, wordStart, pos, lengthFind)) {
+			return pos;
+		}
+		pos += increment;
+	}
+	return -1;
+}
+
+/// @return the first position from pos before end whose byte is not skipped or end.
+Position Document::SkipBytesForward(const bool *skip, Position pos, Position end) const {
+	// Only read bytes inside the document
+	if (pos < 0)
+		pos = 0;
+	const Position endInside = (end < Length()) ? end : Length();
+	while (pos < endInside) {
+		Position lengthSegment = 0;
+		const char *segment = cb.SegmentPointer(pos, lengthSegment);
+		if (lengthSegment > endInside - pos)
+			lengthSegment = endInside - pos;
+		for (Position i = 0; i < lengthSegment; i++) {
+			if (!skip[static_cast<unsigned char>(segment[i])])
+				return pos + i;
+		}
+		pos += lengthSegment;
+	}
+	return end;
+}
+
+/// @return the last position from pos back to start whose byte is not skipped or start - 1.
+Position Document::SkipBytesBackward(const bool *skip, Position pos, Position start) const {
+	// Only read bytes inside the document
+	const Position startInside = (start > 0) ? start : 0;
+	if (pos >= Length())
+		pos = Length() - 1;
+	while (pos >= startInside) {
+		Position segmentStart = startInside;
+		Position lengthSegment = 0;
+		const char *segment = cb.SegmentPointer(segmentStart, lengthSegment);
+		if (segmentStart + lengthSegment <= pos) {
+			// The gap is between start and pos so scan the part after the gap
+			segmentStart += lengthSegment;
+			segment = cb.SegmentPointer(segmentStart, lengthSegment);
+		}
+		for (Position i = pos - segmentStart; i >= 0; i--) {
+			if (!skip[static_cast<unsigned char>(segment[i])])
+				return segmentStart + i;
+		}
+		pos = segmentStart - 1;
+	}
+	return start - 1;
+}
+
+bool Document::MatchesWordOptions(bool word, bool wordStart, Position pos, Position length) {
 	return (!word && !wordStart) ||
 			(word && IsWordAt(pos, pos + length)) ||
 			(wordStart && IsWordStartAt(pos));
@@ -1201,7 +1735,7 @@ bool Document::MatchesWordOptions(bool word, bool wordStart, int pos, int length
  * searches (just pass minPos > maxPos to do a backward search)
  * Has not been tested with backwards DBCS searches yet.
  */
-long Document::FindText(int minPos, int maxPos, const char *search,
+long Document::FindText(Position minPos, Position maxPos, const char *search,
                         bool caseSensitive, bool word, bool wordStart, bool regExp, int flags,
                         int *length, CaseFolder *pcf) {
 	if (regExp) {
@@ -1214,39 +1748,49 @@ long Document::FindText(int minPos, int maxPos, const char *search,
 		const int increment = forward ? 1 : -1;
 
 		// Range endpoints should not be inside DBCS characters, but just in case, move them.
-		const int startPos = MovePositionOutsideChar(minPos, increment, false);
-		const int endPos = MovePositionOutsideChar(maxPos, increment, false);
+		const Position startPos = MovePositionOutsideChar(minPos, increment, false);
+		const Position endPos = MovePositionOutsideChar(maxPos, increment, false);
 
 		// Compute actual search ranges needed
 		const int lengthFind = (*length == -1) ? static_cast<int>(strlen(search)) : *length;
-		const int endSearch = (startPos <= endPos) ? endPos - lengthFind + 1 : endPos;
+		const Position endSearch = forward ? endPos - lengthFind + 1 : endPos;
 
 		//Platform::DebugPrintf("Find %d %d %s %d\n", startPos, endPos, ft->lpstrText, lengthFind);
-		const int limitPos = Platform::Maximum(startPos, endPos);
-		int pos = forward ? startPos : (startPos - 1);
-		if (caseSensitive) {
-			while (forward ? (pos < endSearch) : (pos >= endSearch)) {
-				bool found = (pos + lengthFind) <= limitPos;
-				for (int indexSearch = 0; (indexSearch < lengthFind) && found; indexSearch++) {
-					found = CharAt(pos + indexSearch) == search[indexSearch];
-				}
-				if (found && MatchesWordOptions(word, wordStart, pos, lengthFind)) {
-					return pos;
-				}
-				pos += increment;
-				if (dbcsCodePage && (pos >= 0)) {
-					// Have to use >= 0 as otherwise next statement would change
-					// -1 to 0 and make loop infinite.
-					// Ensure trying to match from start of character
-					pos = MovePositionOutsideChar(pos, increment, false);
-				}
-			}
+		const Position limitPos = (startPos > endPos) ? startPos : endPos;
+		Position pos = forward ? startPos : (startPos - 1);
+		if (caseSensitive || (SC_CP_UTF8 != dbcsCodePage)) {
+			ByteSearch searcher(cb, search, lengthFind, caseSensitive ? 0 : pcf);
+			return FindBytes(searcher, forward, startPos, endPos, word, wordStart);
 		} else if (SC_CP_UTF8 == dbcsCodePage) {
 			const size_t maxBytesCharacter = 4;
 			const size_t maxFoldingExpansion = 4;
 			std::vector<char> searchThing(lengthFind * maxBytesCharacter * maxFoldingExpansion + 1);
 			const int lenSearch = pcf->Fold(&searchThing[0], searchThing.size(), search, lengthFind);
+			// ASCII bytes that can not start a match are skipped without extracting and folding
+			// each character. Other bytes may be part of a character that folds to the start.
+			bool skip[0x100];
+			for (int ch = 0; ch < 0x100; ch++) {
+				skip[ch] = false;
+				if ((ch < 0x80) && (lenSearch > 0)) {
+					const char chMixed = static_cast<char>(ch);
+					char folded[maxFoldingExpansion + 1];
+					const int lenFlat = static_cast<int>(pcf->Fold(folded, sizeof(folded), &chMixed, 1));
+					skip[ch] = memcmp(folded, &searchThing[0], Platform::Minimum(lenFlat, lenSearch)) != 0;
+				}
+			}
 			while (forward ? (pos < endSearch) : (pos >= endSearch)) {
+				if (forward) {
+					pos = SkipBytesForward(skip, pos, endSearch);
+					if (pos >= endSearch)
+						break;
+				} else {
+					const Position posBefore = pos;
+					pos = SkipBytesBackward(skip, pos, endSearch);
+					if (pos < endSearch)
+						break;
+					if ((pos != posBefore) && (pos > 0))
+						pos = MovePositionOutsideChar(pos, increment, false);
+				}
 				int widthFirstCharacter = 0;
 				int indexDocument = 0;
 				int indexSearch = 0;
@@ -1283,43 +1827,77 @@ long Document::FindText(int minPos, int maxPos, const char *search,
 					}
 				}
 			}
-		} else {
-			CaseFolderTable caseFolder;
-			std::vector<char> searchThing(lengthFind + 1);
-			pcf->Fold(&searchThing[0], searchThing.size(), search, lengthFind);
-			while (forward ? (pos < endSearch) : (pos >= endSearch)) {
-				bool found = (pos + lengthFind) <= limitPos;
-				for (int indexSearch = 0; (indexSearch < lengthFind) && found; indexSearch++) {
-					char ch = CharAt(pos + indexSearch);
-					char folded[2];
-					pcf->Fold(folded, sizeof(folded), &ch, 1);
-					found = folded[0] == searchThing[indexSearch];
-				}
-				if (found && MatchesWordOptions(word, wordStart, pos, lengthFind)) {
-					return pos;
-				}
-				pos += increment;
-				if (dbcsCodePage && (pos >= 0)) {
-					// Ensure trying to match from start of character
-					pos = MovePositionOutsideChar(pos, increment, false);
-				}
-			}
 		}
 	}
 	//Platform::DebugPrintf("Not found\n");
 	return -1;
 }
 
+/**
+ * Find every match from minPos to maxPos in one call, setting up the search once.
+ * Matches do not overlap. When fill is set, the current indicator is filled with the
+ * current value over each match and one indicator change is notified for them all.
+ * @return the number of matches.
+ */
+int Document::FindAll(Position minPos, Position maxPos, const char *search, bool caseSensitive, bool word,
+	bool wordStart, bool regExp, int flags, int length, CaseFolder *pcf, bool fill) {
+	if (minPos > maxPos) {
+		const Position posTemp = minPos;
+		minPos = maxPos;
+		maxPos = posTemp;
+	}
+	const int lengthFind = (length == -1) ? static_cast<int>(strlen(search)) : length;
+	if (lengthFind <= 0)
+		return 0;
+	Position pos = MovePositionOutsideChar(minPos, 1, false);
+	const Position endPos = MovePositionOutsideChar(maxPos, 1, false);
+	const bool bytes = !regExp && (caseSensitive || (SC_CP_UTF8 != dbcsCodePage));
+	ByteSearch searcher(cb, search, bytes ? lengthFind : 0, (bytes && !caseSensitive) ? pcf : 0);
+	const int value = decorations.GetCurrentValue();
+	Position changedStart = -1;
+	Position changedEnd = -1;
+	int matches = 0;
+	while (pos <= endPos) {
+		int lengthFound = lengthFind;
+		const Position found = bytes ? FindBytes(searcher, true, pos, endPos, word, wordStart) :
+			FindText(pos, endPos, search, caseSensitive, word, wordStart, regExp, flags, &lengthFound, pcf);
+		if (found < 0)
+			break;
+		matches++;
+		if (fill && (lengthFound > 0)) {
+			Sci_Position fillStart = found;
+			Sci_Position fillLength = lengthFound;
+			if (decorations.FillRange(fillStart, value, fillLength)) {
+				if (changedStart < 0)
+					changedStart = fillStart;
+				changedEnd = fillStart + fillLength;
+			}
+		}
+		pos = found + lengthFound;
+		if (lengthFound == 0) {
+			// An empty regular expression match moves on by a character
+			pos = found + 1;
+			if (dbcsCodePage && (pos < endPos))
+				pos = MovePositionOutsideChar(pos, 1, false);
+		}
+	}
+	if (changedStart >= 0) {
+		NotifyModified(DocModification(SC_MOD_CHANGEINDICATOR | SC_PERFORMED_USER,
+			changedStart, changedEnd - changedStart));
+	}
+	return matches;
+}
+
 const char *Document::SubstituteByPosition(const char *text, int *length) {
 	return regex->SubstituteByPosition(this, text, length);
 }
 
-int Document::LinesTotal() const {
+Sci_Position Document::LinesTotal() const {
 	return cb.Lines();
 }
 
 void Document::ChangeCase(Range r, bool makeUpperCase) {
-	for (int pos = r.start; pos < r.end;) {
+	for (Position pos = r.start; pos < r.end;) {
 		int len = LenChar(pos);
 		if (len == 1) {
 			char ch = CharAt(pos);
@@ -1350,18 +1928,18 @@ void Document::SetStylingBits(int bits) {
 	stylingBitsMask = (1 << stylingBits) - 1;
 }
 
-void SCI_METHOD Document::StartStyling(int position, char mask) {
+void SCI_METHOD Document::StartStyling(Position position, char mask) {
 	stylingMask = mask;
 	endStyled = position;
 }
 
-bool SCI_METHOD Document::SetStyleFor(int length, char style) {
+bool SCI_METHOD Document::SetStyleFor(Position length, char style) {
 	if (enteredStyling != 0) {
 		return false;
 	} else {
 		enteredStyling++;
 		style &= stylingMask;
-		int prevEndStyled = endStyled;
+		Position prevEndStyled = endStyled;
 		if (cb.SetStyleFor(endStyled, length, style, stylingMask)) {
 			DocModification mh(SC_MOD_CHANGESTYLE | SC_PERFORMED_USER,
 			                   prevEndStyled, length);
@@ -1373,15 +1951,15 @@ bool SCI_METHOD Document::SetStyleFor(int length, char style) {
 	}
 }
 
-bool SCI_METHOD Document::SetStyles(int length, const char *styles) {
+bool SCI_METHOD Document::SetStyles(Position length, const char *styles) {
 	if (enteredStyling != 0) {
 		return false;
 	} else {
 		enteredStyling++;
 		bool didChange = false;
-		int startMod = 0;
-		int endMod = 0;
-		for (int iPos = 0; iPos < length; iPos++, endStyled++) {
+		Position startMod = 0;
+		Position endMod = 0;
+		for (Position iPos = 0; iPos < length; iPos++, endStyled++) {
 			PLATFORM_ASSERT(endStyled < Length());
 			if (cb.SetStyleAt(endStyled, styles[iPos], stylingMask)) {
 				if (!didChange) {
@@ -1401,12 +1979,12 @@ bool SCI_METHOD Document::SetStyles(int length, const char *styles) {
 	}
 }
 
-void Document::EnsureStyledTo(int pos) {
+void Document::EnsureStyledTo(Position pos) {
 	if ((enteredStyling == 0) && (pos > GetEndStyled())) {
 		IncrementStyleClock();
 		if (pli) {
-			int lineEndStyled = LineFromPosition(GetEndStyled());
-			int endStyled = LineStart(lineEndStyled);
+			Sci_Position lineEndStyled = LineFromPosition(GetEndStyled());
+			Position endStyled = LineStart(lineEndStyled);
 			pli->Colourise(endStyled, pos);
 		} else {
 			// Ask the watchers to style, and stop as soon as one responds.
@@ -1417,6 +1995,38 @@ void Document::EnsureStyledTo(int pos) {
 	}
 }
 
+/**
+ * Style up to pos and use the time taken to improve the estimate of how long
+ * styling a line takes.
+ */
+void Document::StyleToAdjustingLineDuration(Position pos) {
+	const Sci_Position lineFirst = LineFromPosition(GetEndStyled());
+	ElapsedTime etStyling;
+	EnsureStyledTo(pos);
+	const double duration = etStyling.Duration();
+	const Sci_Position lines = LineFromPosition(GetEndStyled()) - lineFirst;
+	if (lines > 0) {
+		// Weight recent samples so the estimate follows changes in the text
+		const double alpha = 0.25;
+		const double durationOne = duration / lines;
+		durationStyleOneLine = alpha * durationOne + (1.0 - alpha) * durationStyleOneLine;
+		if (durationStyleOneLine < 0.000001)
+			durationStyleOneLine = 0.000001;
+		else if (durationStyleOneLine > 0.0001)
+			durationStyleOneLine = 0.0001;
+	}
+}
+
+/// How many lines can be styled in about this many seconds.
+Sci_Position Document::LinesToStyleIn(double seconds) const {
+	const Sci_Position lines = static_cast<Sci_Position>(seconds / durationStyleOneLine);
+	if (lines < 10)
+		return 10;
+	else if (lines > 0x10000)
+		return 0x10000;
+	return lines;
+}
+
 void Document::LexerChanged() {
 	// Tell the watchers the lexer has changed.
 	for (int i = 0; i < lenWatchers; i++) {
@@ -1424,7 +2034,7 @@ void Document::LexerChanged() {
 	}
 }
 
-int SCI_METHOD Document::SetLineState(int line, int state) {
+int SCI_METHOD Document::SetLineState(Sci_Position line, int state) {
 	int statePrevious = static_cast<LineState *>(perLineData[ldState])->SetLineState(line, state);
 	if (state != statePrevious) {
 		DocModification mh(SC_MOD_CHANGELINESTATE, 0, 0, 0, 0, line);
@@ -1433,7 +2043,7 @@ int SCI_METHOD Document::SetLineState(int line, int state) {
 	return statePrevious;
 }
 
-int SCI_METHOD Document::GetLineState(int line) const {
+int SCI_METHOD Document::GetLineState(Sci_Position line) const {
 	return static_cast<LineState *>(perLineData[ldState])->GetLineState(line);
 }
 
@@ -1441,7 +2051,7 @@ int Document::GetMaxLineState() {
 	return static_cast<LineState *>(perLineData[ldState])->GetMaxLineState();
 }
 
-void SCI_METHOD Document::ChangeLexerState(int start, int end) {
+void SCI_METHOD Document::ChangeLexerState(Position start, Position end) {
 	DocModification mh(SC_MOD_LEXERSTATE, start, end-start, 0, 0, 0);
 	NotifyModified(mh);
 }
@@ -1471,7 +2081,7 @@ int Document::MarginLength(int line) const {
 }
 
 void Document::MarginClearAll() {
-	int maxEditorLine = LinesTotal();
+	Sci_Position maxEditorLine = LinesTotal();
 	for (int l=0; l<maxEditorLine; l++)
 		MarginSetText(l, 0);
 	// Free remaining data
@@ -1514,7 +2124,7 @@ int Document::AnnotationLines(int line) const {
 }
 
 void Document::AnnotationClearAll() {
-	int maxEditorLine = LinesTotal();
+	Sci_Position maxEditorLine = LinesTotal();
 	for (int l=0; l<maxEditorLine; l++)
 		AnnotationSetText(l, 0);
 	// Free remaining data
@@ -1525,7 +2135,7 @@ void Document::IncrementStyleClock() {
 	styleClock = (styleClock + 1) % 0x100000;
 }
 
-void SCI_METHOD Document::DecorationFillRange(int position, int value, int fillLength) {
+void SCI_METHOD Document::DecorationFillRange(Position position, int value, Position fillLength) {
 	if (decorations.FillRange(position, value, fillLength)) {
 		DocModification mh(SC_MOD_CHANGEINDICATOR | SC_PERFORMED_USER,
 							position, fillLength);
@@ -1600,7 +2210,7 @@ bool Document::IsWordPartSeparator(char ch) {
 	return (WordCharClass(ch) == CharClassify::ccWord) && IsPunctuation(ch);
 }
 
-int Document::WordPartLeft(int pos) {
+Position Document::WordPartLeft(Position pos) {
 	if (pos > 0) {
 		--pos;
 		char startChar = cb.CharAt(pos);
@@ -1650,9 +2260,9 @@ int Document::WordPartLeft(int pos) {
 	return pos;
 }
 
-int Document::WordPartRight(int pos) {
+Position Document::WordPartRight(Position pos) {
 	char startChar = cb.CharAt(pos);
-	int length = Length();
+	Position length = Length();
 	if (IsWordPartSeparator(startChar)) {
 		while (pos < length && IsWordPartSeparator(cb.CharAt(pos)))
 			++pos;
@@ -1694,7 +2304,7 @@ bool IsLineEndChar(char c) {
 	return (c == '\n' || c == '\r');
 }
 
-int Document::ExtendStyleRange(int pos, int delta, bool singleLine) {
+Position Document::ExtendStyleRange(Position pos, int delta, bool singleLine) {
 	int sStart = cb.StyleAt(pos);
 	if (delta < 0) {
 		while (pos > 0 && (cb.StyleAt(pos) == sStart) && (!singleLine || !IsLineEndChar(cb.CharAt(pos))))
@@ -1731,7 +2341,7 @@ static char BraceOpposite(char ch) {
 }
 
 // TODO: should be able to extend styled region to find matching brace
-int Document::BraceMatch(int position, int /*maxReStyle*/) {
+Position Document::BraceMatch(Position position, Position /*maxReStyle*/) {
 	char chBrace = CharAt(position);
 	char chSeek = BraceOpposite(chBrace);
 	if (chSeek == '\0')
@@ -1770,12 +2380,20 @@ public:
 		delete substituted;
 	}
 
-	virtual long FindText(Document *doc, int minPos, int maxPos, const char *s,
+	virtual long FindText(Document *doc, Position minPos, Position maxPos, const char *s,
                         bool caseSensitive, bool word, bool wordStart, int flags,
                         int *length);
 
 	virtual const char *SubstituteByPosition(Document *doc, const char *text, int *length);
 
+	virtual int CacheHits() const {
+		return search.CacheHits();
+	}
+
+	virtual int CacheMisses() const {
+		return search.CacheMisses();
+	}
+
 private:
 	RESearch search;
 	char *substituted;
@@ -1784,34 +2402,46 @@ private:
 // Define a way for the Regular Expression code to access the document
 class DocumentIndexer : public CharacterIndexer {
 	Document *pdoc;
-	int end;
+	Position end;
 public:
-	DocumentIndexer(Document *pdoc_, int end_) :
+	DocumentIndexer(Document *pdoc_, Position end_) :
 		pdoc(pdoc_), end(end_) {
 	}
 
 	virtual ~DocumentIndexer() {
 	}
 
-	virtual char CharAt(int index) {
+	virtual char CharAt(Sci_Position index) {
 		if (index < 0 || index >= end)
 			return 0;
 		else
 			return pdoc->CharAt(index);
 	}
+
+	virtual const char *SegmentPointer(Sci_Position index, Sci_Position &lengthSegment) {
+		if (index < 0 || index >= end) {
+			lengthSegment = 0;
+			return 0;
+		}
+		const char *segment = pdoc->SegmentPointer(index, lengthSegment);
+		if (lengthSegment > end - index)
+			lengthSegment = end - index;
+		return segment;
+	}
 };
 
-long BuiltinRegex::FindText(Document *doc, int minPos, int maxPos, const char *s,
+long BuiltinRegex::FindText(Document *doc, Position minPos, Position maxPos, const char *s,
                         bool caseSensitive, bool, bool, int flags,
                         int *length) {
 	bool posix = (flags & SCFIND_POSIX) != 0;
 	int increment = (minPos <= maxPos) ? 1 : -1;
 
-	int startPos = minPos;
-	int endPos = maxPos;
+	Position startPos = minPos;
+	Position endPos = maxPos;
 
 	// Range endpoints should not be inside DBCS characters, but just in case, move them.
-	startPos = doc->MovePositionOutsideChar(startPos, 1, false);
+	// Searching backwards, the start moves back so matches do not end after it.
+	startPos = doc->MovePositionOutsideChar(startPos, increment, false);
 	endPos = doc->MovePositionOutsideChar(endPos, 1, false);
 
 	const char *errmsg = search.Compile(s, *length, caseSensitive, posix);
@@ -1822,8 +2452,8 @@ long BuiltinRegex::FindText(Document *doc, int minPos, int maxPos, const char *s
 	// Replace first '.' with '-' in each property file variable reference:
 	//     Search: \$(\([A-Za-z0-9_-]+\)\.\([A-Za-z0-9_.]+\))
 	//     Replace: $(\1-\2)
-	int lineRangeStart = doc->LineFromPosition(startPos);
-	int lineRangeEnd = doc->LineFromPosition(endPos);
+	Sci_Position lineRangeStart = doc->LineFromPosition(startPos);
+	Sci_Position lineRangeEnd = doc->LineFromPosition(endPos);
 	if ((increment == 1) &&
 		(startPos >= doc->LineEnd(lineRangeStart)) &&
 		(lineRangeStart < lineRangeEnd)) {
@@ -1831,13 +2461,13 @@ long BuiltinRegex::FindText(Document *doc, int minPos, int maxPos, const char *s
 		lineRangeStart++;
 		startPos = doc->LineStart(lineRangeStart);
 	}
-	int pos = -1;
-	int lenRet = 0;
+	Position pos = -1;
+	Position lenRet = 0;
 	char searchEnd = s[*length - 1];
-	int lineRangeBreak = lineRangeEnd + increment;
-	for (int line = lineRangeStart; line != lineRangeBreak; line += increment) {
-		int startOfLine = doc->LineStart(line);
-		int endOfLine = doc->LineEnd(line);
+	Sci_Position lineRangeBreak = lineRangeEnd + increment;
+	for (Sci_Position line = lineRangeStart; line != lineRangeBreak; line += increment) {
+		Position startOfLine = doc->LineStart(line);
+		Position endOfLine = doc->LineEnd(line);
 		if (increment == 1) {
 			if (line == lineRangeStart) {
 				if ((startPos != startOfLine) && (s[0] == '^'))
@@ -1863,29 +2493,16 @@ long BuiltinRegex::FindText(Document *doc, int minPos, int maxPos, const char *s
 		}
 
 		DocumentIndexer di(doc, endOfLine);
-		int success = search.Execute(di, startOfLine, endOfLine);
+		// Searching backwards finds the last match on the line in one pass
+		const int success = (increment == 1) ?
+			search.Execute(di, startOfLine, endOfLine) : search.ExecuteLast(di, startOfLine, endOfLine);
 		if (success) {
 			pos = search.bopat[0];
 			lenRet = search.eopat[0] - search.bopat[0];
-			if (increment == -1) {
-				// Check for the last match on this line.
-				int repetitions = 1000;	// Break out of infinite loop
-				while (success && (search.eopat[0] <= endOfLine) && (repetitions--)) {
-					success = search.Execute(di, pos+1, endOfLine);
-					if (success) {
-						if (search.eopat[0] <= minPos) {
-							pos = search.bopat[0];
-							lenRet = search.eopat[0] - search.bopat[0];
-						} else {
-							success = 0;
-						}
-					}
-				}
-			}
 			break;
 		}
 	}
-	*length = lenRet;
+	*length = static_cast<int>(lenRet);
 	return pos;
 }
 
@@ -1900,7 +2517,7 @@ const char *BuiltinRegex::SubstituteByPosition(Document *doc, const char *text,
 		if (text[i] == '\\') {
 			if (text[i + 1] >= '1' && text[i + 1] <= '9') {
 				unsigned int patNum = text[i + 1] - '0';
-				lenResult += search.eopat[patNum] - search.bopat[patNum];
+				lenResult += static_cast<unsigned int>(search.eopat[patNum] - search.bopat[patNum]);
 				i++;
 			} else {
 				switch (text[i + 1]) {
@@ -1926,7 +2543,7 @@ const char *BuiltinRegex::SubstituteByPosition(Document *doc, const char *text,
 		if (text[j] == '\\') {
 			if (text[j + 1] >= '1' && text[j + 1] <= '9') {
 				unsigned int patNum = text[j + 1] - '0';
-				unsigned int len = search.eopat[patNum] - search.bopat[patNum];
+				unsigned int len = static_cast<unsigned int>(search.eopat[patNum] - search.bopat[patNum]);
 				if (search.pat[patNum])	// Will be null if try for a match that did not occur
 					memcpy(o, search.pat[patNum], len);
 				o += len;
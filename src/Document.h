@@ -16,7 +16,7 @@ namespace Scintilla {
  * A Position is a position within a document between two characters or at the beginning or end.
  * Sometimes used as a character index where it identifies the character after the position.
  */
-typedef int Position;
+typedef Sci_Position Position;
 const Position invalidPosition = -1;
 
 /**
@@ -74,6 +74,7 @@ public:
 
 class DocWatcher;
 class DocModification;
+class ByteSearch;
 class Document;
 
 /**
@@ -83,11 +84,15 @@ class RegexSearchBase {
 public:
 	virtual ~RegexSearchBase() {}
 
-	virtual long FindText(Document *doc, int minPos, int maxPos, const char *s,
+	virtual long FindText(Document *doc, Position minPos, Position maxPos, const char *s,
                         bool caseSensitive, bool word, bool wordStart, int flags, int *length) = 0;
 
 	///@return String with the substitutions, must remain valid until the next call or destruction
 	virtual const char *SubstituteByPosition(Document *doc, const char *text, int *length) = 0;
+
+	/// Number of searches which reused a cached compiled pattern and which compiled it.
+	virtual int CacheHits() const { return 0; }
+	virtual int CacheMisses() const { return 0; }
 };
 
 /// Factory function for RegexSearchBase
@@ -135,22 +140,58 @@ public:
 
 class Document;
 
+/**
+ * Presents a Document through the original IDocument interface with int positions
+ * so that lexers which do not implement ILexerLargeFile can still be used.
+ */
+class DocumentAccessOriginal : public IDocumentRangePointer {
+	Document *pdoc;
+public:
+	DocumentAccessOriginal(Document *pdoc_) : pdoc(pdoc_) {
+	}
+	virtual ~DocumentAccessOriginal() {
+	}
+	int SCI_METHOD Version() const;
+	void SCI_METHOD SetErrorStatus(int status);
+	int SCI_METHOD Length() const;
+	void SCI_METHOD GetCharRange(char *buffer, int position, int lengthRetrieve) const;
+	char SCI_METHOD StyleAt(int position) const;
+	int SCI_METHOD LineFromPosition(int position) const;
+	int SCI_METHOD LineStart(int line) const;
+	int SCI_METHOD GetLevel(int line) const;
+	int SCI_METHOD SetLevel(int line, int level);
+	int SCI_METHOD GetLineState(int line) const;
+	int SCI_METHOD SetLineState(int line, int state);
+	void SCI_METHOD StartStyling(int position, char mask);
+	bool SCI_METHOD SetStyleFor(int length, char style);
+	bool SCI_METHOD SetStyles(int length, const char *styles);
+	void SCI_METHOD DecorationSetCurrentIndicator(int indicator);
+	void SCI_METHOD DecorationFillRange(int position, int value, int fillLength);
+	void SCI_METHOD ChangeLexerState(int start, int end);
+	int SCI_METHOD CodePage() const;
+	bool SCI_METHOD IsDBCSLeadByte(char ch) const;
+	const char * SCI_METHOD BufferPointer();
+	const char * SCI_METHOD RangePointer(int position, int rangeLength);
+	int SCI_METHOD GapPosition() const;
+};
+
 class LexInterface {
 protected:
 	Document *pdoc;
 	ILexer *instance;
 	bool performingStyle;	///< Prevent reentrance
+	DocumentAccessOriginal accessOriginal;
 public:
-	LexInterface(Document *pdoc_) : pdoc(pdoc_), instance(0), performingStyle(false) {
+	LexInterface(Document *pdoc_) : pdoc(pdoc_), instance(0), performingStyle(false), accessOriginal(pdoc_) {
 	}
 	virtual ~LexInterface() {
 	}
-	void Colourise(int start, int end);
+	void Colourise(Position start, Position end);
 };
 
 /**
  */
-class Document : PerLine, public IDocument {
+class Document : PerLine, public IDocumentLargeFileRangePointer, public ILoader {
 
 public:
 	/** Used to pair watcher pointer with user data. */
@@ -170,8 +211,9 @@ private:
 	CellBuffer cb;
 	CharClassify charClass;
 	char stylingMask;
-	int endStyled;
+	Position endStyled;
 	int styleClock;
+	double durationStyleOneLine;	///< Seconds to style a line, averaged over recent styling
 	int enteredModification;
 	int enteredStyling;
 	int enteredReadOnlyCount;
@@ -186,6 +228,11 @@ private:
 	bool matchesValid;
 	RegexSearchBase *regex;
 
+	/// While SC_MOD_CHANGELINEENDS is notified, the starts before the change of the changed
+	/// lines from lineEndsFirst and of the line after them.
+	std::vector<Position> lineEndsStartsBefore;
+	Sci_Position lineEndsFirst;
+
 public:
 
 	LexInterface *pli;
@@ -208,38 +255,44 @@ public:
 	Document();
 	virtual ~Document();
 
-	int AddRef();
-	int Release();
+	int SCI_METHOD AddRef();
+	int SCI_METHOD Release();
+	int SCI_METHOD AddData(const char *data, Sci_Position length);
+	void * SCI_METHOD ConvertToDocument();
 
 	virtual void Init();
-	virtual void InsertLine(int line);
-	virtual void RemoveLine(int line);
+	virtual void InsertLine(Sci_Position line);
+	virtual void InsertLines(Sci_Position line, Sci_Position lines);
+	virtual void RemoveLine(Sci_Position line);
 
 	int SCI_METHOD Version() const {
-		return dvOriginal;
+		return dvRangePointer;
 	}
 
 	void SCI_METHOD SetErrorStatus(int status);
 
-	int SCI_METHOD LineFromPosition(int pos) const;
-	int ClampPositionIntoDocument(int pos);
-	bool IsCrLf(int pos);
-	int LenChar(int pos);
-	bool InGoodUTF8(int pos, int &start, int &end);
-	int MovePositionOutsideChar(int pos, int moveDir, bool checkLineEnd=true);
+	Sci_Position SCI_METHOD LineFromPosition(Position pos) const;
+	Position ClampPositionIntoDocument(Position pos);
+	bool IsCrLf(Position pos);
+	int LenChar(Position pos);
+	bool InGoodUTF8(Position pos, Position &start, Position &end);
+	Position MovePositionOutsideChar(Position pos, int moveDir, bool checkLineEnd=true);
 	int SCI_METHOD CodePage() const;
 	bool SCI_METHOD IsDBCSLeadByte(char ch) const;
 
 	// Gateways to modifying document
-	void ModifiedAt(int pos);
+	void ModifiedAt(Position pos);
 	void CheckReadOnly();
-	bool DeleteChars(int pos, int len);
-	bool InsertString(int position, const char *s, int insertLength);
-	int Undo();
-	int Redo();
+	bool DeleteChars(Position pos, Position len);
+	bool InsertString(Position position, const char *s, Position insertLength);
+	bool AttachReadOnlyText(const char *s, Position length);
+	Position Undo();
+	Position Redo();
 	bool CanUndo() { return cb.CanUndo(); }
 	bool CanRedo() { return cb.CanRedo(); }
 	void DeleteUndoHistory() { cb.DeleteUndoHistory(); }
+	void SetUndoMemoryLimit(Position limit) { cb.SetUndoMemoryLimit(limit); }
+	Position GetUndoMemoryLimit() const { return cb.GetUndoMemoryLimit(); }
 	bool SetUndoCollection(bool collectUndo) {
 		return cb.SetUndoCollection(collectUndo);
 	}
@@ -249,84 +302,100 @@ public:
 	void AddUndoAction(int token, bool mayCoalesce) { cb.AddUndoAction(token, mayCoalesce); }
 	void SetSavePoint();
 	bool IsSavePoint() { return cb.IsSavePoint(); }
-	const char *BufferPointer() { return cb.BufferPointer(); }
-
-	int GetLineIndentation(int line);
-	void SetLineIndentation(int line, int indent);
-	int GetLineIndentPosition(int line) const;
-	int GetColumn(int position);
-	int FindColumn(int line, int column);
-	void Indent(bool forwards, int lineBottom, int lineTop);
+	const char * SCI_METHOD BufferPointer() { return cb.BufferPointer(); }
+	const char *SegmentPointer(Position position, Position &lengthSegment) const {
+		return cb.SegmentPointer(position, lengthSegment);
+	}
+	const char * SCI_METHOD RangePointer(Position position, Position rangeLength) {
+		return cb.RangePointer(position, rangeLength);
+	}
+	Position SCI_METHOD GapPosition() const { return cb.GapPosition(); }
+
+	int GetLineIndentation(Sci_Position line);
+	void SetLineIndentation(Sci_Position line, int indent);
+	Position GetLineIndentPosition(Sci_Position line) const;
+	int GetColumn(Position position);
+	Position FindColumn(Sci_Position line, int column);
+	void Indent(bool forwards, Sci_Position lineBottom, Sci_Position lineTop);
 	static char *TransformLineEnds(int *pLenOut, const char *s, size_t len, int eolMode);
 	void ConvertLineEnds(int eolModeSet);
+	Position MovePositionForLineEnds(Position pos) const;
 	void SetReadOnly(bool set) { cb.SetReadOnly(set); }
 	bool IsReadOnly() { return cb.IsReadOnly(); }
 
-	bool InsertChar(int pos, char ch);
-	bool InsertCString(int position, const char *s);
-	void ChangeChar(int pos, char ch);
-	void DelChar(int pos);
-	void DelCharBack(int pos);
+	bool InsertChar(Position pos, char ch);
+	bool InsertCString(Position position, const char *s);
+	void ChangeChar(Position pos, char ch);
+	void DelChar(Position pos);
+	void DelCharBack(Position pos);
 
-	char CharAt(int position) { return cb.CharAt(position); }
-	void SCI_METHOD GetCharRange(char *buffer, int position, int lengthRetrieve) const {
+	char CharAt(Position position) { return cb.CharAt(position); }
+	void SCI_METHOD GetCharRange(char *buffer, Position position, Position lengthRetrieve) const {
 		cb.GetCharRange(buffer, position, lengthRetrieve);
 	}
-	char SCI_METHOD StyleAt(int position) const { return cb.StyleAt(position); }
-	int GetMark(int line);
-	int AddMark(int line, int markerNum);
-	void AddMarkSet(int line, int valueSet);
-	void DeleteMark(int line, int markerNum);
+	char SCI_METHOD StyleAt(Position position) const { return cb.StyleAt(position); }
+	int GetMark(Sci_Position line);
+	int AddMark(Sci_Position line, int markerNum);
+	void AddMarkSet(Sci_Position line, int valueSet);
+	void DeleteMark(Sci_Position line, int markerNum);
 	void DeleteMarkFromHandle(int markerHandle);
 	void DeleteAllMarks(int markerNum);
-	int LineFromHandle(int markerHandle);
-	int SCI_METHOD LineStart(int line) const;
-	int LineEnd(int line) const;
-	int LineEndPosition(int position) const;
-	bool IsLineEndPosition(int position) const;
-	int VCHomePosition(int position) const;
-
-	int SCI_METHOD SetLevel(int line, int level);
-	int SCI_METHOD GetLevel(int line) const;
+	Sci_Position LineFromHandle(int markerHandle);
+	Sci_Position MarkerNext(Sci_Position lineStart, int mask) const;
+	Sci_Position MarkerPrevious(Sci_Position lineStart, int mask) const;
+	Position SCI_METHOD LineStart(Sci_Position line) const;
+	Position LineEnd(Sci_Position line) const;
+	Position LineEndPosition(Position position) const;
+	bool IsLineEndPosition(Position position) const;
+	Position VCHomePosition(Position position) const;
+
+	int SCI_METHOD SetLevel(Sci_Position line, int level);
+	int SCI_METHOD GetLevel(Sci_Position line) const;
 	void ClearLevels();
-	int GetLastChild(int lineParent, int level=-1);
-	int GetFoldParent(int line);
+	Sci_Position GetLastChild(Sci_Position lineParent, int level=-1);
+	Sci_Position GetFoldParent(Sci_Position line);
 
 	void Indent(bool forwards);
-	int ExtendWordSelect(int pos, int delta, bool onlyWordCharacters=false);
-	int NextWordStart(int pos, int delta);
-	int NextWordEnd(int pos, int delta);
-	int SCI_METHOD Length() const { return cb.Length(); }
-	void Allocate(int newSize) { cb.Allocate(newSize); }
-	size_t ExtractChar(int pos, char *bytes);
-	bool MatchesWordOptions(bool word, bool wordStart, int pos, int length);
-	long FindText(int minPos, int maxPos, const char *search, bool caseSensitive, bool word,
+	Position ExtendWordSelect(Position pos, int delta, bool onlyWordCharacters=false);
+	Position NextWordStart(Position pos, int delta);
+	Position NextWordEnd(Position pos, int delta);
+	Position SCI_METHOD Length() const { return cb.Length(); }
+	void Allocate(Position newSize) { cb.Allocate(newSize); }
+	size_t ExtractChar(Position pos, char *bytes);
+	bool MatchesWordOptions(bool word, bool wordStart, Position pos, Position length);
+	long FindText(Position minPos, Position maxPos, const char *search, bool caseSensitive, bool word,
 		bool wordStart, bool regExp, int flags, int *length, CaseFolder *pcf);
+	int FindAll(Position minPos, Position maxPos, const char *search, bool caseSensitive, bool word,
+		bool wordStart, bool regExp, int flags, int length, CaseFolder *pcf, bool fill);
 	const char *SubstituteByPosition(const char *text, int *length);
-	int LinesTotal() const;
+	int RegexCacheHits() const { return regex ? regex->CacheHits() : 0; }
+	int RegexCacheMisses() const { return regex ? regex->CacheMisses() : 0; }
+	Sci_Position LinesTotal() const;
 
 	void ChangeCase(Range r, bool makeUpperCase);
 
 	void SetDefaultCharClasses(bool includeWordClass);
 	void SetCharClasses(const unsigned char *chars, CharClassify::cc newCharClass);
 	void SetStylingBits(int bits);
-	void SCI_METHOD StartStyling(int position, char mask);
-	bool SCI_METHOD SetStyleFor(int length, char style);
-	bool SCI_METHOD SetStyles(int length, const char *styles);
-	int GetEndStyled() { return endStyled; }
-	void EnsureStyledTo(int pos);
+	void SCI_METHOD StartStyling(Position position, char mask);
+	bool SCI_METHOD SetStyleFor(Position length, char style);
+	bool SCI_METHOD SetStyles(Position length, const char *styles);
+	Position GetEndStyled() { return endStyled; }
+	void EnsureStyledTo(Position pos);
+	void StyleToAdjustingLineDuration(Position pos);
+	Sci_Position LinesToStyleIn(double seconds) const;
 	void LexerChanged();
 	int GetStyleClock() { return styleClock; }
 	void IncrementStyleClock();
 	void SCI_METHOD DecorationSetCurrentIndicator(int indicator) {
 		decorations.SetCurrentIndicator(indicator);
 	}
-	void SCI_METHOD DecorationFillRange(int position, int value, int fillLength);
+	void SCI_METHOD DecorationFillRange(Position position, int value, Position fillLength);
 
-	int SCI_METHOD SetLineState(int line, int state);
-	int SCI_METHOD GetLineState(int line) const;
+	int SCI_METHOD SetLineState(Sci_Position line, int state);
+	int SCI_METHOD GetLineState(Sci_Position line) const;
 	int GetMaxLineState();
-	void SCI_METHOD ChangeLexerState(int start, int end);
+	void SCI_METHOD ChangeLexerState(Position start, Position end);
 
 	StyledText MarginStyledText(int line);
 	void MarginSetStyle(int line, int style);
@@ -350,24 +419,31 @@ public:
 	int GetLenWatchers() const { return lenWatchers; }
 
 	bool IsWordPartSeparator(char ch);
-	int WordPartLeft(int pos);
-	int WordPartRight(int pos);
-	int ExtendStyleRange(int pos, int delta, bool singleLine = false);
-	bool IsWhiteLine(int line) const;
-	int ParaUp(int pos);
-	int ParaDown(int pos);
+	Position WordPartLeft(Position pos);
+	Position WordPartRight(Position pos);
+	Position ExtendStyleRange(Position pos, int delta, bool singleLine = false);
+	bool IsWhiteLine(Sci_Position line) const;
+	Position ParaUp(Position pos);
+	Position ParaDown(Position pos);
 	int IndentSize() { return actualIndentInChars; }
-	int BraceMatch(int position, int maxReStyle);
+	Position BraceMatch(Position position, Position maxReStyle);
 
 private:
 	CharClassify::cc WordCharClass(unsigned char ch);
-	bool IsWordStartAt(int pos);
-	bool IsWordEndAt(int pos);
-	bool IsWordAt(int start, int end);
+	bool IsWordStartAt(Position pos);
+	bool IsWordEndAt(Position pos);
+	bool IsWordAt(Position start, Position end);
 
 	void NotifyModifyAttempt();
 	void NotifySavePoint(bool atSavePoint);
 	void NotifyModified(DocModification mh);
+	Position FindBytes(ByteSearch &searcher, bool forward, Position startPos, Position endPos,
+		bool word, bool wordStart);
+	Position SkipBytesForward(const bool *skip, Position pos, Position end) const;
+	Position SkipBytesBackward(const bool *skip, Position pos, Position start) const;
+	void NotifyLineEndsChanged(int modFlags, Sci_Position line, const char *endsBefore, Sci_Position lines);
+	void MoveIndicatorsForLineEnd(Position lineEnd, int modeBefore, int mode, bool undo);
+	void PerformLineEndsStep(const Action &action, int performed, int step, int steps, bool multiLine);
 };
 
 class UndoGroup {
@@ -399,18 +475,18 @@ public:
 class DocModification {
 public:
   	int modificationType;
-	int position;
- 	int length;
- 	int linesAdded;	/**< Negative if lines deleted. */
+	Position position;
+ 	Position length;
+ 	Sci_Position linesAdded;	/**< Negative if lines deleted. */
  	const char *text;	/**< Only valid for changes to text, not for changes to style. */
- 	int line;
+ 	Sci_Position line;
 	int foldLevelNow;
 	int foldLevelPrev;
 	int annotationLinesAdded;
 	int token;
 
-	DocModification(int modificationType_, int position_=0, int length_=0,
-		int linesAdded_=0, const char *text_=0, int line_=0) :
+	DocModification(int modificationType_, Position position_=0, Position length_=0,
+		Sci_Position linesAdded_=0, const char *text_=0, Sci_Position line_=0) :
 		modificationType(modificationType_),
 		position(position_),
 		length(length_),
@@ -422,7 +498,7 @@ public:
 		annotationLinesAdded(0),
 		token(0) {}
 
-	DocModification(int modificationType_, const Action &act, int linesAdded_=0) :
+	DocModification(int modificationType_, const Action &act, Sci_Position linesAdded_=0) :
 		modificationType(modificationType_),
 		position(act.position),
 		length(act.lenData),
@@ -447,7 +523,7 @@ public:
 	virtual void NotifySavePoint(Document *doc, void *userData, bool atSavePoint) = 0;
 	virtual void NotifyModified(Document *doc, DocModification mh, void *userData) = 0;
 	virtual void NotifyDeleted(Document *doc, void *userData) = 0;
-	virtual void NotifyStyleNeeded(Document *doc, void *userData, int endPos) = 0;
+	virtual void NotifyStyleNeeded(Document *doc, void *userData, Position endPos) = 0;
 	virtual void NotifyLexerChanged(Document *doc, void *userData) = 0;
 	virtual void NotifyErrorOccurred(Document *doc, void *userData, int status) = 0;
 };
@@ -174,6 +174,8 @@ Editor::Editor() {
 	lengthForEncode = -1;
 
 	needUpdateUI = true;
+	idleStyling = SC_IDLESTYLING_NONE;
+	needIdleStyling = false;
 	braces[0] = invalidPosition;
 	braces[1] = invalidPosition;
 	bracesMatchStyle = STYLE_BRACEBAD;
@@ -196,6 +198,7 @@ Editor::Editor() {
 	wrapWidth = LineLayout::wrapWidthInfinite;
 	wrapStart = wrapLineLarge;
 	wrapEnd = wrapLineLarge;
+	durationWrapOneLine = 0.00001;
 	wrapVisualFlags = 0;
 	wrapVisualFlagsLocation = 0;
 	wrapVisualStartIndent = 0;
@@ -1304,7 +1307,7 @@ void Editor::NeedWrapping(int docLineStart, int docLineEnd) {
 	docLineStart = Platform::Clamp(docLineStart, 0, pdoc->LinesTotal());
 	if (wrapStart > docLineStart) {
 		wrapStart = docLineStart;
-		llc.Invalidate(LineLayout::llPositions);
+		llc.Invalidate(LineLayout::llPositions, docLineStart, docLineEnd - 1);
 	}
 	if (wrapEnd < docLineEnd) {
 		wrapEnd = docLineEnd;
@@ -1333,13 +1336,19 @@ bool Editor::WrapOneLine(Surface *surface, int lineToWrap) {
 // priorityWrapLineStart: If greater than or equal to zero, all lines starting from
 //           here to 1 page + 100 lines past will be wrapped (even if there are
 //           more lines under wrapping process in idle).
-// If it is neither fullwrap, nor priorityWrap, then 1 page + 100 lines will be
-// wrapped, if there are any wrapping going on in idle. (Generally this
-// condition is called only from idler).
+// If it is neither fullwrap, nor priorityWrap, then at least 1 page + 100 lines
+// will be wrapped, or as many as can be wrapped in about 50 milliseconds, if there
+// are any wrapping going on in idle. (Generally this condition is called only from idler).
 // Return true if wrapping occurred.
 bool Editor::WrapLines(bool fullWrap, int priorityWrapLineStart) {
 	// If there are any pending wraps, do them during idle if possible.
 	int linesInOneCall = LinesOnScreen() + 100;
+	if (priorityWrapLineStart < 0) {
+		// Fewer, larger idle slices reduce the per call cost of scroll bar updates
+		const int linesInTime = static_cast<int>(0.05 / durationWrapOneLine);
+		if (linesInOneCall < linesInTime)
+			linesInOneCall = linesInTime;
+	}
 	if (wrapState != eWrapNone) {
 		if (wrapStart < wrapEnd) {
 			if (!SetIdle(true)) {
@@ -1379,8 +1388,16 @@ bool Editor::WrapLines(bool fullWrap, int priorityWrapLineStart) {
 			rcTextArea.left = vs.fixedColumnWidth;
 			rcTextArea.right -= vs.rightMarginWidth;
 			wrapWidth = rcTextArea.Width();
-			// Ensure all of the document is styled.
-			pdoc->EnsureStyledTo(pdoc->Length());
+			ElapsedTime etWrap;
+			if (!fullWrap) {
+				// Style only the lines about to be wrapped. Lines whose styles change later
+				// are marked for wrapping again by NotifyModified.
+				int lineStyleEnd = ((priorityWrapLineStart >= 0) ? priorityWrapLineStart : wrapStart) +
+					linesInOneCall;
+				if (lineStyleEnd > wrapEnd)
+					lineStyleEnd = wrapEnd;
+				pdoc->EnsureStyledTo(pdoc->LineStart(lineStyleEnd));
+			}
 			RefreshStyleData();
 			AutoSurface surface(this);
 			if (surface) {
@@ -1403,14 +1420,25 @@ bool Editor::WrapLines(bool fullWrap, int priorityWrapLineStart) {
 
 				// Platform::DebugPrintf("Wraplines: full = %d, priorityStart = %d (wrapping: %d to %d)\n", fullWrap, priorityWrapLineStart, lineToWrap, lastLineToWrap);
 				// Platform::DebugPrintf("Pending wraps: %d to %d\n", wrapStart, wrapEnd);
+				const int lineToWrapFirst = lineToWrap;
 				while (lineToWrap < lastLineToWrap) {
 					if (WrapOneLine(surface, lineToWrap)) {
 						wrapOccurred = true;
 					}
 					lineToWrap++;
 				}
-				if (!priorityWrap)
+				if (!priorityWrap) {
+					const int linesWrapped = lineToWrap - lineToWrapFirst;
+					if (!fullWrap && (linesWrapped > 0)) {
+						// Weight recent slices so the estimate follows changes in the text
+						const double alpha = 0.25;
+						const double durationOne = etWrap.Duration() / linesWrapped;
+						durationWrapOneLine = alpha * durationOne + (1.0 - alpha) * durationWrapOneLine;
+						if (durationWrapOneLine < 0.000001)
+							durationWrapOneLine = 0.000001;
+					}
 					wrapStart = lineToWrap;
+				}
 				// If wrapping is done, bring it to resting position
 				if (wrapStart >= wrapEnd) {
 					wrapStart = wrapLineLarge;
@@ -1825,7 +1853,7 @@ LineLayout *Editor::RetrieveLineLayout(int lineNumber) {
 	PLATFORM_ASSERT(posLineEnd >= posLineStart);
 	int lineCaret = pdoc->LineFromPosition(sel.MainCaret());
 	return llc.Retrieve(lineNumber, lineCaret,
-	        posLineEnd - posLineStart, pdoc->GetStyleClock(),
+	        posLineEnd - posLineStart,
 	        LinesOnScreen() + 1, pdoc->LinesTotal());
 }
 
@@ -2315,10 +2343,15 @@ void Editor::DrawEOL(Surface *surface, ViewStyle &vsDraw, PRectangle rcLine, Lin
 		surface->FillRectangle(rcSegment, overrideBackground ? background : vsDraw.styles[ll->styles[ll->numCharsInLine] & styleMask].back.allocated);
 		if (!hideSelection && ((vsDraw.selAlpha == SC_ALPHA_NOALPHA) || (vsDraw.selAdditionalAlpha == SC_ALPHA_NOALPHA))) {
 			SelectionSegment virtualSpaceRange(SelectionPosition(pdoc->LineEnd(line)), SelectionPosition(pdoc->LineEnd(line), sel.VirtualSpaceFor(pdoc->LineEnd(line))));
-			for (size_t r=0; r<sel.Count(); r++) {
+			// Reading ranges through a const Selection keeps its index valid
+			const Selection &selDraw = sel;
+			std::vector<size_t> rangesOnLine;
+			selDraw.RangesOverlapping(pdoc->LineEnd(line), pdoc->LineEnd(line), rangesOnLine);
+			for (size_t i=0; i<rangesOnLine.size(); i++) {
+				const size_t r = rangesOnLine[i];
 				int alpha = (r == sel.Main()) ? vsDraw.selAlpha : vsDraw.selAdditionalAlpha;
 				if (alpha == SC_ALPHA_NOALPHA) {
-					SelectionSegment portion = sel.Range(r).Intersect(virtualSpaceRange);
+					SelectionSegment portion = selDraw.Range(r).Intersect(virtualSpaceRange);
 					if (!portion.Empty()) {
 						const int spaceWidth = static_cast<int>(vsDraw.styles[ll->EndLineStyle()].spaceWidth);
 						rcSegment.left = xStart + ll->positions[portion.start.Position() - posLineStart] - subLineStart + portion.start.VirtualSpace() * spaceWidth;
@@ -2463,23 +2496,22 @@ void Editor::DrawIndicators(Surface *surface, ViewStyle &vsDraw, int line, int x
 		}
 	}
 
-	for (Decoration *deco = pdoc->decorations.root; deco; deco = deco->next) {
-		if (under == vsDraw.indicators[deco->indicator].under) {
+	// Only visit the indicators that are on somewhere in this line
+	const int decorationsOn = pdoc->decorations.AllOnForRange(posLineStart + lineStart, posLineEnd);
+	for (int indicator = 0; indicator <= INDIC_MAX; indicator++) {
+		if ((decorationsOn & (1 << indicator)) && (under == vsDraw.indicators[indicator].under)) {
 			int startPos = posLineStart + lineStart;
-			if (!deco->rs.ValueAt(startPos)) {
-				startPos = deco->rs.EndRun(startPos);
-			}
-			while ((startPos < posLineEnd) && (deco->rs.ValueAt(startPos))) {
-				int endPos = deco->rs.EndRun(startPos);
-				if (endPos > posLineEnd)
-					endPos = posLineEnd;
-				PRectangle rcIndic(
-				    ll->positions[startPos - posLineStart] + xStart - subLineStart,
-				    rcLine.top + vsDraw.maxAscent,
-				    ll->positions[endPos - posLineStart] + xStart - subLineStart,
-				    rcLine.top + vsDraw.maxAscent + 3);
-				vsDraw.indicators[deco->indicator].Draw(surface, rcIndic, rcLine);
-				startPos = deco->rs.EndRun(endPos);
+			while (startPos < posLineEnd) {
+				int endPos = pdoc->decorations.EndInRange(indicator, startPos, posLineEnd);
+				if (pdoc->decorations.ValueAt(indicator, startPos)) {
+					PRectangle rcIndic(
+					    ll->positions[startPos - posLineStart] + xStart - subLineStart,
+					    rcLine.top + vsDraw.maxAscent,
+					    ll->positions[endPos - posLineStart] + xStart - subLineStart,
+					    rcLine.top + vsDraw.maxAscent + 3);
+					vsDraw.indicators[indicator].Draw(surface, rcIndic, rcLine);
+				}
+				startPos = endPos;
 			}
 		}
 	}
@@ -2969,10 +3001,14 @@ void Editor::DrawLine(Surface *surface, ViewStyle &vsDraw, int line, int lineVis
 		SelectionPosition posStart(posLineStart);
 		SelectionPosition posEnd(posLineStart + lineEnd, virtualSpaces);
 		SelectionSegment virtualSpaceRange(posStart, posEnd);
-		for (size_t r=0; r<sel.Count(); r++) {
+		const Selection &selDraw = sel;
+		std::vector<size_t> rangesOnLine;
+		selDraw.RangesOverlapping(posStart.Position(), posEnd.Position(), rangesOnLine);
+		for (size_t i=0; i<rangesOnLine.size(); i++) {
+			const size_t r = rangesOnLine[i];
 			int alpha = (r == sel.Main()) ? vsDraw.selAlpha : vsDraw.selAdditionalAlpha;
 			if (alpha != SC_ALPHA_NOALPHA) {
-				SelectionSegment portion = sel.Range(r).Intersect(virtualSpaceRange);
+				SelectionSegment portion = selDraw.Range(r).Intersect(virtualSpaceRange);
 				if (!portion.Empty()) {
 					const int spaceWidth = static_cast<int>(vsDraw.styles[ll->EndLineStyle()].spaceWidth);
 					rcSegment.left = xStart + ll->positions[portion.start.Position() - posLineStart] - subLineStart + portion.start.VirtualSpace() * spaceWidth;
@@ -3151,10 +3187,15 @@ void Editor::DrawCarets(Surface *surface, ViewStyle &vsDraw, int lineDoc, int xS
 	if (hideSelection && !drawDrag)
 		return;
 	const int posLineStart = pdoc->LineStart(lineDoc);
-	// For each selection draw
-	for (size_t r=0; (r<sel.Count()) || drawDrag; r++) {
+	// For each selection with an end on this line draw
+	const Selection &selDraw = sel;
+	std::vector<size_t> rangesOnLine;
+	if (!drawDrag)
+		selDraw.RangesOverlapping(posLineStart, posLineStart + ll->numCharsInLine, rangesOnLine);
+	for (size_t i=0; (i<rangesOnLine.size()) || drawDrag; i++) {
+		const size_t r = drawDrag ? 0 : rangesOnLine[i];
 		const bool mainCaret = r == sel.Main();
-		const SelectionPosition posCaret = (drawDrag ? posDrag : sel.Range(r).caret);
+		const SelectionPosition posCaret = (drawDrag ? posDrag : selDraw.Range(r).caret);
 		const int offset = posCaret.Position() - posLineStart;
 		const int spaceWidth = static_cast<int>(vsDraw.styles[ll->EndLineStyle()].spaceWidth);
 		const int virtualOffset = posCaret.VirtualSpace() * spaceWidth;
@@ -3227,6 +3268,73 @@ void Editor::DrawCarets(Surface *surface, ViewStyle &vsDraw, int lineDoc, int xS
 	}
 }
 
+/**
+ * The start of the document line after the display line after the area.
+ * The extra line is to determine when a style change, such as starting a comment,
+ * flows on to other lines.
+ */
+int Editor::PositionAfterArea(PRectangle rcArea) {
+	const int lineAfter = topLine + (rcArea.bottom - 1) / vs.lineHeight + 1;
+	if (lineAfter < cs.LinesDisplayed())
+		return pdoc->LineStart(cs.DocFromDisplay(lineAfter) + 1);
+	else
+		return pdoc->Length();
+}
+
+/// Limit styling to what can be done in a short time so that the user interface stays responsive.
+int Editor::PositionAfterMaxStyling(int posMax) const {
+	if ((idleStyling == SC_IDLESTYLING_NONE) || (idleStyling == SC_IDLESTYLING_AFTERVISIBLE)) {
+		// Both modes style all of the visible text immediately
+		return posMax;
+	}
+	const double secondsAllowed = 0.02;
+	const int stylingMaxLine = pdoc->LineFromPosition(pdoc->GetEndStyled()) +
+		pdoc->LinesToStyleIn(secondsAllowed);
+	const int posStylingMax = pdoc->LineStart(stylingMaxLine);
+	return (posStylingMax < posMax) ? posStylingMax : posMax;
+}
+
+void Editor::StartIdleStyling(bool truncatedLastStyling) {
+	if ((idleStyling == SC_IDLESTYLING_ALL) || (idleStyling == SC_IDLESTYLING_AFTERVISIBLE)) {
+		if (pdoc->GetEndStyled() < pdoc->Length()) {
+			// Style the rest of the document in idle time
+			needIdleStyling = true;
+		}
+	} else if (truncatedLastStyling) {
+		needIdleStyling = true;
+	}
+	if (needIdleStyling && !SetIdle(true)) {
+		// Idle processing not supported so style everything wanted now.
+		needIdleStyling = false;
+		pdoc->EnsureStyledTo((idleStyling >= SC_IDLESTYLING_AFTERVISIBLE) ?
+			pdoc->Length() : PositionAfterArea(GetClientRectangle()));
+	}
+}
+
+/// Style an area, but only as much as can be done quickly, leaving the rest for idle time.
+void Editor::StyleAreaBounded(PRectangle rcArea) {
+	const int posAfterArea = PositionAfterArea(rcArea);
+	const int posAfterMax = PositionAfterMaxStyling(posAfterArea);
+	if (posAfterMax < posAfterArea) {
+		pdoc->StyleToAdjustingLineDuration(posAfterMax);
+	} else {
+		pdoc->EnsureStyledTo(posAfterArea);
+	}
+	StartIdleStyling(posAfterMax < posAfterArea);
+}
+
+/// Style a slice of the text still wanted in idle time, redrawing it through style change notifications.
+void Editor::IdleStyling() {
+	const int posAfterArea = PositionAfterArea(GetClientRectangle());
+	const int endGoal = (idleStyling >= SC_IDLESTYLING_AFTERVISIBLE) ?
+		pdoc->Length() : posAfterArea;
+	const int posAfterMax = PositionAfterMaxStyling(endGoal);
+	pdoc->StyleToAdjustingLineDuration(posAfterMax);
+	if (pdoc->GetEndStyled() >= endGoal) {
+		needIdleStyling = false;
+	}
+}
+
 void Editor::Paint(Surface *surfaceWindow, PRectangle rcArea) {
 	//Platform::DebugPrintf("Paint:%1d (%3d,%3d) ... (%3d,%3d)\n",
 	//	paintingAllText, rcArea.left, rcArea.top, rcArea.right, rcArea.bottom);
@@ -3243,13 +3351,6 @@ void Editor::Paint(Surface *surfaceWindow, PRectangle rcArea) {
 	pixmapLine->SetPalette(&palette, !hasFocus);
 
 	int screenLinePaintFirst = rcArea.top / vs.lineHeight;
-	// The area to be painted plus one extra line is styled.
-	// The extra line is to determine when a style change, such as starting a comment flows on to other lines.
-	int lineStyleLast = topLine + (rcArea.bottom - 1) / vs.lineHeight + 1;
-	//Platform::DebugPrintf("Paint lines = %d .. %d\n", topLine + screenLinePaintFirst, lineStyleLast);
-	int endPosPaint = pdoc->Length();
-	if (lineStyleLast < cs.LinesDisplayed())
-		endPosPaint = pdoc->LineStart(cs.DocFromDisplay(lineStyleLast) + 1);
 
 	int xStart = vs.fixedColumnWidth - xOffset;
 	int ypos = 0;
@@ -3257,8 +3358,8 @@ void Editor::Paint(Surface *surfaceWindow, PRectangle rcArea) {
 		ypos += screenLinePaintFirst * vs.lineHeight;
 	int yposScreen = screenLinePaintFirst * vs.lineHeight;
 
-	// Ensure we are styled as far as we are painting.
-	pdoc->EnsureStyledTo(endPosPaint);
+	// Ensure we are styled as far as we are painting or as far as time allows.
+	StyleAreaBounded(rcArea);
 	bool paintAbandonedByStyling = paintState == paintAbandoned;
 	if (needUpdateUI) {
 		// Deselect palette by selecting a temporary palette
@@ -3906,15 +4007,12 @@ void Editor::ClearAll() {
 }
 
 void Editor::ClearDocumentStyle() {
-	Decoration *deco = pdoc->decorations.root;
-	while (deco) {
-		// Save next in case deco deleted
-		Decoration *decoNext = deco->next;
-		if (deco->indicator < INDIC_CONTAINER) {
-			pdoc->decorations.SetCurrentIndicator(deco->indicator);
+	const int decorationsOn = pdoc->decorations.AllOn();
+	for (int indicator = 0; indicator < INDIC_CONTAINER; indicator++) {
+		if (decorationsOn & (1 << indicator)) {
+			pdoc->decorations.SetCurrentIndicator(indicator);
 			pdoc->DecorationFillRange(0, 0, pdoc->Length());
 		}
-		deco = decoNext;
 	}
 	pdoc->StartStyling(0, '\377');
 	pdoc->SetStyleFor(pdoc->Length(), 0);
@@ -4095,7 +4193,7 @@ void Editor::NotifyStyleToNeeded(int endStyleNeeded) {
 	NotifyParent(scn);
 }
 
-void Editor::NotifyStyleNeeded(Document *, void *, int endStyleNeeded) {
+void Editor::NotifyStyleNeeded(Document *, void *, Position endStyleNeeded) {
 	NotifyStyleToNeeded(endStyleNeeded);
 }
 
@@ -4238,16 +4336,28 @@ void Editor::NotifySavePoint(Document *, void *, bool atSavePoint) {
 }
 
 void Editor::CheckModificationForWrap(DocModification mh) {
+	if (mh.modificationType & SC_MOD_CHANGELINEENDS) {
+		// Only the changed lines hold different text
+		const int lineFirst = pdoc->LineFromPosition(mh.position);
+		const int lineLast = pdoc->LineFromPosition(mh.position + mh.length);
+		llc.Invalidate(LineLayout::llCheckTextAndStyle, lineFirst, lineLast);
+		if (wrapState != eWrapNone) {
+			NeedWrapping(lineFirst, lineLast + 1);
+		}
+	}
 	if (mh.modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)) {
-		llc.Invalidate(LineLayout::llCheckTextAndStyle);
+		int lineDoc = pdoc->LineFromPosition(mh.position);
+		int lines = Platform::Maximum(0, mh.linesAdded);
+		if (mh.linesAdded == 0) {
+			llc.Invalidate(LineLayout::llCheckTextAndStyle, lineDoc, lineDoc);
+		} else {
+			// Following lines have moved so their cached layouts may be for other text
+			llc.Invalidate(LineLayout::llCheckTextAndStyle, lineDoc, pdoc->LinesTotal());
+		}
 		if (wrapState != eWrapNone) {
-			int lineDoc = pdoc->LineFromPosition(mh.position);
-			int lines = Platform::Maximum(0, mh.linesAdded);
 			NeedWrapping(lineDoc, lineDoc + lines + 1);
 		}
 		// Fix up annotation heights
-		int lineDoc = pdoc->LineFromPosition(mh.position);
-		int lines = Platform::Maximum(0, mh.linesAdded);
 		SetAnnotationHeights(lineDoc, lineDoc + lines + 2);
 	}
 }
@@ -4310,7 +4420,14 @@ void Editor::NotifyModified(Document *, DocModification mh, void *) {
 			}
 		}
 		if (mh.modificationType & SC_MOD_CHANGESTYLE) {
-			llc.Invalidate(LineLayout::llCheckTextAndStyle);
+			// Only layouts of the restyled lines need to be checked against the document
+			const int lineFirst = pdoc->LineFromPosition(mh.position);
+			const int lineLast = pdoc->LineFromPosition(mh.position + mh.length);
+			llc.Invalidate(LineLayout::llCheckTextAndStyle, lineFirst, lineLast);
+			if (wrapState != eWrapNone) {
+				// Styles affect text widths so restyled lines may wrap differently
+				NeedWrapping(lineFirst, lineLast + 1);
+			}
 		}
 	} else {
 		// Move selection and brace highlights
@@ -4322,6 +4439,17 @@ void Editor::NotifyModified(Document *, DocModification mh, void *) {
 			sel.MovePositions(false, mh.position, mh.length);
 			braces[0] = MovePositionForDeletion(braces[0], mh.position, mh.length);
 			braces[1] = MovePositionForDeletion(braces[1], mh.position, mh.length);
+		} else if (mh.modificationType & SC_MOD_CHANGELINEENDS) {
+			// Keep each caret, anchor and brace at its place in its line
+			for (size_t r=0; r<sel.Count(); r++) {
+				SelectionRange &range = sel.Range(r);
+				range.caret = SelectionPosition(pdoc->MovePositionForLineEnds(range.caret.Position()),
+					range.caret.VirtualSpace());
+				range.anchor = SelectionPosition(pdoc->MovePositionForLineEnds(range.anchor.Position()),
+					range.anchor.VirtualSpace());
+			}
+			braces[0] = pdoc->MovePositionForLineEnds(braces[0]);
+			braces[1] = pdoc->MovePositionForLineEnds(braces[1]);
 		}
 		if (cs.LinesDisplayed() < cs.LinesInDoc()) {
 			// Some lines are hidden so may need shown.
@@ -5510,6 +5638,19 @@ long Editor::SearchInTarget(const char *text, int length) {
 	return pos;
 }
 
+int Editor::SearchAllInTarget(const char *text, int length, bool fill) {
+	std::auto_ptr<CaseFolder> pcf(CaseFolderForEncoding());
+	return pdoc->FindAll(targetStart, targetEnd, text,
+	        (searchFlags & SCFIND_MATCHCASE) != 0,
+	        (searchFlags & SCFIND_WHOLEWORD) != 0,
+	        (searchFlags & SCFIND_WORDSTART) != 0,
+	        (searchFlags & SCFIND_REGEXP) != 0,
+	        searchFlags,
+	        length,
+	        pcf.get(),
+	        fill);
+}
+
 void Editor::GoToLine(int lineNo) {
 	if (lineNo > pdoc->LinesTotal())
 		lineNo = pdoc->LinesTotal();
@@ -5533,9 +5674,7 @@ char *Editor::CopyRange(int start, int end) {
 	if (start < end) {
 		int len = end - start;
 		text = new char[len + 1];
-		for (int i = 0; i < len; i++) {
-			text[i] = pdoc->CharAt(start + i);
-		}
+		pdoc->GetCharRange(text, start, len);
 		text[len] = '\0';
 	}
 	return text;
@@ -5581,11 +5720,9 @@ void Editor::CopySelectionRange(SelectionText *ss, bool allowLineCopy) {
 			std::sort(rangesInOrder.begin(), rangesInOrder.end());
 		for (size_t r=0; r<rangesInOrder.size(); r++) {
 			SelectionRange current = rangesInOrder[r];
-			for (int i = current.Start().Position();
-			        i < current.End().Position();
-			        i++) {
-				text[j++] = pdoc->CharAt(i);
-			}
+			int lengthRange = current.End().Position() - current.Start().Position();
+			pdoc->GetCharRange(text + j, current.Start().Position(), lengthRange);
+			j += lengthRange;
 			if (sel.selType == Selection::selRectangle) {
 				if (pdoc->eolMode != SC_EOL_LF) {
 					text[j++] = '\r';
@@ -6195,12 +6332,19 @@ bool Editor::Idle() {
 			wrappingDone = true;
 	}
 
+	if (needIdleStyling) {
+		IdleStyling();
+		// Restyled lines may need wrapping again
+		if ((wrapState != eWrapNone) && (wrapStart != wrapEnd))
+			wrappingDone = false;
+	}
+
 	// Add more idle things to do here, but make sure idleDone is
 	// set correctly before the function returns. returning
 	// false will stop calling this idle funtion until SetIdle() is
 	// called again.
 
-	idleDone = wrappingDone; // && thatDone && theOtherThingDone...
+	idleDone = wrappingDone && !needIdleStyling; // && thatDone && theOtherThingDone...
 
 	return !idleDone;
 }
@@ -6623,11 +6767,13 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 			if (wParam == 0)
 				return 0;
 			char *ptr = CharPtrFromSPtr(lParam);
-			unsigned int iChar = 0;
-			for (; iChar < wParam - 1; iChar++)
-				ptr[iChar] = pdoc->CharAt(iChar);
-			ptr[iChar] = '\0';
-			return iChar;
+			int lengthText = static_cast<int>(wParam - 1);
+			int lengthCopy = Platform::Minimum(lengthText, pdoc->Length());
+			pdoc->GetCharRange(ptr, 0, lengthCopy);
+			// Positions past the end of the document read as NUL
+			memset(ptr + lengthCopy, 0, lengthText - lengthCopy);
+			ptr[lengthText] = '\0';
+			return lengthText;
 		}
 
 	case SCI_SETTEXT: {
@@ -6704,11 +6850,8 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 				return lineEnd - lineStart;
 			}
 			char *ptr = CharPtrFromSPtr(lParam);
-			int iPlace = 0;
-			for (int iChar = lineStart; iChar < lineEnd; iChar++) {
-				ptr[iPlace++] = pdoc->CharAt(iChar);
-			}
-			return iPlace;
+			pdoc->GetCharRange(ptr, lineStart, lineEnd - lineStart);
+			return lineEnd - lineStart;
 		}
 
 	case SCI_GETLINECOUNT:
@@ -6742,14 +6885,12 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 				return selectedText.len ? selectedText.len : 1;
 			} else {
 				char *ptr = CharPtrFromSPtr(lParam);
-				int iChar = 0;
 				if (selectedText.len) {
-					for (; iChar < selectedText.len; iChar++)
-						ptr[iChar] = selectedText.s[iChar];
+					memcpy(ptr, selectedText.s, selectedText.len);
 				} else {
 					ptr[0] = '\0';
 				}
-				return iChar;
+				return selectedText.len;
 			}
 		}
 
@@ -6824,6 +6965,14 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 		PLATFORM_ASSERT(lParam);
 		return SearchInTarget(CharPtrFromSPtr(lParam), wParam);
 
+	case SCI_SEARCHALLINTARGET:
+		PLATFORM_ASSERT(lParam);
+		return SearchAllInTarget(CharPtrFromSPtr(lParam), wParam, true);
+
+	case SCI_COUNTINTARGET:
+		PLATFORM_ASSERT(lParam);
+		return SearchAllInTarget(CharPtrFromSPtr(lParam), wParam, false);
+
 	case SCI_SETSEARCHFLAGS:
 		searchFlags = wParam;
 		break;
@@ -6831,6 +6980,12 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 	case SCI_GETSEARCHFLAGS:
 		return searchFlags;
 
+	case SCI_GETREGEXCACHEHITS:
+		return pdoc->RegexCacheHits();
+
+	case SCI_GETREGEXCACHEMISSES:
+		return pdoc->RegexCacheMisses();
+
 	case SCI_GETTAG:
 		return GetTag(CharPtrFromSPtr(lParam), wParam);
 
@@ -6906,6 +7061,30 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 			return len; 	// Not including NUL
 		}
 
+	case SCI_STREAMTEXT: {
+			if (lParam == 0)
+				return 0;
+			Sci_TextStream *ts = reinterpret_cast<Sci_TextStream *>(lParam);
+			Position cpMin = ts->chrg.cpMin;
+			Position cpMax = ts->chrg.cpMax;
+			if (cpMax == -1)
+				cpMax = pdoc->Length();
+			if (!ts->fnStream || (cpMin < 0) || (cpMin > cpMax) || (cpMax > pdoc->Length()))
+				return 0;
+			// Hand over the text in place, at most one piece each side of the gap
+			Position pos = cpMin;
+			while (pos < cpMax) {
+				Position lengthSegment = 0;
+				const char *segment = pdoc->SegmentPointer(pos, lengthSegment);
+				if (lengthSegment > cpMax - pos)
+					lengthSegment = cpMax - pos;
+				if (ts->fnStream(ts->context, segment, static_cast<long>(lengthSegment)) != 0)
+					break;
+				pos += lengthSegment;
+			}
+			return pos - cpMin;
+		}
+
 	case SCI_HIDESELECTION:
 		hideSelection = wParam != 0;
 		Redraw();
@@ -6979,6 +7158,13 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 	case SCI_GETUNDOCOLLECTION:
 		return pdoc->IsCollectingUndo();
 
+	case SCI_SETUNDOMEMORYLIMIT:
+		pdoc->SetUndoMemoryLimit(wParam);
+		return 0;
+
+	case SCI_GETUNDOMEMORYLIMIT:
+		return pdoc->GetUndoMemoryLimit();
+
 	case SCI_BEGINUNDOACTION:
 		pdoc->BeginUndoAction();
 		return 0;
@@ -7173,10 +7359,8 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 			}
 			PLATFORM_ASSERT(wParam > 0);
 			char *ptr = CharPtrFromSPtr(lParam);
-			unsigned int iPlace = 0;
-			for (unsigned int iChar = lineStart; iChar < lineEnd && iPlace < wParam - 1; iChar++) {
-				ptr[iPlace++] = pdoc->CharAt(iChar);
-			}
+			int iPlace = Platform::Minimum(lineEnd - lineStart, static_cast<int>(wParam - 1));
+			pdoc->GetCharRange(ptr, lineStart, iPlace);
 			ptr[iPlace] = '\0';
 			return sel.MainCaret() - lineStart;
 		}
@@ -7360,6 +7544,13 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 	case SCI_GETWRAPINDENTMODE:
 		return wrapIndentMode;
 
+	case SCI_SETIDLESTYLING:
+		idleStyling = wParam;
+		break;
+
+	case SCI_GETIDLESTYLING:
+		return idleStyling;
+
 	case SCI_SETLAYOUTCACHE:
 		llc.SetLevel(wParam);
 		break;
@@ -7374,6 +7565,9 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 	case SCI_GETPOSITIONCACHE:
 		return posCache.GetSize();
 
+	case SCI_GETPOSITIONCACHESTATISTIC:
+		return posCache.Statistic(wParam);
+
 	case SCI_SETSCROLLWIDTH:
 		PLATFORM_ASSERT(wParam > 0);
 		if ((wParam > 0) && (wParam != static_cast<unsigned int >(scrollWidth))) {
@@ -7552,22 +7746,11 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 	case SCI_MARKERGET:
 		return pdoc->GetMark(wParam);
 
-	case SCI_MARKERNEXT: {
-			int lt = pdoc->LinesTotal();
-			for (int iLine = wParam; iLine < lt; iLine++) {
-				if ((pdoc->GetMark(iLine) & lParam) != 0)
-					return iLine;
-			}
-		}
-		return -1;
+	case SCI_MARKERNEXT:
+		return pdoc->MarkerNext(wParam, lParam);
 
-	case SCI_MARKERPREVIOUS: {
-			for (int iLine = wParam; iLine >= 0; iLine--) {
-				if ((pdoc->GetMark(iLine) & lParam) != 0)
-					return iLine;
-			}
-		}
-		return -1;
+	case SCI_MARKERPREVIOUS:
+		return pdoc->MarkerPrevious(wParam, lParam);
 
 	case SCI_MARKERDEFINEPIXMAP:
 		if (wParam <= MARKER_MAX) {
@@ -8124,6 +8307,14 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 			return reinterpret_cast<sptr_t>(doc);
 		}
 
+	case SCI_CREATELOADER: {
+			Document *doc = new Document();
+			doc->AddRef();
+			doc->Allocate(wParam);
+			doc->SetUndoCollection(false);
+			return reinterpret_cast<sptr_t>(static_cast<ILoader *>(doc));
+		}
+
 	case SCI_ADDREFDOCUMENT:
 		(reinterpret_cast<Document *>(lParam))->AddRef();
 		break;
@@ -8312,6 +8503,12 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 	case SCI_GETCHARACTERPOINTER:
 		return reinterpret_cast<sptr_t>(pdoc->BufferPointer());
 
+	case SCI_GETRANGEPOINTER:
+		return reinterpret_cast<sptr_t>(pdoc->RangePointer(wParam, lParam));
+
+	case SCI_GETGAPPOSITION:
+		return pdoc->GapPosition();
+
 	case SCI_SETEXTRAASCENT:
 		vs.extraAscent = wParam;
 		InvalidateStyleRedraw();
@@ -8651,6 +8848,18 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 		pdoc->ChangeLexerState(wParam, lParam);
 		break;
 
+	case SCI_ATTACHREADONLYTEXT:
+		if (pdoc->AttachReadOnlyText(CharPtrFromSPtr(lParam), wParam)) {
+			// Start again at the top of the new text as for SCI_SETTEXT
+			sel.Clear();
+			SetTopLine(0);
+			SetVerticalScrollPos();
+			xOffset = 0;
+			SetHorizontalScrollPos();
+			InvalidateStyleRedraw();
+		}
+		break;
+
 	default:
 		return DefWndProc(iMessage, wParam, lParam);
 	}
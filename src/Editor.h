@@ -188,6 +188,8 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	int lengthForEncode;
 
 	bool needUpdateUI;
+	int idleStyling;
+	bool needIdleStyling;
 	Position braces[2];
 	int bracesMatchStyle;
 	int highlightGuideColumn;
@@ -230,6 +232,7 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	int wrapWidth;
 	int wrapStart;
 	int wrapEnd;
+	double durationWrapOneLine;	///< Seconds to wrap a line, averaged over recent idle wrapping
 	int wrapVisualFlags;
 	int wrapVisualFlagsLocation;
 	int wrapVisualStartIndent;
@@ -344,6 +347,11 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	void DrawCarets(Surface *surface, ViewStyle &vsDraw, int line, int xStart,
 		PRectangle rcLine, LineLayout *ll, int subLine);
 	void RefreshPixMaps(Surface *surfaceWindow);
+	int PositionAfterArea(PRectangle rcArea);
+	int PositionAfterMaxStyling(int posMax) const;
+	void StartIdleStyling(bool truncatedLastStyling);
+	void StyleAreaBounded(PRectangle rcArea);
+	void IdleStyling();
 	void Paint(Surface *surfaceWindow, PRectangle rcArea);
 	long FormatRange(bool draw, Sci_RangeToFormat *pfr);
 	int TextWidth(int style, const char *text);
@@ -401,7 +409,7 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	void CheckModificationForWrap(DocModification mh);
 	void NotifyModified(Document *document, DocModification mh, void *userData);
 	void NotifyDeleted(Document *document, void *userData);
-	void NotifyStyleNeeded(Document *doc, void *userData, int endPos);
+	void NotifyStyleNeeded(Document *doc, void *userData, Position endPos);
 	void NotifyLexerChanged(Document *doc, void *userData);
 	void NotifyErrorOccurred(Document *doc, void *userData, int status);
 	void NotifyMacroRecord(unsigned int iMessage, uptr_t wParam, sptr_t lParam);
@@ -431,6 +439,7 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	void SearchAnchor();
 	long SearchText(unsigned int iMessage, uptr_t wParam, sptr_t lParam);
 	long SearchInTarget(const char *text, int length);
+	int SearchAllInTarget(const char *text, int length, bool fill);
 	void GoToLine(int lineNo);
 
 	virtual void CopyToClipboard(const SelectionText &selectedText) = 0;
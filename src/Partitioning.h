@@ -12,31 +12,35 @@
 /// in a range.
 /// Used by the Partitioning class.
 
-class SplitVectorWithRangeAdd : public SplitVector<int> {
+class SplitVectorWithRangeAdd : public SplitVector<Sci_Position> {
+	// Unrolled so that compilers can combine the additions into vector instructions
+	// without needing to vectorise loops, which is not done at all optimisation levels
+	static void AddDelta(Sci_Position *data, const Sci_Position *end, Sci_Position delta) {
+		for (; data + 4 <= end; data += 4) {
+			data[0] += delta;
+			data[1] += delta;
+			data[2] += delta;
+			data[3] += delta;
+		}
+		for (; data < end; data++) {
+			*data += delta;
+		}
+	}
 public:
-	SplitVectorWithRangeAdd(int growSize_) {
+	SplitVectorWithRangeAdd(Sci_Position growSize_) {
 		SetGrowSize(growSize_);
 		ReAllocate(growSize_);
 	}
 	~SplitVectorWithRangeAdd() {
 	}
-	void RangeAddDelta(int start, int end, int delta) {
+	void RangeAddDelta(Sci_Position start, Sci_Position end, Sci_Position delta) {
 		// end is 1 past end, so end-start is number of elements to change
-		int i = 0;
-		int rangeLength = end - start;
-		int range1Length = rangeLength;
-		int part1Left = part1Length - start;
-		if (range1Length > part1Left)
-			range1Length = part1Left;
-		while (i < range1Length) {
-			body[start++] += delta;
-			i++;
-		}
-		start += gapLength;
-		while (i < rangeLength) {
-			body[start++] += delta;
-			i++;
-		}
+		const Sci_Position range1End = (end < part1Length) ? end : part1Length;
+		if (start < range1End)
+			AddDelta(body + start, body + range1End, delta);
+		const Sci_Position range2Start = (start > part1Length) ? start : part1Length;
+		if (range2Start < end)
+			AddDelta(body + gapLength + range2Start, body + gapLength + end, delta);
 	}
 };
 
@@ -47,12 +51,12 @@ class Partitioning {
 private:
 	// To avoid calculating all the partition positions whenever any text is inserted
 	// there may be a step somewhere in the list.
-	int stepPartition;
-	int stepLength;
+	Sci_Position stepPartition;
+	Sci_Position stepLength;
 	SplitVectorWithRangeAdd *body;
 
 	// Move step forward
-	void ApplyStep(int partitionUpTo) {
+	void ApplyStep(Sci_Position partitionUpTo) {
 		if (stepLength != 0) {
 			body->RangeAddDelta(stepPartition+1, partitionUpTo + 1, stepLength);
 		}
@@ -64,14 +68,14 @@ private:
 	}
 
 	// Move step backward
-	void BackStep(int partitionDownTo) {
+	void BackStep(Sci_Position partitionDownTo) {
 		if (stepLength != 0) {
 			body->RangeAddDelta(partitionDownTo+1, stepPartition+1, -stepLength);
 		}
 		stepPartition = partitionDownTo;
 	}
 
-	void Allocate(int growSize) {
+	void Allocate(Sci_Position growSize) {
 		body = new SplitVectorWithRangeAdd(growSize);
 		stepPartition = 0;
 		stepLength = 0;
@@ -80,7 +84,7 @@ private:
 	}
 
 public:
-	Partitioning(int growSize) {
+	Partitioning(Sci_Position growSize) {
 		Allocate(growSize);
 	}
 
@@ -89,11 +93,11 @@ public:
 		body = 0;
 	}
 
-	int Partitions() const {
+	Sci_Position Partitions() const {
 		return body->Length()-1;
 	}
 
-	void InsertPartition(int partition, int pos) {
+	void InsertPartition(Sci_Position partition, Sci_Position pos) {
 		if (stepPartition < partition) {
 			ApplyStep(partition);
 		}
@@ -101,7 +105,16 @@ public:
 		stepPartition++;
 	}
 
-	void SetPartitionStartPosition(int partition, int pos) {
+	/// Insert several partitions with ascending start positions in one operation.
+	void InsertPartitions(Sci_Position partition, const Sci_Position *positions, Sci_Position count) {
+		if (stepPartition < partition) {
+			ApplyStep(partition);
+		}
+		body->InsertFromArray(partition, positions, 0, count);
+		stepPartition += count;
+	}
+
+	void SetPartitionStartPosition(Sci_Position partition, Sci_Position pos) {
 		ApplyStep(partition+1);
 		if ((partition < 0) || (partition > body->Length())) {
 			return;
@@ -109,7 +122,7 @@ public:
 		body->SetValueAt(partition, pos);
 	}
 
-	void InsertText(int partitionInsert, int delta) {
+	void InsertText(Sci_Position partitionInsert, Sci_Position delta) {
 		// Point all the partitions after the insertion point further along in the buffer
 		if (stepLength != 0) {
 			if (partitionInsert >= stepPartition) {
@@ -131,7 +144,7 @@ public:
 		}
 	}
 
-	void RemovePartition(int partition) {
+	void RemovePartition(Sci_Position partition) {
 		if (partition > stepPartition) {
 			ApplyStep(partition);
 			stepPartition--;
@@ -141,28 +154,28 @@ public:
 		body->Delete(partition);
 	}
 
-	int PositionFromPartition(int partition) const {
+	Sci_Position PositionFromPartition(Sci_Position partition) const {
 		PLATFORM_ASSERT(partition >= 0);
 		PLATFORM_ASSERT(partition < body->Length());
 		if ((partition < 0) || (partition >= body->Length())) {
 			return 0;
 		}
-		int pos = body->ValueAt(partition);
+		Sci_Position pos = body->ValueAt(partition);
 		if (partition > stepPartition)
 			pos += stepLength;
 		return pos;
 	}
 
-	int PartitionFromPosition(int pos) const {
+	Sci_Position PartitionFromPosition(Sci_Position pos) const {
 		if (body->Length() <= 1)
 			return 0;
 		if (pos >= (PositionFromPartition(body->Length()-1)))
 			return body->Length() - 1 - 1;
-		int lower = 0;
-		int upper = body->Length()-1;
+		Sci_Position lower = 0;
+		Sci_Position upper = body->Length()-1;
 		do {
-			int middle = (upper + lower + 1) / 2; 	// Round high
-			int posMiddle = body->ValueAt(middle);
+			Sci_Position middle = (upper + lower + 1) / 2; 	// Round high
+			Sci_Position posMiddle = body->ValueAt(middle);
 			if (middle > stepPartition)
 				posMiddle += stepLength;
 			if (pos < posMiddle) {
@@ -175,10 +188,443 @@ public:
 	}
 
 	void DeleteAll() {
-		int growSize = body->GetGrowSize();
+		Sci_Position growSize = body->GetGrowSize();
 		delete body;
 		Allocate(growSize);
 	}
 };
 
+/// Divide an interval into multiple partitions like Partitioning but hold the partition
+/// starts in blocks which are the nodes of a treap summing the length and extent of the blocks
+/// in each subtree. Inserting text or partitions, splitting or removing blocks and converting
+/// between positions and partitions then take logarithmic time plus a shift within one block
+/// wherever in the interval changes occur, rather than time proportional to the distance from
+/// the previous change.
+/// Used for the line index when SCI_LINE_INDEX_BLOCKED is defined.
+
+class PartitioningBlocked {
+private:
+	enum { blockSize = 256 };	///< Blocks are split when they reach twice this size
+	// Starts are relative to the first start of the block so starts[0] is always 0.
+	// span is the distance to the first start of the next block and is 0 for the last block.
+	// count, lengthTree and spanTree are the number of blocks and the sums of length and
+	// span over the subtree of the block.
+	// The starts are allocated separately so the nodes visited when descending are small.
+	struct Block {
+		Sci_Position *starts;
+		Sci_Position length;
+		Sci_Position span;
+		unsigned int priority;
+		Sci_Position count;
+		Sci_Position lengthTree;
+		Sci_Position spanTree;
+		Block *left;
+		Block *right;
+	};
+	Block *root;
+	unsigned int seed;
+	Sci_Position startsTotal;
+
+	static Sci_Position Count(const Block *pb) {
+		return pb ? pb->count : 0;
+	}
+
+	static Sci_Position LengthTree(const Block *pb) {
+		return pb ? pb->lengthTree : 0;
+	}
+
+	static Sci_Position SpanTree(const Block *pb) {
+		return pb ? pb->spanTree : 0;
+	}
+
+	static void Update(Block *pb) {
+		pb->count = 1 + Count(pb->left) + Count(pb->right);
+		pb->lengthTree = pb->length + LengthTree(pb->left) + LengthTree(pb->right);
+		pb->spanTree = pb->span + SpanTree(pb->left) + SpanTree(pb->right);
+	}
+
+	// Split into the first blocksBefore blocks and the rest
+	static void Split(Block *pb, Sci_Position blocksBefore, Block *&before, Block *&after) {
+		if (!pb) {
+			before = 0;
+			after = 0;
+			return;
+		}
+		if (Count(pb->left) < blocksBefore) {
+			Split(pb->right, blocksBefore - Count(pb->left) - 1, pb->right, after);
+			before = pb;
+		} else {
+			Split(pb->left, blocksBefore, before, pb->left);
+			after = pb;
+		}
+		Update(pb);
+	}
+
+	static Block *Merge(Block *before, Block *after) {
+		if (!before)
+			return after;
+		if (!after)
+			return before;
+		if (before->priority > after->priority) {
+			before->right = Merge(before->right, after);
+			Update(before);
+			return before;
+		} else {
+			after->left = Merge(before, after->left);
+			Update(after);
+			return after;
+		}
+	}
+
+	static void DeleteTree(Block *pb) {
+		if (pb) {
+			DeleteTree(pb->left);
+			DeleteTree(pb->right);
+			delete []pb->starts;
+			delete pb;
+		}
+	}
+
+	Block *NewBlock() {
+		Block *pb = new Block();
+		pb->starts = new Sci_Position[2 * blockSize]();
+		seed = seed * 1103515245 + 12345;
+		pb->priority = seed >> 8;
+		return pb;
+	}
+
+	Sci_Position Blocks() const {
+		return Count(root);
+	}
+
+	Block *BlockAt(Sci_Position block) const {
+		Block *pb = root;
+		for (;;) {
+			const Sci_Position countLeft = Count(pb->left);
+			if (block < countLeft) {
+				pb = pb->left;
+			} else if (block > countLeft) {
+				block -= countLeft + 1;
+				pb = pb->right;
+			} else {
+				return pb;
+			}
+		}
+	}
+
+	// Change the length and span of a block and the sums of the subtrees holding it
+	void AddToBlock(Sci_Position block, Sci_Position deltaLength, Sci_Position deltaSpan) {
+		Block *pb = root;
+		for (;;) {
+			pb->lengthTree += deltaLength;
+			pb->spanTree += deltaSpan;
+			const Sci_Position countLeft = Count(pb->left);
+			if (block < countLeft) {
+				pb = pb->left;
+			} else if (block > countLeft) {
+				block -= countLeft + 1;
+				pb = pb->right;
+			} else {
+				pb->length += deltaLength;
+				pb->span += deltaSpan;
+				return;
+			}
+		}
+	}
+
+	// Insert a block, or a treap of consecutive blocks, so it starts at block
+	void InsertBlocks(Sci_Position block, Block *pbInsert) {
+		Block *before;
+		Block *after;
+		Split(root, block, before, after);
+		root = Merge(Merge(before, pbInsert), after);
+	}
+
+	void RemoveBlock(Sci_Position block) {
+		Block *before;
+		Block *pb;
+		Block *after;
+		Split(root, block, before, after);
+		Split(after, 1, pb, after);
+		delete []pb->starts;
+		delete pb;
+		root = Merge(before, after);
+	}
+
+	// The block holding partition, its number, the index of partition in it and its first start
+	Block *BlockFromPartition(Sci_Position partition, Sci_Position &block, Sci_Position &index, Sci_Position &base) const {
+		Block *pb = root;
+		block = 0;
+		base = 0;
+		for (;;) {
+			if (pb->left && (partition < pb->left->lengthTree)) {
+				pb = pb->left;
+				continue;
+			}
+			partition -= LengthTree(pb->left);
+			block += Count(pb->left);
+			base += SpanTree(pb->left);
+			if ((partition < pb->length) || !pb->right) {
+				index = (partition < pb->length) ? partition : pb->length;
+				return pb;
+			}
+			partition -= pb->length;
+			block++;
+			base += pb->span;
+			pb = pb->right;
+		}
+	}
+
+	// The block holding pos, the offset of pos from its first start and the partitions before it
+	const Block *BlockFromPosition(Sci_Position pos, Sci_Position &offset, Sci_Position &partitionsBefore) const {
+		const Block *pb = root;
+		partitionsBefore = 0;
+		for (;;) {
+			if (pb->left && (pos < pb->left->spanTree)) {
+				pb = pb->left;
+				continue;
+			}
+			pos -= SpanTree(pb->left);
+			partitionsBefore += LengthTree(pb->left);
+			if ((pos < pb->span) || !pb->right) {
+				offset = pos;
+				return pb;
+			}
+			pos -= pb->span;
+			partitionsBefore += pb->length;
+			pb = pb->right;
+		}
+	}
+
+	// Move the first start of a block, other than the first block, by delta
+	void MoveBlockStart(Sci_Position block, Block *pb, Sci_Position delta) {
+		for (Sci_Position i = 1; i < pb->length; i++)
+			pb->starts[i] -= delta;
+		AddToBlock(block - 1, 0, delta);
+		if (block < Blocks() - 1)
+			AddToBlock(block, 0, -delta);
+	}
+
+	void SplitBlock(Sci_Position block, Block *pb) {
+		Block *pbNew = NewBlock();
+		Sci_Position offset = pb->starts[blockSize];
+		pbNew->length = pb->length - blockSize;
+		for (Sci_Position i = 0; i < pbNew->length; i++)
+			pbNew->starts[i] = pb->starts[blockSize + i] - offset;
+		pbNew->span = (block < Blocks() - 1) ? pb->span - offset : 0;
+		AddToBlock(block, blockSize - pb->length, offset - pb->span);
+		Update(pbNew);
+		InsertBlocks(block + 1, pbNew);
+	}
+
+	void Allocate() {
+		Block *pb = NewBlock();
+		pb->starts[0] = 0;	// This value stays 0 for ever
+		pb->starts[1] = 0;	// This is the end of the first partition and will be the start of the second
+		pb->length = 2;
+		pb->span = 0;
+		Update(pb);
+		root = pb;
+		startsTotal = 2;
+	}
+
+	void Free() {
+		DeleteTree(root);
+		root = 0;
+	}
+
+public:
+	PartitioningBlocked(Sci_Position) : root(0), seed(1), startsTotal(0) {
+		Allocate();
+	}
+
+	~PartitioningBlocked() {
+		Free();
+	}
+
+	Sci_Position Partitions() const {
+		return startsTotal-1;
+	}
+
+	void InsertPartition(Sci_Position partition, Sci_Position pos) {
+		Sci_Position block;
+		Sci_Position index;
+		Sci_Position base;
+		Block *pb = BlockFromPartition(partition, block, index, base);
+		if ((index == 0) && (block > 0)) {
+			// Add to the end of the previous block so the first start of this block is unchanged
+			block--;
+			pb = BlockAt(block);
+			index = pb->length;
+			base -= pb->span;
+		}
+		for (Sci_Position i = pb->length; i > index; i--)
+			pb->starts[i] = pb->starts[i-1];
+		pb->starts[index] = pos - base;
+		startsTotal++;
+		AddToBlock(block, 1, 0);
+		if (pb->length == 2 * blockSize)
+			SplitBlock(block, pb);
+	}
+
+	/// Insert several partitions with ascending start positions in one operation.
+	/// Many partitions fill the block where they are inserted up to blockSize and then
+	/// new blocks of blockSize which are added to the treap together.
+	void InsertPartitions(Sci_Position partition, const Sci_Position *positions, Sci_Position count) {
+		if (count < blockSize) {
+			for (Sci_Position i = 0; i < count; i++)
+				InsertPartition(partition + i, positions[i]);
+			return;
+		}
+		Sci_Position block;
+		Sci_Position index;
+		Sci_Position base;
+		Block *pb = BlockFromPartition(partition, block, index, base);
+		if ((index == 0) && (block > 0)) {
+			block--;
+			pb = BlockAt(block);
+			index = pb->length;
+			base -= pb->span;
+		}
+		const bool lastBlock = block == Blocks() - 1;
+		const Sci_Position positionNext = base + pb->span;	// First start of the next block
+		// The starts after the insertion point follow the inserted starts
+		Sci_Position tail[2 * blockSize];
+		const Sci_Position lengthTail = pb->length - index;
+		for (Sci_Position i = 0; i < lengthTail; i++)
+			tail[i] = base + pb->starts[index + i];
+		Sci_Position lengthFirst = 0;
+		Sci_Position spanFirst = pb->span;
+		Block *pbFill = pb;
+		Sci_Position baseFill = base;
+		Sci_Position lengthFill = index;
+		Block *blocksAdded = 0;	// Linked through right until they are merged
+		for (Sci_Position i = 0; i < count + lengthTail; i++) {
+			const Sci_Position pos = (i < count) ? positions[i] : tail[i - count];
+			if (lengthFill >= blockSize) {
+				Block *pbNew = NewBlock();
+				if (pbFill == pb) {
+					lengthFirst = lengthFill;
+					spanFirst = pos - baseFill;
+					blocksAdded = pbNew;
+				} else {
+					pbFill->length = lengthFill;
+					pbFill->span = pos - baseFill;
+					pbFill->right = pbNew;
+				}
+				pbFill = pbNew;
+				baseFill = pos;
+				lengthFill = 0;
+			}
+			pbFill->starts[lengthFill++] = pos - baseFill;
+		}
+		if (pbFill == pb) {
+			lengthFirst = lengthFill;
+		} else {
+			pbFill->length = lengthFill;
+			pbFill->span = lastBlock ? 0 : positionNext - baseFill;
+		}
+		startsTotal += count;
+		AddToBlock(block, lengthFirst - pb->length, spanFirst - pb->span);
+		Block *added = 0;
+		while (blocksAdded) {
+			Block *pbNext = blocksAdded->right;
+			blocksAdded->right = 0;
+			Update(blocksAdded);
+			added = Merge(added, blocksAdded);
+			blocksAdded = pbNext;
+		}
+		if (added)
+			InsertBlocks(block + 1, added);
+	}
+
+	void SetPartitionStartPosition(Sci_Position partition, Sci_Position pos) {
+		if ((partition < 0) || (partition >= startsTotal)) {
+			return;
+		}
+		Sci_Position block;
+		Sci_Position index;
+		Sci_Position base;
+		Block *pb = BlockFromPartition(partition, block, index, base);
+		if ((index == 0) && (block > 0))
+			MoveBlockStart(block, pb, pos - base);
+		else
+			pb->starts[index] = pos - base;
+	}
+
+	void InsertText(Sci_Position partitionInsert, Sci_Position delta) {
+		// Point all the partitions after the insertion point further along in the buffer
+		Sci_Position block;
+		Sci_Position index;
+		Sci_Position base;
+		Block *pb = BlockFromPartition(partitionInsert, block, index, base);
+		for (Sci_Position i = index + 1; i < pb->length; i++)
+			pb->starts[i] += delta;
+		if (block < Blocks() - 1)
+			AddToBlock(block, 0, delta);
+	}
+
+	void RemovePartition(Sci_Position partition) {
+		Sci_Position block;
+		Sci_Position index;
+		Sci_Position base;
+		Block *pb = BlockFromPartition(partition, block, index, base);
+		startsTotal--;
+		if ((index == 0) && (block > 0)) {
+			if (pb->length == 1) {
+				// Drop the block, extending the previous block over its span
+				if (block == Blocks() - 1)
+					AddToBlock(block - 1, 0, -BlockAt(block - 1)->span);
+				else
+					AddToBlock(block - 1, 0, pb->span);
+				RemoveBlock(block);
+				return;
+			}
+			MoveBlockStart(block, pb, pb->starts[1]);
+		}
+		for (Sci_Position i = index; i < pb->length - 1; i++)
+			pb->starts[i] = pb->starts[i+1];
+		AddToBlock(block, -1, 0);
+	}
+
+	Sci_Position PositionFromPartition(Sci_Position partition) const {
+		PLATFORM_ASSERT(partition >= 0);
+		PLATFORM_ASSERT(partition < startsTotal);
+		if ((partition < 0) || (partition >= startsTotal)) {
+			return 0;
+		}
+		Sci_Position block;
+		Sci_Position index;
+		Sci_Position base;
+		const Block *pb = BlockFromPartition(partition, block, index, base);
+		return base + pb->starts[index];
+	}
+
+	Sci_Position PartitionFromPosition(Sci_Position pos) const {
+		if (startsTotal <= 1)
+			return 0;
+		if (pos >= (PositionFromPartition(startsTotal-1)))
+			return startsTotal - 1 - 1;
+		Sci_Position offset;
+		Sci_Position partitionsBefore;
+		const Block *pb = BlockFromPosition(pos, offset, partitionsBefore);
+		Sci_Position lower = 0;
+		Sci_Position upper = pb->length - 1;
+		while (lower < upper) {
+			Sci_Position middle = (upper + lower + 1) / 2; 	// Round high
+			if (offset < pb->starts[middle]) {
+				upper = middle - 1;
+			} else {
+				lower = middle;
+			}
+		}
+		return partitionsBefore + lower;
+	}
+
+	void DeleteAll() {
+		Free();
+		Allocate();
+	}
+};
+
 #endif
@@ -7,8 +7,11 @@
 
 #include <string.h>
 
+#include <map>
+
 #include "Platform.h"
 
+#include "Sci_Position.h"
 #include "Scintilla.h"
 #include "SplitVector.h"
 #include "Partitioning.h"
@@ -124,48 +127,310 @@ void MarkerHandleSet::CombineWith(MarkerHandleSet *other) {
 	other->root = 0;
 }
 
+MarkerHandleLines::MarkerHandleLines() : root(0), seed(1) {
+}
+
+MarkerHandleLines::~MarkerHandleLines() {
+	Clear();
+}
+
+void MarkerHandleLines::Clear() {
+	for (std::map<int, Node *>::iterator it = nodes.begin(); it != nodes.end(); ++it)
+		delete it->second;
+	nodes.clear();
+	root = 0;
+}
+
+void MarkerHandleLines::Push(Node *node) {
+	if (node->delta) {
+		if (node->left) {
+			node->left->line += node->delta;
+			node->left->delta += node->delta;
+		}
+		if (node->right) {
+			node->right->line += node->delta;
+			node->right->delta += node->delta;
+		}
+		node->delta = 0;
+	}
+}
+
+void MarkerHandleLines::PushFromRoot(Node *node) {
+	if (node->parent)
+		PushFromRoot(node->parent);
+	Push(node);
+}
+
+/// Split into the nodes before line and those on or after it.
+void MarkerHandleLines::Split(Node *node, Sci_Position line, Node *&before, Node *&after) {
+	if (!node) {
+		before = 0;
+		after = 0;
+		return;
+	}
+	Push(node);
+	if (node->line < line) {
+		Split(node->right, line, node->right, after);
+		if (node->right)
+			node->right->parent = node;
+		before = node;
+	} else {
+		Split(node->left, line, before, node->left);
+		if (node->left)
+			node->left->parent = node;
+		after = node;
+	}
+}
+
+MarkerHandleLines::Node *MarkerHandleLines::Merge(Node *before, Node *after) {
+	if (!before)
+		return after;
+	if (!after)
+		return before;
+	if (before->priority > after->priority) {
+		Push(before);
+		before->right = Merge(before->right, after);
+		before->right->parent = before;
+		return before;
+	} else {
+		Push(after);
+		after->left = Merge(before, after->left);
+		after->left->parent = after;
+		return after;
+	}
+}
+
+void MarkerHandleLines::Add(int handle, Sci_Position line) {
+	Node *node = new Node;
+	node->handle = handle;
+	seed = seed * 1103515245 + 12345;
+	node->priority = seed >> 8;
+	node->line = line;
+	node->delta = 0;
+	node->left = 0;
+	node->right = 0;
+	nodes[handle] = node;
+	Node *before;
+	Node *after;
+	Split(root, line, before, after);
+	root = Merge(Merge(before, node), after);
+	root->parent = 0;
+}
+
+void MarkerHandleLines::Remove(int handle) {
+	std::map<int, Node *>::iterator it = nodes.find(handle);
+	if (it == nodes.end())
+		return;
+	Node *node = it->second;
+	nodes.erase(it);
+	// Apply the pending changes from the root down so the children have their lines
+	PushFromRoot(node);
+	Node *replacement = Merge(node->left, node->right);
+	if (replacement)
+		replacement->parent = node->parent;
+	if (!node->parent)
+		root = replacement;
+	else if (node->parent->left == node)
+		node->parent->left = replacement;
+	else
+		node->parent->right = replacement;
+	delete node;
+}
+
+/// Move the marks on line and after by delta lines.
+void MarkerHandleLines::MoveLines(Sci_Position line, Sci_Position delta) {
+	if (!root)
+		return;
+	Node *before;
+	Node *after;
+	Split(root, line, before, after);
+	if (after) {
+		after->line += delta;
+		after->delta += delta;
+	}
+	root = Merge(before, after);
+	root->parent = 0;
+}
+
+Sci_Position MarkerHandleLines::LineFromHandle(int handle) const {
+	std::map<int, Node *>::const_iterator it = nodes.find(handle);
+	if (it == nodes.end())
+		return -1;
+	Sci_Position line = it->second->line;
+	for (const Node *ancestor = it->second->parent; ancestor; ancestor = ancestor->parent)
+		line += ancestor->delta;
+	return line;
+}
+
+MarkerIndex::MarkerIndex(Sci_Position linesInDocument) : lines(8), handles() {
+	// The end of the last partition stays after every line
+	lines.SetPartitionStartPosition(1, linesInDocument + 1);
+}
+
+/// The number of marks on lines before or at line.
+Sci_Position MarkerIndex::MarksUpTo(Sci_Position line) const {
+	if (line < 0)
+		return 0;
+	return lines.PartitionFromPosition(line + 1);
+}
+
+Sci_Position MarkerIndex::LineFromMark(Sci_Position mark) const {
+	return lines.PositionFromPartition(mark + 1) - 1;
+}
+
+bool MarkerIndex::Empty() const {
+	return handles.Length() == 0;
+}
+
+/// Move the marks on line and after by delta lines.
+void MarkerIndex::MoveLines(Sci_Position line, Sci_Position delta) {
+	lines.InsertText(MarksUpTo(line - 1), delta);
+}
+
+void MarkerIndex::Add(Sci_Position line, int handle) {
+	const Sci_Position mark = MarksUpTo(line);
+	lines.InsertPartition(mark + 1, line + 1);
+	handles.Insert(mark, handle);
+}
+
+void MarkerIndex::Remove(Sci_Position line, int handle) {
+	const Sci_Position markEnd = MarksUpTo(line);
+	for (Sci_Position mark = MarksUpTo(line - 1); mark < markEnd; mark++) {
+		if (handles.ValueAt(mark) == handle) {
+			lines.RemovePartition(mark + 1);
+			handles.Delete(mark);
+			return;
+		}
+	}
+}
+
+/// Remove every mark on line, forgetting their handles.
+void MarkerIndex::RemoveLine(Sci_Position line, MarkerHandleLines &handleLines) {
+	const Sci_Position markStart = MarksUpTo(line - 1);
+	for (Sci_Position mark = MarksUpTo(line) - 1; mark >= markStart; mark--) {
+		handleLines.Remove(handles.ValueAt(mark));
+		lines.RemovePartition(mark + 1);
+		handles.Delete(mark);
+	}
+}
+
+/// The first line at or after line with a mark, or -1 if there is none.
+Sci_Position MarkerIndex::Next(Sci_Position line) const {
+	const Sci_Position mark = MarksUpTo(line - 1);
+	if (mark < handles.Length())
+		return LineFromMark(mark);
+	return -1;
+}
+
+/// The last line at or before line with a mark, or -1 if there is none.
+Sci_Position MarkerIndex::Previous(Sci_Position line) const {
+	const Sci_Position mark = MarksUpTo(line);
+	if (mark > 0)
+		return LineFromMark(mark - 1);
+	return -1;
+}
+
 LineMarkers::~LineMarkers() {
 	Init();
 }
 
 void LineMarkers::Init() {
-	for (int line = 0; line < markers.Length(); line++) {
+	for (Sci_Position line = 0; line < markers.Length(); line++) {
 		delete markers[line];
 		markers[line] = 0;
 	}
 	markers.DeleteAll();
+	for (int n = 0; n <= MARKER_MAX; n++) {
+		delete indexes[n];
+		indexes[n] = 0;
+	}
+	handleLines.Clear();
 }
 
-void LineMarkers::InsertLine(int line) {
+void LineMarkers::InsertLine(Sci_Position line) {
 	if (markers.Length()) {
 		markers.Insert(line, 0);
+		for (int n = 0; n <= MARKER_MAX; n++) {
+			if (indexes[n])
+				indexes[n]->MoveLines(line, 1);
+		}
+		handleLines.MoveLines(line, 1);
 	}
 }
 
-void LineMarkers::RemoveLine(int line) {
+void LineMarkers::InsertLines(Sci_Position line, Sci_Position lines) {
+	if (markers.Length()) {
+		markers.InsertValue(line, lines, 0);
+		for (int n = 0; n <= MARKER_MAX; n++) {
+			if (indexes[n])
+				indexes[n]->MoveLines(line, lines);
+		}
+		handleLines.MoveLines(line, lines);
+	}
+}
+
+void LineMarkers::RemoveLine(Sci_Position line) {
 	// Retain the markers from the deleted line by oring them into the previous line
 	if (markers.Length()) {
 		if (line > 0) {
 			MergeMarkers(line - 1);
+		} else {
+			IndexRemove(line, -1);
 		}
 		markers.Delete(line);
+		for (int n = 0; n <= MARKER_MAX; n++) {
+			if (indexes[n])
+				indexes[n]->MoveLines(line, -1);
+		}
+		// Marks merged into the previous line move with the later marks
+		handleLines.MoveLines(line, -1);
 	}
 }
 
-int LineMarkers::LineFromHandle(int markerHandle) {
-	if (markers.Length()) {
-		for (int line = 0; line < markers.Length(); line++) {
-			if (markers[line]) {
-				if (markers[line]->Contains(markerHandle)) {
-					return line;
-				}
+/// Remove the marks with markerNum, or with any number when markerNum is -1, on line from the indexes.
+void LineMarkers::IndexRemove(Sci_Position line, int markerNum) {
+	for (int n = 0; n <= MARKER_MAX; n++) {
+		if (indexes[n] && ((markerNum == -1) || (markerNum == n))) {
+			indexes[n]->RemoveLine(line, handleLines);
+			if (indexes[n]->Empty()) {
+				delete indexes[n];
+				indexes[n] = 0;
 			}
 		}
 	}
-	return -1;
 }
 
-void LineMarkers::MergeMarkers(int pos) {
+Sci_Position LineMarkers::LineFromHandle(int markerHandle) {
+	return handleLines.LineFromHandle(markerHandle);
+}
+
+/// The first line at or after lineStart with any of the markers in mask, or -1.
+Sci_Position LineMarkers::MarkerNext(Sci_Position lineStart, int mask) const {
+	Sci_Position lineFound = -1;
+	for (int n = 0; n <= MARKER_MAX; n++) {
+		if (indexes[n] && (static_cast<unsigned int>(mask) & (1U << n))) {
+			const Sci_Position line = indexes[n]->Next(lineStart);
+			if ((line >= 0) && ((lineFound < 0) || (line < lineFound)))
+				lineFound = line;
+		}
+	}
+	return lineFound;
+}
+
+/// The last line at or before lineStart with any of the markers in mask, or -1.
+Sci_Position LineMarkers::MarkerPrevious(Sci_Position lineStart, int mask) const {
+	Sci_Position lineFound = -1;
+	for (int n = 0; n <= MARKER_MAX; n++) {
+		if (indexes[n] && (static_cast<unsigned int>(mask) & (1U << n))) {
+			const Sci_Position line = indexes[n]->Previous(lineStart);
+			if (line > lineFound)
+				lineFound = line;
+		}
+	}
+	return lineFound;
+}
+
+void LineMarkers::MergeMarkers(Sci_Position pos) {
 	if (markers[pos + 1] != NULL) {
 		if (markers[pos] == NULL)
 			markers[pos] = new MarkerHandleSet;
@@ -175,15 +440,18 @@ void LineMarkers::MergeMarkers(int pos) {
 	}
 }
 
-int LineMarkers::MarkValue(int line) {
+int LineMarkers::MarkValue(Sci_Position line) {
 	if (markers.Length() && (line >= 0) && (line < markers.Length()) && markers[line])
 		return markers[line]->MarkValue();
 	else
 		return 0;
 }
 
-int LineMarkers::AddMark(int line, int markerNum, int lines) {
+int LineMarkers::AddMark(Sci_Position line, int markerNum, Sci_Position lines) {
 	handleCurrent++;
+	if ((markerNum < 0) || (markerNum > MARKER_MAX)) {
+		return -1;
+	}
 	if (!markers.Length()) {
 		// No existing markers so allocate one element per line
 		markers.InsertValue(0, lines, 0);
@@ -198,11 +466,15 @@ int LineMarkers::AddMark(int line, int markerNum, int lines) {
 			return -1;
 	}
 	markers[line]->InsertHandle(handleCurrent, markerNum);
+	if (!indexes[markerNum])
+		indexes[markerNum] = new MarkerIndex(markers.Length());
+	indexes[markerNum]->Add(line, handleCurrent);
+	handleLines.Add(handleCurrent, line);
 
 	return handleCurrent;
 }
 
-void LineMarkers::DeleteMark(int line, int markerNum, bool all) {
+void LineMarkers::DeleteMark(Sci_Position line, int markerNum, bool all) {
 	if (markers.Length() && (line >= 0) && (line < markers.Length()) && markers[line]) {
 		if (markerNum == -1) {
 			delete markers[line];
@@ -217,17 +489,37 @@ void LineMarkers::DeleteMark(int line, int markerNum, bool all) {
 				markers[line] = NULL;
 			}
 		}
+		// RemoveNumber removes every mark with the number so the index does too
+		IndexRemove(line, markerNum);
 	}
 }
 
 void LineMarkers::DeleteMarkFromHandle(int markerHandle) {
-	int line = LineFromHandle(markerHandle);
+	Sci_Position line = LineFromHandle(markerHandle);
 	if (line >= 0) {
+		const int markerNum = markers[line]->NumberFromHandle(markerHandle);
 		markers[line]->RemoveHandle(markerHandle);
 		if (markers[line]->Length() == 0) {
 			delete markers[line];
 			markers[line] = NULL;
 		}
+		indexes[markerNum]->Remove(line, markerHandle);
+		handleLines.Remove(markerHandle);
+		if (indexes[markerNum]->Empty()) {
+			delete indexes[markerNum];
+			indexes[markerNum] = 0;
+		}
+	}
+}
+
+/// Delete every mark with markerNum, or every mark when markerNum is -1, visiting only marked lines.
+void LineMarkers::DeleteAllMarks(int markerNum) {
+	for (int n = 0; n <= MARKER_MAX; n++) {
+		if ((markerNum == -1) || (markerNum == n)) {
+			while (indexes[n]) {
+				DeleteMark(indexes[n]->Next(0), markerNum, true);
+			}
+		}
 	}
 }
 
@@ -238,7 +530,7 @@ void LineLevels::Init() {
 	levels.DeleteAll();
 }
 
-void LineLevels::InsertLine(int line) {
+void LineLevels::InsertLine(Sci_Position line) {
 	if (levels.Length()) {
 		int level = SC_FOLDLEVELBASE;
 		if ((line > 0) && (line < levels.Length())) {
@@ -248,7 +540,17 @@ void LineLevels::InsertLine(int line) {
 	}
 }
 
-void LineLevels::RemoveLine(int line) {
+void LineLevels::InsertLines(Sci_Position line, Sci_Position lines) {
+	if (levels.Length()) {
+		int level = SC_FOLDLEVELBASE;
+		if ((line > 0) && (line < levels.Length())) {
+			level = levels[line-1] & ~SC_FOLDLEVELWHITEFLAG;
+		}
+		levels.InsertValue(line, lines, level);
+	}
+}
+
+void LineLevels::RemoveLine(Sci_Position line) {
 	if (levels.Length()) {
 		// Move up following lines but merge header flag from this line
 		// to line before to avoid a temporary disappearence causing expansion.
@@ -261,7 +563,7 @@ void LineLevels::RemoveLine(int line) {
 	}
 }
 
-void LineLevels::ExpandLevels(int sizeNew) {
+void LineLevels::ExpandLevels(Sci_Position sizeNew) {
 	levels.InsertValue(levels.Length(), sizeNew - levels.Length(), SC_FOLDLEVELBASE);
 }
 
@@ -269,7 +571,7 @@ void LineLevels::ClearLevels() {
 	levels.DeleteAll();
 }
 
-int LineLevels::SetLevel(int line, int level, int lines) {
+int LineLevels::SetLevel(Sci_Position line, int level, Sci_Position lines) {
 	int prev = 0;
 	if ((line >= 0) && (line < lines)) {
 		if (!levels.Length()) {
@@ -283,7 +585,7 @@ int LineLevels::SetLevel(int line, int level, int lines) {
 	return prev;
 }
 
-int LineLevels::GetLevel(int line) {
+int LineLevels::GetLevel(Sci_Position line) {
 	if (levels.Length() && (line >= 0) && (line < levels.Length())) {
 		return levels[line];
 	} else {
@@ -298,33 +600,40 @@ void LineState::Init() {
 	lineStates.DeleteAll();
 }
 
-void LineState::InsertLine(int line) {
+void LineState::InsertLine(Sci_Position line) {
 	if (lineStates.Length()) {
 		lineStates.EnsureLength(line);
 		lineStates.Insert(line, 0);
 	}
 }
 
-void LineState::RemoveLine(int line) {
+void LineState::InsertLines(Sci_Position line, Sci_Position lines) {
+	if (lineStates.Length()) {
+		lineStates.EnsureLength(line);
+		lineStates.InsertValue(line, lines, 0);
+	}
+}
+
+void LineState::RemoveLine(Sci_Position line) {
 	if (lineStates.Length() > line) {
 		lineStates.Delete(line);
 	}
 }
 
-int LineState::SetLineState(int line, int state) {
+int LineState::SetLineState(Sci_Position line, int state) {
 	lineStates.EnsureLength(line + 1);
 	int stateOld = lineStates[line];
 	lineStates[line] = state;
 	return stateOld;
 }
 
-int LineState::GetLineState(int line) {
+int LineState::GetLineState(Sci_Position line) {
 	lineStates.EnsureLength(line + 1);
 	return lineStates[line];
 }
 
 int LineState::GetMaxLineState() {
-	return lineStates.Length();
+	return static_cast<int>(lineStates.Length());
 }
 
 static int NumberLines(const char *text) {
@@ -360,14 +669,21 @@ void LineAnnotation::Init() {
 	ClearAll();
 }
 
-void LineAnnotation::InsertLine(int line) {
+void LineAnnotation::InsertLine(Sci_Position line) {
 	if (annotations.Length()) {
 		annotations.EnsureLength(line);
 		annotations.Insert(line, 0);
 	}
 }
 
-void LineAnnotation::RemoveLine(int line) {
+void LineAnnotation::InsertLines(Sci_Position line, Sci_Position lines) {
+	if (annotations.Length()) {
+		annotations.EnsureLength(line);
+		annotations.InsertValue(line, lines, 0);
+	}
+}
+
+void LineAnnotation::RemoveLine(Sci_Position line) {
 	if (annotations.Length() && (line < annotations.Length())) {
 		delete []annotations[line];
 		annotations.Delete(line);
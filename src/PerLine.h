@@ -41,24 +41,89 @@ public:
 	void CombineWith(MarkerHandleSet *other);
 };
 
+/**
+ * The line of each live marker handle.
+ * Marks are nodes of a treap ordered by line. A change of line for a whole subtree is held
+ * at its root until the subtree is visited, so inserting or removing lines moves every later
+ * mark in O(log n) and the line of a handle is found by adding up the pending changes above
+ * its node. Handles are forgotten when their marks are deleted.
+ */
+class MarkerHandleLines {
+	struct Node {
+		int handle;
+		unsigned int priority;
+		Sci_Position line;
+		Sci_Position delta;	///< Not yet applied to the lines of the children
+		Node *left;
+		Node *right;
+		Node *parent;
+	};
+	Node *root;
+	std::map<int, Node *> nodes;
+	unsigned int seed;
+	static void Push(Node *node);
+	static void PushFromRoot(Node *node);
+	static void Split(Node *node, Sci_Position line, Node *&before, Node *&after);
+	static Node *Merge(Node *before, Node *after);
+public:
+	MarkerHandleLines();
+	~MarkerHandleLines();
+	void Clear();
+	void Add(int handle, Sci_Position line);
+	void Remove(int handle);
+	void MoveLines(Sci_Position line, Sci_Position delta);
+	Sci_Position LineFromHandle(int handle) const;
+};
+
+/**
+ * The lines holding one marker number in ascending order with the handle of each mark.
+ * Mark i is held as the start of partition i + 1 at its line + 1 so that Partitioning
+ * moves the marks after an insertion or removal of lines with its step.
+ */
+class MarkerIndex {
+	Partitioning lines;
+	SplitVector<int> handles;
+	Sci_Position MarksUpTo(Sci_Position line) const;
+	Sci_Position LineFromMark(Sci_Position mark) const;
+public:
+	MarkerIndex(Sci_Position linesInDocument);
+	bool Empty() const;
+	void MoveLines(Sci_Position line, Sci_Position delta);
+	void Add(Sci_Position line, int handle);
+	void Remove(Sci_Position line, int handle);
+	void RemoveLine(Sci_Position line, MarkerHandleLines &handleLines);
+	Sci_Position Next(Sci_Position line) const;
+	Sci_Position Previous(Sci_Position line) const;
+};
+
 class LineMarkers : public PerLine {
 	SplitVector<MarkerHandleSet *> markers;
 	/// Handles are allocated sequentially and should never have to be reused as 32 bit ints are very big.
 	int handleCurrent;
+	MarkerHandleLines handleLines;
+	/// For each marker number, the lines with that marker or NULL when there are none.
+	MarkerIndex *indexes[MARKER_MAX + 1];
+	void IndexRemove(Sci_Position line, int markerNum);
 public:
 	LineMarkers() : handleCurrent(0) {
+		for (int n = 0; n <= MARKER_MAX; n++)
+			indexes[n] = 0;
 	}
 	virtual ~LineMarkers();
 	virtual void Init();
-	virtual void InsertLine(int line);
-	virtual void RemoveLine(int line);
+	virtual void InsertLine(Sci_Position line);
+	virtual void InsertLines(Sci_Position line, Sci_Position lines);
+	virtual void RemoveLine(Sci_Position line);
 
-	int MarkValue(int line);
-	int AddMark(int line, int marker, int lines);
-	void MergeMarkers(int pos);
-	void DeleteMark(int line, int markerNum, bool all);
+	int MarkValue(Sci_Position line);
+	int AddMark(Sci_Position line, int marker, Sci_Position lines);
+	void MergeMarkers(Sci_Position pos);
+	void DeleteMark(Sci_Position line, int markerNum, bool all);
 	void DeleteMarkFromHandle(int markerHandle);
-	int LineFromHandle(int markerHandle);
+	void DeleteAllMarks(int markerNum);
+	Sci_Position LineFromHandle(int markerHandle);
+	Sci_Position MarkerNext(Sci_Position lineStart, int mask) const;
+	Sci_Position MarkerPrevious(Sci_Position lineStart, int mask) const;
 };
 
 class LineLevels : public PerLine {
@@ -66,13 +131,14 @@ class LineLevels : public PerLine {
 public:
 	virtual ~LineLevels();
 	virtual void Init();
-	virtual void InsertLine(int line);
-	virtual void RemoveLine(int line);
+	virtual void InsertLine(Sci_Position line);
+	virtual void InsertLines(Sci_Position line, Sci_Position lines);
+	virtual void RemoveLine(Sci_Position line);
 
-	void ExpandLevels(int sizeNew=-1);
+	void ExpandLevels(Sci_Position sizeNew=-1);
 	void ClearLevels();
-	int SetLevel(int line, int level, int lines);
-	int GetLevel(int line);
+	int SetLevel(Sci_Position line, int level, Sci_Position lines);
+	int GetLevel(Sci_Position line);
 };
 
 class LineState : public PerLine {
@@ -82,11 +148,12 @@ public:
 	}
 	virtual ~LineState();
 	virtual void Init();
-	virtual void InsertLine(int line);
-	virtual void RemoveLine(int line);
+	virtual void InsertLine(Sci_Position line);
+	virtual void InsertLines(Sci_Position line, Sci_Position lines);
+	virtual void RemoveLine(Sci_Position line);
 
-	int SetLineState(int line, int state);
-	int GetLineState(int line);
+	int SetLineState(Sci_Position line, int state);
+	int GetLineState(Sci_Position line);
 	int GetMaxLineState();
 };
 
@@ -97,8 +164,9 @@ public:
 	}
 	virtual ~LineAnnotation();
 	virtual void Init();
-	virtual void InsertLine(int line);
-	virtual void RemoveLine(int line);
+	virtual void InsertLine(Sci_Position line);
+	virtual void InsertLines(Sci_Position line, Sci_Position lines);
+	virtual void RemoveLine(Sci_Position line);
 
 	bool AnySet() const;
 	bool MultipleStyles(int line) const;
@@ -15,6 +15,7 @@
 
 #include "Platform.h"
 
+#include "Sci_Position.h"
 #include "Scintilla.h"
 
 #include "SplitVector.h"
@@ -205,7 +206,7 @@ int LineLayout::EndLineStyle() const {
 
 LineLayoutCache::LineLayoutCache() :
 	level(0), length(0), size(0), cache(0),
-	allInvalidated(false), styleClock(-1), useCount(0) {
+	allInvalidated(false), useCount(0) {
 	Allocate(0);
 }
 
@@ -277,6 +278,24 @@ void LineLayoutCache::Invalidate(LineLayout::validLevel validity_) {
 	}
 }
 
+/// Invalidate only the layouts of lines from lineFirst to lineLast inclusive.
+void LineLayoutCache::Invalidate(LineLayout::validLevel validity_, int lineFirst, int lineLast) {
+	if (cache && !allInvalidated) {
+		int first = 0;
+		int last = length - 1;
+		if (level == llcDocument) {
+			// Each line is cached at its own index so only visit the range
+			first = Platform::Maximum(first, lineFirst);
+			last = Platform::Minimum(last, lineLast);
+		}
+		for (int i = first; i <= last; i++) {
+			if (cache[i] && (cache[i]->lineNumber >= lineFirst) && (cache[i]->lineNumber <= lineLast)) {
+				cache[i]->Invalidate(validity_);
+			}
+		}
+	}
+}
+
 void LineLayoutCache::SetLevel(int level_) {
 	allInvalidated = false;
 	if ((level_ != -1) && (level != level_)) {
@@ -285,13 +304,9 @@ void LineLayoutCache::SetLevel(int level_) {
 	}
 }
 
-LineLayout *LineLayoutCache::Retrieve(int lineNumber, int lineCaret, int maxChars, int styleClock_,
+LineLayout *LineLayoutCache::Retrieve(int lineNumber, int lineCaret, int maxChars,
                                       int linesOnScreen, int linesInDoc) {
 	AllocateForLevel(linesOnScreen, linesInDoc);
-	if (styleClock != styleClock_) {
-		Invalidate(LineLayout::llCheckTextAndStyle);
-		styleClock = styleClock_;
-	}
 	allInvalidated = false;
 	int pos = -1;
 	LineLayout *ret = 0;
@@ -419,8 +434,10 @@ BreakFinder::BreakFinder(LineLayout *ll_, int lineStart_, int lineEnd_, int posL
 		SelectionPosition posStart(posLineStart);
 		SelectionPosition posEnd(posLineStart + lineEnd);
 		SelectionSegment segmentLine(posStart, posEnd);
-		for (size_t r=0; r<ll->psel->Count(); r++) {
-			SelectionSegment portion = ll->psel->Range(r).Intersect(segmentLine);
+		std::vector<size_t> rangesOnLine;
+		ll->psel->RangesOverlapping(posStart.Position(), posEnd.Position(), rangesOnLine);
+		for (size_t i=0; i<rangesOnLine.size(); i++) {
+			SelectionSegment portion = ll->psel->Range(rangesOnLine[i]).Intersect(segmentLine);
 			if (!(portion.start == portion.end)) {
 				if (portion.start.IsValid())
 					Insert(portion.start.Position() - posLineStart - 1);
@@ -526,19 +543,20 @@ int BreakFinder::Next() {
 }
 
 PositionCacheEntry::PositionCacheEntry() :
-	styleNumber(0), len(0), clock(0), positions(0) {
+	styleNumber(0), len(0), hash(0), clock(0), positions(0) {
 }
 
 void PositionCacheEntry::Set(unsigned int styleNumber_, const char *s_,
-	unsigned int len_, int *positions_, unsigned int clock_) {
+	unsigned int len_, int *positions_, unsigned int hash_, unsigned int clock_) {
 	Clear();
 	styleNumber = styleNumber_;
 	len = len_;
+	hash = hash_;
 	clock = clock_;
 	if (s_ && positions_) {
-		positions = new short[len + (len + 1) / 2];
+		positions = new int[len + (len + sizeof(int) - 1) / sizeof(int)];
 		for (unsigned int i=0; i<len; i++) {
-			positions[i] = static_cast<short>(positions_[i]);
+			positions[i] = positions_[i];
 		}
 		memcpy(reinterpret_cast<char *>(positions + len), s_, len);
 	}
@@ -553,12 +571,25 @@ void PositionCacheEntry::Clear() {
 	positions = 0;
 	styleNumber = 0;
 	len = 0;
+	hash = 0;
 	clock = 0;
 }
 
+/// Move the contents of other into this entry, leaving other empty.
+void PositionCacheEntry::TakeFrom(PositionCacheEntry &other) {
+	Clear();
+	styleNumber = other.styleNumber;
+	len = other.len;
+	hash = other.hash;
+	clock = other.clock;
+	positions = other.positions;
+	other.positions = 0;
+	other.Clear();
+}
+
 bool PositionCacheEntry::Retrieve(unsigned int styleNumber_, const char *s_,
-	unsigned int len_, int *positions_) const {
-	if ((styleNumber == styleNumber_) && (len == len_) &&
+	unsigned int len_, int *positions_, unsigned int hash_) const {
+	if (positions && (hash == hash_) && (styleNumber == styleNumber_) && (len == len_) &&
 		(memcmp(reinterpret_cast<char *>(positions + len), s_, len)== 0)) {
 		for (unsigned int i=0; i<len; i++) {
 			positions_[i] = positions[i];
@@ -569,16 +600,19 @@ bool PositionCacheEntry::Retrieve(unsigned int styleNumber_, const char *s_,
 	}
 }
 
-int PositionCacheEntry::Hash(unsigned int styleNumber, const char *s, unsigned int len) {
-	unsigned int ret = s[0] << 7;
+/// FNV-1a over the text followed by a final mix so that all bits of the result depend on every byte.
+unsigned int PositionCacheEntry::Hash(unsigned int styleNumber, const char *s, unsigned int len) {
+	unsigned int ret = 2166136261u ^ styleNumber;
 	for (unsigned int i=0; i<len; i++) {
-		ret *= 1000003;
-		ret ^= s[i];
+		ret ^= static_cast<unsigned char>(s[i]);
+		ret *= 16777619u;
 	}
-	ret *= 1000003;
 	ret ^= len;
-	ret *= 1000003;
-	ret ^= styleNumber;
+	ret ^= ret >> 16;
+	ret *= 0x85ebca6bu;
+	ret ^= ret >> 13;
+	ret *= 0xc2b2ae35u;
+	ret ^= ret >> 16;
 	return ret;
 }
 
@@ -592,11 +626,17 @@ void PositionCacheEntry::ResetClock() {
 	}
 }
 
-PositionCache::PositionCache() {
+PositionCache::PositionCache() : pces(0), sizeTable(0) {
 	size = 0x400;
 	clock = 1;
-	pces = new PositionCacheEntry[size];
 	allClear = true;
+	hits = 0;
+	misses = 0;
+	evictions = 0;
+	evictionsRecent = 0;
+	clockSampled = clock;
+	entries = 0;
+	Allocate(size);
 }
 
 PositionCache::~PositionCache() {
@@ -604,57 +644,153 @@ PositionCache::~PositionCache() {
 	delete []pces;
 }
 
+/// Replace the table with an empty one of at least sizeTable_ slots, rounded up to a power of 2.
+void PositionCache::Allocate(size_t sizeTable_) {
+	delete []pces;
+	pces = 0;
+	sizeTable = 0;
+	if (sizeTable_ > 0) {
+		sizeTable = probes;
+		while (sizeTable < sizeTable_)
+			sizeTable *= 2;
+		pces = new PositionCacheEntry[sizeTable];
+	}
+	evictionsRecent = 0;
+	clockSampled = clock;
+	entries = 0;
+}
+
+/// Move to a new table of sizeTable_ slots, keeping the entries that fit within their probe
+/// sequence. Entries used since the last sample go first so a smaller table keeps them.
+void PositionCache::Resize(size_t sizeTable_) {
+	PositionCacheEntry *pcesOld = pces;
+	const size_t sizeOld = sizeTable;
+	const unsigned int clockRecent = clockSampled;
+	pces = 0;
+	Allocate(sizeTable_);
+	const size_t mask = sizeTable - 1;
+	for (int pass=0; pass<2; pass++) {
+		for (size_t i=0; i<sizeOld; i++) {
+			if (!pcesOld[i].Empty() && ((pass == 1) || (pcesOld[i].GetClock() >= clockRecent))) {
+				for (size_t probe=0; probe<probes; probe++) {
+					PositionCacheEntry &pce = pces[(pcesOld[i].GetHash() + probe) & mask];
+					if (pce.Empty()) {
+						pce.TakeFrom(pcesOld[i]);
+						entries++;
+						break;
+					}
+				}
+			}
+		}
+	}
+	delete []pcesOld;
+}
+
+/// Called after each sizeTable measurements. Halves a grown table when less than a quarter
+/// of it was used since the last sample and starts counting recent evictions again.
+void PositionCache::Sample() {
+	size_t used = 0;
+	for (size_t i=0; i<sizeTable; i++) {
+		if (!pces[i].Empty() && (pces[i].GetClock() >= clockSampled))
+			used++;
+	}
+	if ((sizeTable / 2 >= size) && (used < sizeTable / 4)) {
+		Resize(sizeTable / 2);
+	}
+	evictionsRecent = 0;
+	clockSampled = clock;
+}
+
 void PositionCache::Clear() {
 	if (!allClear) {
-		for (size_t i=0; i<size; i++) {
+		for (size_t i=0; i<sizeTable; i++) {
 			pces[i].Clear();
 		}
 	}
 	clock = 1;
 	allClear = true;
+	evictionsRecent = 0;
+	clockSampled = clock;
+	entries = 0;
 }
 
 void PositionCache::SetSize(size_t size_) {
 	Clear();
-	delete []pces;
 	size = size_;
-	pces = new PositionCacheEntry[size];
+	Allocate(size);
+	hits = 0;
+	misses = 0;
+	evictions = 0;
+}
+
+int PositionCache::Statistic(int statistic) const {
+	switch (statistic) {
+	case SC_POSITIONCACHE_HITS:
+		return hits;
+	case SC_POSITIONCACHE_MISSES:
+		return misses;
+	case SC_POSITIONCACHE_EVICTIONS:
+		return evictions;
+	case SC_POSITIONCACHE_ENTRIES:
+		return static_cast<int>(entries);
+	default:
+		return 0;
+	}
 }
 
 void PositionCache::MeasureWidths(Surface *surface, ViewStyle &vstyle, unsigned int styleNumber,
 	const char *s, unsigned int len, int *positions) {
 	allClear = false;
-	int probe = -1;
-	if ((size > 0) && (len < 30)) {
-		// Only store short strings in the cache so it doesn't churn with
-		// long comments with only a single comment.
-
-		// Two way associative: try two probe positions.
-		int hashValue = PositionCacheEntry::Hash(styleNumber, s, len);
-		probe = hashValue % size;
-		if (pces[probe].Retrieve(styleNumber, s, len, positions)) {
-			return;
+	PositionCacheEntry *pceReplace = 0;
+	unsigned int hashValue = 0;
+	if ((sizeTable > 0) && (len <= lengthEntryMax)) {
+		// Runs longer than lengthEntryMax are rare as BreakFinder subdivides them
+		clock++;
+		if (clock > 0xf0000000u) {
+			// Wrap the clock round and reset all cache entries so none get stuck with a high clock.
+			for (size_t i=0; i<sizeTable; i++) {
+				pces[i].ResetClock();
+			}
+			clock = 2;
+			clockSampled = 1;
 		}
-		int probe2 = (hashValue * 37) % size;
-		if (pces[probe2].Retrieve(styleNumber, s, len, positions)) {
-			return;
+		if (clock - clockSampled >= sizeTable) {
+			Sample();
 		}
-		// Not found. Choose the oldest of the two slots to replace
-		if (pces[probe].NewerThan(pces[probe2])) {
-			probe = probe2;
+		hashValue = PositionCacheEntry::Hash(styleNumber, s, len);
+		const size_t mask = sizeTable - 1;
+		for (size_t probe=0; probe<probes; probe++) {
+			PositionCacheEntry &pce = pces[(hashValue + probe) & mask];
+			if (pce.Retrieve(styleNumber, s, len, positions, hashValue)) {
+				pce.SetClock(clock);
+				hits++;
+				return;
+			}
+			// Not found here. Remember the least recently used slot to replace
+			if (!pceReplace || pceReplace->NewerThan(pce)) {
+				pceReplace = &pce;
+			}
 		}
+		misses++;
 	}
 	surface->MeasureWidths(vstyle.styles[styleNumber].font, s, len, positions);
-	if (probe >= 0) {
-		clock++;
-		if (clock > 60000) {
-			// Since there are only 16 bits for the clock, wrap it round and
-			// reset all cache entries so none get stuck with a high clock.
-			for (size_t i=0; i<size; i++) {
-				pces[i].ResetClock();
+	if (pceReplace) {
+		bool grow = false;
+		if (pceReplace->Empty()) {
+			entries++;
+		} else {
+			evictions++;
+			if (pceReplace->GetClock() + sizeTable > clock) {
+				// Evicting an entry used within the last sizeTable measurements shows
+				// that the runs being displayed do not fit.
+				evictionsRecent++;
+				grow = (evictionsRecent > static_cast<int>(sizeTable / 4)) &&
+					(sizeTable < size * growthMax);
 			}
-			clock = 2;
 		}
-		pces[probe].Set(styleNumber, s, len, positions, clock);
+		pceReplace->Set(styleNumber, s, len, positions, hashValue, clock);
+		if (grow) {
+			Resize(sizeTable * 2);
+		}
 	}
 }
@@ -34,7 +34,7 @@ public:
 	enum validLevel { llInvalid, llCheckTextAndStyle, llPositions, llLines } validity;
 	int xHighlightGuide;
 	bool highlightColumn;
-	Selection *psel;
+	const Selection *psel;
 	bool containsCaret;
 	int edgeColumn;
 	char *chars;
@@ -77,7 +77,6 @@ class LineLayoutCache {
 	int size;
 	LineLayout **cache;
 	bool allInvalidated;
-	int styleClock;
 	int useCount;
 	void Allocate(int length_);
 	void AllocateForLevel(int linesOnScreen, int linesInDoc);
@@ -92,25 +91,34 @@ public:
 		llcDocument=SC_CACHE_DOCUMENT
 	};
 	void Invalidate(LineLayout::validLevel validity_);
+	void Invalidate(LineLayout::validLevel validity_, int lineFirst, int lineLast);
 	void SetLevel(int level_);
 	int GetLevel() const { return level; }
-	LineLayout *Retrieve(int lineNumber, int lineCaret, int maxChars, int styleClock_,
+	LineLayout *Retrieve(int lineNumber, int lineCaret, int maxChars,
 		int linesOnScreen, int linesInDoc);
 	void Dispose(LineLayout *ll);
 };
 
 class PositionCacheEntry {
 	unsigned int styleNumber:8;
-	unsigned int len:8;
-	unsigned int clock:16;
-	short *positions;
+	unsigned int len:24;
+	unsigned int hash;
+	unsigned int clock;
+	int *positions;	///< len positions followed by the len bytes of text
 public:
 	PositionCacheEntry();
 	~PositionCacheEntry();
-	void Set(unsigned int styleNumber_, const char *s_, unsigned int len_, int *positions_, unsigned int clock);
+	void Set(unsigned int styleNumber_, const char *s_, unsigned int len_, int *positions_,
+		unsigned int hash_, unsigned int clock_);
 	void Clear();
-	bool Retrieve(unsigned int styleNumber_, const char *s_, unsigned int len_, int *positions_) const;
-	static int Hash(unsigned int styleNumber, const char *s, unsigned int len);
+	void TakeFrom(PositionCacheEntry &other);
+	bool Retrieve(unsigned int styleNumber_, const char *s_, unsigned int len_, int *positions_,
+		unsigned int hash_) const;
+	static unsigned int Hash(unsigned int styleNumber, const char *s, unsigned int len);
+	bool Empty() const { return positions == 0; }
+	unsigned int GetHash() const { return hash; }
+	unsigned int GetClock() const { return clock; }
+	void SetClock(unsigned int clock_) { clock = clock_; }
 	bool NewerThan(const PositionCacheEntry &other) const;
 	void ResetClock();
 };
@@ -142,17 +150,36 @@ public:
 	int Next();
 };
 
+/**
+ * Open addressed cache of the widths of runs of text in a style.
+ * Each run may be stored in any of a few consecutive slots after its hash and the
+ * least recently used of those is replaced. The table starts at the requested size
+ * and grows when entries are being evicted soon after use, which happens when more
+ * distinct runs are visible than fit.
+ */
 class PositionCache {
 	PositionCacheEntry *pces;
 	size_t size;
+	size_t sizeTable;
 	unsigned int clock;
 	bool allClear;
+	int hits;
+	int misses;
+	int evictions;
+	int evictionsRecent;	///< Evictions of entries in use since clockSampled
+	unsigned int clockSampled;
+	size_t entries;
+	void Allocate(size_t sizeTable_);
+	void Resize(size_t sizeTable_);
+	void Sample();
 public:
+	enum { lengthEntryMax = 300, probes = 4, growthMax = 16 };
 	PositionCache();
 	~PositionCache();
 	void Clear();
 	void SetSize(size_t size_);
 	int GetSize() const { return size; }
+	int Statistic(int statistic) const;
 	void MeasureWidths(Surface *surface, ViewStyle &vstyle, unsigned int styleNumber,
 		const char *s, unsigned int len, int *positions);
 };
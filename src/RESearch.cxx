@@ -40,7 +40,7 @@
  *
  *  RESearch::Execute:      execute the NFA to match a pattern.
  *
- *          int RESearch::Execute(characterIndexer &ci, int lp, int endp)
+ *          int RESearch::Execute(characterIndexer &ci, Sci_Position lp, Sci_Position endp)
  *
  *  RESearch::Substitute:   substitute the matched portions in a new string.
  *
@@ -196,10 +196,26 @@
  *  pattern:    \(fo.*\)-\1
  *  compile:    BOT 1 CHR f CHR o CLO ANY END EOT 1 CHR - REF 1 END
  *  matches:    foo-foo fo-fo fob-fob foobar-foobar ...
+ *
+ *  Unless it contains a back reference (REF), the nfa is translated into an
+ *  REProgram which is run without backtracking. A lazily built DFA finds
+ *  whether a match ends in the range, then a Pike VM, which runs every thread
+ *  in lockstep in priority order, finds the same match and tags as PMatch.
+ *  Matching is linear in the length of the range.
+ *
+ *  Recently compiled patterns are kept with their nfa and REProgram, so
+ *  searching again for one of them reuses its DFA states as well.
  */
 
 #include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <algorithm>
+#include <map>
+#include <vector>
 
+#include "Sci_Position.h"
 #include "CharClassify.h"
 #include "RESearch.h"
 
@@ -240,6 +256,749 @@ const char bitarr[] = { 1, 2, 4, 8, 16, 32, 64, '\200' };
 
 #define badpat(x)	(*nfa = END, x)
 
+#ifdef SCI_NAMESPACE
+namespace Scintilla {
+#endif
+
+/**
+ * Reads text through the segments of a CharacterIndexer when it provides them
+ * and otherwise through CharAt.
+ */
+class SegmentReader {
+	CharacterIndexer &ci;
+	const char *segment;
+	Sci_Position segmentStart;
+	Sci_Position segmentEnd;
+	enum { bufferSize = 256 };
+	char buffer[bufferSize];
+public:
+	explicit SegmentReader(CharacterIndexer &ci_) : ci(ci_), segment(0), segmentStart(0), segmentEnd(0) {
+	}
+	/// Contiguous text from position which may be shorter than up to end.
+	const char *Span(Sci_Position position, Sci_Position end, Sci_Position &length) {
+		if ((position < segmentStart) || (position >= segmentEnd)) {
+			Sci_Position lengthSegment = 0;
+			segment = ci.SegmentPointer(position, lengthSegment);
+			if (!segment || (lengthSegment <= 0)) {
+				lengthSegment = end - position;
+				if (lengthSegment > bufferSize)
+					lengthSegment = bufferSize;
+				for (Sci_Position i = 0; i < lengthSegment; i++)
+					buffer[i] = ci.CharAt(position + i);
+				segment = buffer;
+			}
+			segmentStart = position;
+			segmentEnd = position + lengthSegment;
+		}
+		length = ((segmentEnd < end) ? segmentEnd : end) - position;
+		return segment + (position - segmentStart);
+	}
+	/// Contiguous text ending at position which may start after start.
+	const char *SpanBefore(Sci_Position position, Sci_Position start, Sci_Position &length) {
+		Sci_Position lengthSegment = 0;
+		const char *text = ci.SegmentPointer(start, lengthSegment);
+		if (text && (lengthSegment > 0)) {
+			if (start + lengthSegment < position) {
+				// The gap is between start and position so return the text after it
+				const Sci_Position afterGap = start + lengthSegment;
+				text = ci.SegmentPointer(afterGap, lengthSegment);
+				length = position - afterGap;
+			} else {
+				length = position - start;
+			}
+			return text;
+		}
+		const Sci_Position from = (position - start > bufferSize) ? (position - bufferSize) : start;
+		for (Sci_Position i = from; i < position; i++)
+			buffer[i - from] = ci.CharAt(i);
+		segmentEnd = segmentStart;	// Buffer no longer holds Span
+		length = position - from;
+		return buffer;
+	}
+	unsigned char ByteAt(Sci_Position position) {
+		Sci_Position length = 0;
+		return *Span(position, position + 1, length);
+	}
+};
+
+/**
+ * The nfa as a list of instructions where closures are flagged on the
+ * character sets they repeat.
+ */
+class REProgram {
+public:
+	REProgram();
+	void Translate(const char *nfa, CharClassify *charClass);
+	/// Back references are not regular so need PMatch.
+	bool Usable() const { return usable; }
+	bool Match(CharacterIndexer &ci, Sci_Position lp, Sci_Position endp,
+		Sci_Position *bopat, Sci_Position *eopat);
+	bool MatchLast(CharacterIndexer &ci, Sci_Position lp, Sci_Position endp,
+		Sci_Position *bopat, Sci_Position *eopat);
+private:
+	enum { opSet, opBol, opEol, opBow, opEow, opBot, opEot, opEnd };
+	struct Instruction {
+		int op;
+		int tag;
+		bool repeat;
+		unsigned char set[BITBLK];
+	};
+	// What the assertions need to know about a position
+	struct Context {
+		bool atBol;
+		bool atEol;
+		bool prevWord;
+		bool curWord;
+	};
+	// Threads in priority order each with the positions of its tags
+	struct ThreadList {
+		std::vector<int> pcs;
+		std::vector<Sci_Position> tags;
+	};
+	/**
+	 * A lazily built DFA running the program forwards or backwards. States are
+	 * the sorted pending instructions followed by whether the byte before the
+	 * position is a word byte and whether at bol or, backwards, whether the byte
+	 * after the position is a word byte and whether at eol.
+	 */
+	struct Automaton {
+		bool reverse;
+		bool skipping;	// Bytes that can not begin a match in this direction are skipped
+		bool skipByte[MAXCHR];
+		int firstByte;	// The only byte that can begin a match forwards or -1
+		std::map<std::vector<int>, int> stateIndex;
+		std::vector<std::vector<int> > stateKeys;
+		std::vector<int> transitions;
+		std::vector<char> emptyPending;
+		std::vector<int> endMatches;
+		int startState;
+		int emptyStates[2];
+		int clears;
+		explicit Automaton(bool reverse_);
+		void Clear();
+	};
+	enum { stateUnknown = -1, stateMatch = -2, maxStates = 1000 };
+
+	std::vector<Instruction> program;
+	bool usable;
+	bool anchored;
+	bool wordAssertions;
+	int tagsThread;	// Number of tag positions held for each thread
+	bool word[MAXCHR];
+	Automaton forward;
+	Automaton backward;
+
+	std::vector<int> mark;
+	int generation;
+	std::vector<int> stack;
+	std::vector<int> consuming;
+	ThreadList current;
+	ThreadList next;
+	std::vector<Sci_Position> found;
+
+	static bool InSet(const unsigned char *set, int c) {
+		return (set[(c & BLKIND) >> 3] & bitarr[c & BITIND]) != 0;
+	}
+	static bool Passes(const Instruction &ins, const Context &context);
+	void FindSkipping(Automaton &dfa);
+	int Intern(Automaton &dfa, const std::vector<int> &key);
+	int StartState(Automaton &dfa);
+	int EmptyState(Automaton &dfa, bool wordByte);
+	bool Closure(Automaton &dfa, int state, int c, bool addStart);
+	int Transition(Automaton &dfa, int state, unsigned char ch);
+	bool EndMatches(Automaton &dfa, int state);
+	bool Scan(SegmentReader &reader, Sci_Position lp, Sci_Position endp, Sci_Position &from);
+	Sci_Position ScanBackward(SegmentReader &reader, Sci_Position lp, Sci_Position endp);
+	Context ContextAt(SegmentReader &reader, Sci_Position bol, Sci_Position endp, Sci_Position pos) const;
+	void AddThread(ThreadList &list, int pc, const Context &context, Sci_Position pos, const Sci_Position *tags);
+	bool Pike(SegmentReader &reader, Sci_Position bol, Sci_Position from, Sci_Position endp, bool once);
+	void SetTags(Sci_Position *bopat, Sci_Position *eopat) const;
+};
+
+REProgram::Automaton::Automaton(bool reverse_) : reverse(reverse_), skipping(false), firstByte(-1),
+	startState(-1), clears(0) {
+	for (int c = 0; c < MAXCHR; c++)
+		skipByte[c] = false;
+	emptyStates[0] = -1;
+	emptyStates[1] = -1;
+}
+
+void REProgram::Automaton::Clear() {
+	stateIndex.clear();
+	stateKeys.clear();
+	transitions.clear();
+	emptyPending.clear();
+	endMatches.clear();
+	startState = -1;
+	emptyStates[0] = -1;
+	emptyStates[1] = -1;
+	clears++;
+}
+
+REProgram::REProgram() : usable(false), anchored(false), wordAssertions(false), tagsThread(2),
+	forward(false), backward(true), generation(0) {
+	for (int c = 0; c < MAXCHR; c++)
+		word[c] = false;
+}
+
+void REProgram::Translate(const char *nfa, CharClassify *charClass) {
+	program.clear();
+	usable = true;
+	anchored = *nfa == BOL;
+	wordAssertions = false;
+	tagsThread = 2;
+	for (int c = 0; c < MAXCHR; c++)
+		word[c] = charClass->IsWord(static_cast<unsigned char>(c));
+	const char *ap = nfa;
+	while (*ap != END) {
+		Instruction ins;
+		ins.op = opSet;
+		ins.tag = 0;
+		ins.repeat = *ap == CLO;
+		if (ins.repeat)
+			ap++;
+		const int op = *ap++;
+		switch (op) {
+		case CHR:
+			memset(ins.set, 0, sizeof(ins.set));
+			ins.set[(*ap & BLKIND) >> 3] |= bitarr[*ap & BITIND];
+			ap++;
+			break;
+		case ANY:
+			memset(ins.set, 0xff, sizeof(ins.set));
+			break;
+		case CCL:
+			memcpy(ins.set, ap, sizeof(ins.set));
+			ap += BITBLK;
+			break;
+		case BOL:
+			ins.op = opBol;
+			break;
+		case EOL:
+			ins.op = opEol;
+			break;
+		case BOW:
+		case EOW:
+			ins.op = (op == BOW) ? opBow : opEow;
+			wordAssertions = true;
+			break;
+		case BOT:
+		case EOT:
+			ins.op = (op == BOT) ? opBot : opEot;
+			ins.tag = *ap++;
+			if (tagsThread < (ins.tag + 1) * 2)
+				tagsThread = (ins.tag + 1) * 2;
+			break;
+		default:
+			usable = false;
+			return;
+		}
+		if (ins.repeat)
+			ap++;	// Closure's END
+		program.push_back(ins);
+	}
+	Instruction insEnd;
+	insEnd.op = opEnd;
+	insEnd.tag = 0;
+	insEnd.repeat = false;
+	program.push_back(insEnd);
+	mark.assign(program.size(), 0);
+	generation = 0;
+	forward.Clear();
+	backward.Clear();
+	FindSkipping(forward);
+	FindSkipping(backward);
+	if (anchored)
+		forward.skipping = false;
+}
+
+/**
+ * Find the bytes that can begin a match in the direction of an automaton so
+ * others are skipped, with memchr when there is only one.
+ */
+void REProgram::FindSkipping(Automaton &dfa) {
+	dfa.skipping = false;
+	dfa.firstByte = -1;
+	unsigned char starts[BITBLK] = {0};
+	const int last = static_cast<int>(program.size()) - 1;
+	bool required = false;
+	for (int n = 0; (n < last) && !required; n++) {
+		const Instruction &ins = program[dfa.reverse ? (last - 1 - n) : n];
+		if (ins.op == opSet) {
+			for (int b = 0; b < BITBLK; b++)
+				starts[b] |= ins.set[b];
+			required = !ins.repeat;
+		}
+	}
+	if (!required)
+		return;	// Matches empty text
+	dfa.skipping = true;
+	int startBytes = 0;
+	for (int c = 0; c < MAXCHR; c++) {
+		dfa.skipByte[c] = !InSet(starts, c);
+		if (!dfa.skipByte[c]) {
+			startBytes++;
+			dfa.firstByte = c;
+		}
+	}
+	if ((startBytes != 1) || dfa.reverse)
+		dfa.firstByte = -1;
+}
+
+bool REProgram::Passes(const Instruction &ins, const Context &context) {
+	switch (ins.op) {
+	case opBol:
+		return context.atBol;
+	case opEol:
+		return context.atEol;
+	case opBow:
+		return (context.atBol || !context.prevWord) && context.curWord;
+	case opEow:
+		return !context.atBol && context.prevWord && !context.curWord;
+	}
+	return true;
+}
+
+int REProgram::Intern(Automaton &dfa, const std::vector<int> &key) {
+	std::map<std::vector<int>, int>::const_iterator it = dfa.stateIndex.find(key);
+	if (it != dfa.stateIndex.end())
+		return it->second;
+	if (dfa.stateKeys.size() >= maxStates)
+		dfa.Clear();
+	const int state = static_cast<int>(dfa.stateKeys.size());
+	dfa.stateIndex[key] = state;
+	dfa.stateKeys.push_back(key);
+	dfa.transitions.insert(dfa.transitions.end(), MAXCHR, stateUnknown);
+	dfa.emptyPending.push_back(key.size() == 2);
+	dfa.endMatches.push_back(-1);
+	return state;
+}
+
+int REProgram::StartState(Automaton &dfa) {
+	if (dfa.startState < 0) {
+		// Backwards, the byte after the end is read as 0 like CharAt does
+		std::vector<int> key(2, 1);
+		key[0] = (dfa.reverse && wordAssertions && word[0]) ? 1 : 0;
+		dfa.startState = Intern(dfa, key);
+	}
+	return dfa.startState;
+}
+
+int REProgram::EmptyState(Automaton &dfa, bool wordByte) {
+	const int w = (wordAssertions && wordByte) ? 1 : 0;
+	if (dfa.emptyStates[w] < 0) {
+		std::vector<int> key(2, 0);
+		key[0] = w;
+		const int state = Intern(dfa, key);
+		dfa.emptyStates[w] = state;
+	}
+	return dfa.emptyStates[w];
+}
+
+/**
+ * Follow the pending instructions of a state and, when addStart, a new thread
+ * through everything that does not consume a byte before byte c or at the end
+ * of the scan when c < 0, collecting the instructions reached after consuming c.
+ * @return true when the end of the program in the direction of the scan is reached.
+ */
+bool REProgram::Closure(Automaton &dfa, int state, int c, bool addStart) {
+	const std::vector<int> &key = dfa.stateKeys[state];
+	const size_t pending = key.size() - 2;
+	Context context;
+	if (dfa.reverse) {
+		context.atBol = c < 0;
+		context.atEol = key[pending + 1] != 0;
+		context.prevWord = (c >= 0) && word[c];
+		context.curWord = key[pending] != 0;
+	} else {
+		context.atBol = key[pending + 1] != 0;
+		context.atEol = c < 0;
+		context.prevWord = key[pending] != 0;
+		context.curWord = word[(c < 0) ? 0 : c];
+	}
+	const int step = dfa.reverse ? -1 : 1;
+	const int last = static_cast<int>(program.size()) - 1;
+	const int pcStart = dfa.reverse ? (last - 1) : 0;
+	const int pcMatch = dfa.reverse ? -1 : last;
+	generation++;
+	stack.assign(key.begin(), key.begin() + pending);
+	if (addStart)
+		stack.push_back(pcStart);
+	consuming.clear();
+	bool matched = false;
+	while (!stack.empty()) {
+		const int pc = stack.back();
+		stack.pop_back();
+		if (pc == pcMatch) {
+			matched = true;
+			continue;
+		}
+		if (mark[pc] == generation)
+			continue;
+		mark[pc] = generation;
+		const Instruction &ins = program[pc];
+		if (ins.op == opSet) {
+			if ((c >= 0) && InSet(ins.set, c))
+				consuming.push_back(ins.repeat ? pc : pc + step);
+			if (ins.repeat)
+				stack.push_back(pc + step);
+		} else if (Passes(ins, context)) {
+			stack.push_back(pc + step);
+		}
+	}
+	return matched;
+}
+
+int REProgram::Transition(Automaton &dfa, int state, unsigned char ch) {
+	// Backwards, a match found at the end of the range is not used since
+	// matches start before the end
+	const bool atEdge = dfa.stateKeys[state].back() != 0;
+	if (Closure(dfa, state, ch, true) && !(dfa.reverse && atEdge)) {
+		dfa.transitions[state * MAXCHR + ch] = stateMatch;
+		return stateMatch;
+	}
+	std::sort(consuming.begin(), consuming.end());
+	consuming.erase(std::unique(consuming.begin(), consuming.end()), consuming.end());
+	consuming.push_back((wordAssertions && word[ch]) ? 1 : 0);
+	consuming.push_back(0);
+	const int clearsBefore = dfa.clears;
+	const int target = Intern(dfa, consuming);
+	if (dfa.clears == clearsBefore)
+		dfa.transitions[state * MAXCHR + ch] = target;
+	return target;
+}
+
+// Only an anchored match may start at the end of the range
+bool REProgram::EndMatches(Automaton &dfa, int state) {
+	if (dfa.endMatches[state] < 0) {
+		const bool atEdge = dfa.stateKeys[state].back() != 0;
+		const bool matched = dfa.reverse ?
+			(Closure(dfa, state, -1, true) && !atEdge) : Closure(dfa, state, -1, anchored);
+		dfa.endMatches[state] = matched ? 1 : 0;
+	}
+	return dfa.endMatches[state] != 0;
+}
+
+/**
+ * Run the DFA over the range to find whether any match ends in it. Also finds
+ * the last position before that end where no match was in progress, since the
+ * first match can not start before it.
+ */
+bool REProgram::Scan(SegmentReader &reader, Sci_Position lp, Sci_Position endp, Sci_Position &from) {
+	Automaton &dfa = forward;
+	int state = StartState(dfa);
+	from = lp;
+	Sci_Position pos = lp;
+	while (pos < endp) {
+		Sci_Position length = 0;
+		const char *text = reader.Span(pos, endp, length);
+		Sci_Position i = 0;
+		while (i < length) {
+			if (dfa.emptyPending[state]) {
+				if (anchored && (pos + i > lp))
+					return false;
+				if (dfa.skipping) {
+					Sci_Position skip = 0;
+					if (dfa.firstByte >= 0) {
+						const char *candidate = static_cast<const char *>(
+							memchr(text + i, dfa.firstByte, length - i));
+						skip = candidate ? (candidate - (text + i)) : (length - i);
+					} else {
+						while ((i + skip < length) && dfa.skipByte[static_cast<unsigned char>(text[i + skip])])
+							skip++;
+					}
+					if (skip > 0) {
+						i += skip;
+						state = EmptyState(dfa, word[static_cast<unsigned char>(text[i - 1])]);
+						if (i >= length)
+							break;
+					}
+				}
+				from = pos + i;
+			}
+			const unsigned char ch = text[i];
+			int stateNext = dfa.transitions[state * MAXCHR + ch];
+			if (stateNext == stateUnknown)
+				stateNext = Transition(dfa, state, ch);
+			if (stateNext == stateMatch)
+				return true;
+			state = stateNext;
+			i++;
+		}
+		pos += length;
+	}
+	return EndMatches(dfa, state);
+}
+
+/**
+ * Run the DFA for the reversed program from the end of the range back to its
+ * start to find the last position at which a match starts.
+ * @return the position or -1.
+ */
+Sci_Position REProgram::ScanBackward(SegmentReader &reader, Sci_Position lp, Sci_Position endp) {
+	Automaton &dfa = backward;
+	int state = StartState(dfa);
+	Sci_Position pos = endp;
+	while (pos > lp) {
+		Sci_Position length = 0;
+		const char *text = reader.SpanBefore(pos, lp, length);
+		// The position being examined is between text[i-1] and text[i]
+		Sci_Position i = length;
+		while (i > 0) {
+			if (dfa.skipping && dfa.emptyPending[state]) {
+				Sci_Position skip = 0;
+				while ((skip < i) && dfa.skipByte[static_cast<unsigned char>(text[i - 1 - skip])])
+					skip++;
+				if (skip > 0) {
+					i -= skip;
+					state = EmptyState(dfa, word[static_cast<unsigned char>(text[i])]);
+					if (i <= 0)
+						break;
+				}
+			}
+			const unsigned char ch = text[i - 1];
+			int stateNext = dfa.transitions[state * MAXCHR + ch];
+			if (stateNext == stateUnknown)
+				stateNext = Transition(dfa, state, ch);
+			if (stateNext == stateMatch)
+				return pos - length + i;
+			state = stateNext;
+			i--;
+		}
+		pos -= length;
+	}
+	return EndMatches(dfa, state) ? lp : -1;
+}
+
+REProgram::Context REProgram::ContextAt(SegmentReader &reader, Sci_Position bol, Sci_Position endp,
+	Sci_Position pos) const {
+	Context context;
+	context.atBol = pos == bol;
+	context.atEol = pos >= endp;
+	context.prevWord = (pos > bol) && word[reader.ByteAt(pos - 1)];
+	context.curWord = word[(pos < endp) ? reader.ByteAt(pos) : 0];
+	return context;
+}
+
+void REProgram::AddThread(ThreadList &list, int pc, const Context &context, Sci_Position pos,
+	const Sci_Position *tags) {
+	if (mark[pc] == generation)
+		return;
+	mark[pc] = generation;
+	const Instruction &ins = program[pc];
+	switch (ins.op) {
+	case opSet:
+	case opEnd:
+		list.pcs.push_back(pc);
+		list.tags.insert(list.tags.end(), tags, tags + tagsThread);
+		// A closure prefers to match more before trying the rest of the program
+		if (ins.repeat)
+			AddThread(list, pc + 1, context, pos, tags);
+		break;
+	case opBot:
+	case opEot: {
+			Sci_Position tagsChanged[RESearch::MAXTAG * 2];
+			memcpy(tagsChanged, tags, tagsThread * sizeof(Sci_Position));
+			tagsChanged[ins.tag * 2 + ((ins.op == opEot) ? 1 : 0)] = pos;
+			AddThread(list, pc + 1, context, pos, tagsChanged);
+		}
+		break;
+	default:
+		if (Passes(ins, context))
+			AddThread(list, pc + 1, context, pos, tags);
+	}
+}
+
+/**
+ * Run all threads in lockstep from each start position, or only from the
+ * first when once is set, keeping the highest priority thread for each
+ * instruction, so the first match found is the one that backtracking would find.
+ */
+bool REProgram::Pike(SegmentReader &reader, Sci_Position bol, Sci_Position from, Sci_Position endp,
+	bool once) {
+	bool matched = false;
+	Sci_Position tagsStart[RESearch::MAXTAG * 2];
+	for (int n = 0; n < tagsThread; n++)
+		tagsStart[n] = RESearch::NOTFOUND;
+	current.pcs.clear();
+	current.tags.clear();
+	Sci_Position pos = from;
+	generation++;
+	if ((pos < endp) || once) {
+		tagsStart[0] = pos;
+		AddThread(current, 0, ContextAt(reader, bol, endp, pos), pos, tagsStart);
+	}
+	for (;;) {
+		const int ch = (pos < endp) ? reader.ByteAt(pos) : -1;
+		next.pcs.clear();
+		next.tags.clear();
+		generation++;
+		Context contextNext = {false, false, false, false};
+		if (ch >= 0)
+			contextNext = ContextAt(reader, bol, endp, pos + 1);
+		for (size_t t = 0; t < current.pcs.size(); t++) {
+			const int pc = current.pcs[t];
+			const Instruction &ins = program[pc];
+			if (ins.op == opEnd) {
+				// Lower priority threads are cut off
+				matched = true;
+				found.assign(current.tags.begin() + t * tagsThread, current.tags.begin() + (t + 1) * tagsThread);
+				found[1] = pos;
+				break;
+			}
+			if ((ch >= 0) && InSet(ins.set, ch))
+				AddThread(next, ins.repeat ? pc : pc + 1, contextNext, pos + 1, &current.tags[t * tagsThread]);
+		}
+		if (pos >= endp)
+			break;
+		pos++;
+		if (!matched && !once && (pos < endp)) {
+			tagsStart[0] = pos;
+			AddThread(next, 0, contextNext, pos, tagsStart);
+		}
+		current.pcs.swap(next.pcs);
+		current.tags.swap(next.tags);
+		if (current.pcs.empty() && (matched || once))
+			break;
+	}
+	return matched;
+}
+
+void REProgram::SetTags(Sci_Position *bopat, Sci_Position *eopat) const {
+	for (int n = 0; n * 2 < tagsThread; n++) {
+		bopat[n] = found[n * 2];
+		eopat[n] = found[n * 2 + 1];
+	}
+}
+
+bool REProgram::Match(CharacterIndexer &ci, Sci_Position lp, Sci_Position endp,
+	Sci_Position *bopat, Sci_Position *eopat) {
+	SegmentReader reader(ci);
+	Sci_Position from = lp;
+	if (!Scan(reader, lp, endp, from))
+		return false;
+	if (!Pike(reader, lp, from, endp, anchored))
+		return false;
+	SetTags(bopat, eopat);
+	return true;
+}
+
+/**
+ * Find the match which starts last in the range, with the reversed program
+ * finding where it starts, then the Pike VM finding where it ends.
+ */
+bool REProgram::MatchLast(CharacterIndexer &ci, Sci_Position lp, Sci_Position endp,
+	Sci_Position *bopat, Sci_Position *eopat) {
+	if (anchored)
+		return Match(ci, lp, endp, bopat, eopat);
+	SegmentReader reader(ci);
+	const Sci_Position start = ScanBackward(reader, lp, endp);
+	if (start < 0)
+		return false;
+	if (!Pike(reader, lp, start, endp, true))
+		return false;
+	SetTags(bopat, eopat);
+	return true;
+}
+
+/**
+ * Recently compiled patterns, most recently used first, so searching again
+ * for one of them does not compile it again.
+ */
+class RECache {
+	struct Entry {
+		std::string pattern;
+		bool caseSensitive;
+		bool posix;
+		std::string nfa;
+		REProgram program;
+	};
+	enum { maxEntries = 8 };
+	std::vector<Entry *> entries;
+	bool word[MAXCHR];	// Word bytes when the entries were compiled
+	// Private so RECache objects can not be copied
+	RECache(const RECache &);
+	RECache &operator=(const RECache &);
+public:
+	RECache();
+	~RECache();
+	void CheckWords(CharClassify *charClass);
+	REProgram *Find(const char *pattern, int length, bool caseSensitive, bool posix, char *nfa);
+	REProgram *Add(const char *pattern, int length, bool caseSensitive, bool posix,
+		const char *nfa, size_t lengthNFA);
+};
+
+RECache::RECache() {
+	for (int c = 0; c < MAXCHR; c++)
+		word[c] = false;
+}
+
+RECache::~RECache() {
+	for (size_t i = 0; i < entries.size(); i++)
+		delete entries[i];
+}
+
+/// \w and word assertions depend on the word bytes so forget everything when they change.
+void RECache::CheckWords(CharClassify *charClass) {
+	bool changed = false;
+	for (int c = 0; c < MAXCHR; c++) {
+		const bool isWord = charClass->IsWord(static_cast<unsigned char>(c));
+		if (word[c] != isWord) {
+			word[c] = isWord;
+			changed = true;
+		}
+	}
+	if (changed) {
+		for (size_t i = 0; i < entries.size(); i++)
+			delete entries[i];
+		entries.clear();
+	}
+}
+
+/**
+ * Look for a pattern and when found copy its nfa and move it to the front.
+ * @return its program or NULL.
+ */
+REProgram *RECache::Find(const char *pattern, int length, bool caseSensitive, bool posix, char *nfa) {
+	for (size_t i = 0; i < entries.size(); i++) {
+		Entry *entry = entries[i];
+		if ((entry->caseSensitive == caseSensitive) && (entry->posix == posix) &&
+			(entry->pattern.length() == static_cast<size_t>(length)) &&
+			(memcmp(entry->pattern.c_str(), pattern, length) == 0)) {
+			memcpy(nfa, entry->nfa.c_str(), entry->nfa.length());
+			std::rotate(entries.begin(), entries.begin() + i, entries.begin() + i + 1);
+			return &entry->program;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Add a compiled pattern at the front, reusing the least recently used entry
+ * when full.
+ * @return the program for the caller to translate the nfa into.
+ */
+REProgram *RECache::Add(const char *pattern, int length, bool caseSensitive, bool posix,
+	const char *nfa, size_t lengthNFA) {
+	Entry *entry = 0;
+	if (entries.size() < maxEntries) {
+		entry = new Entry();
+		entries.push_back(entry);
+	} else {
+		entry = entries.back();
+	}
+	std::rotate(entries.begin(), entries.end() - 1, entries.end());
+	entry->pattern.assign(pattern, length);
+	entry->caseSensitive = caseSensitive;
+	entry->posix = posix;
+	entry->nfa.assign(nfa, lengthNFA);
+	return &entry->program;
+}
+
+#ifdef SCI_NAMESPACE
+}
+#endif
+
 /*
  * Character classification table for word boundary operators BOW
  * and EOW is passed in by the creator of this object (Scintilla
@@ -250,11 +1009,16 @@ const char bitarr[] = { 1, 2, 4, 8, 16, 32, 64, '\200' };
 RESearch::RESearch(CharClassify *charClassTable) {
 	failure = 0;
 	charClass = charClassTable;
+	cache = new RECache();
+	program = 0;
+	cacheHits = 0;
+	cacheMisses = 0;
 	Init();
 }
 
 RESearch::~RESearch() {
 	Clear();
+	delete cache;
 }
 
 void RESearch::Init() {
@@ -279,10 +1043,10 @@ bool RESearch::GrabMatches(CharacterIndexer &ci) {
 	bool success = true;
 	for (unsigned int i = 0; i < MAXTAG; i++) {
 		if ((bopat[i] != NOTFOUND) && (eopat[i] != NOTFOUND)) {
-			unsigned int len = eopat[i] - bopat[i];
+			Sci_Position len = eopat[i] - bopat[i];
 			pat[i] = new char[len + 1];
 			if (pat[i]) {
-				for (unsigned int j = 0; j < len; j++)
+				for (Sci_Position j = 0; j < len; j++)
 					pat[i][j] = ci.CharAt(bopat[i] + j);
 				pat[i][len] = '\0';
 			} else {
@@ -459,7 +1223,18 @@ const char *RESearch::Compile(const char *pattern, int length, bool caseSensitiv
 		else
 			return badpat("No previous regular expression");
 	}
+
+	cache->CheckWords(charClass);
+	REProgram *programCached = cache->Find(pattern, length, caseSensitive, posix, nfa);
+	if (programCached) {
+		cacheHits++;
+		program = programCached;
+		sta = OKP;
+		return 0;
+	}
+	cacheMisses++;
 	sta = NOP;
+	*nfa = END;	// No previous opcode for the checks on *sp to see
 
 	const char *p=pattern;     /* pattern pointer   */
 	for (int i=0; i<length; i++, p++) {
@@ -726,6 +1501,8 @@ const char *RESearch::Compile(const char *pattern, int length, bool caseSensitiv
 		return badpat((posix ? "Unmatched (" : "Unmatched \\("));
 	*mp = END;
 	sta = OKP;
+	program = cache->Add(pattern, length, caseSensitive, posix, nfa, mp - nfa + 1);
+	program->Translate(nfa, charClass);
 	return 0;
 }
 
@@ -750,9 +1527,9 @@ const char *RESearch::Compile(const char *pattern, int length, bool caseSensitiv
  *  respectively.
  *
  */
-int RESearch::Execute(CharacterIndexer &ci, int lp, int endp) {
+int RESearch::Execute(CharacterIndexer &ci, Sci_Position lp, Sci_Position endp) {
 	unsigned char c;
-	int ep = NOTFOUND;
+	Sci_Position ep = NOTFOUND;
 	char *ap = nfa;
 
 	bol = lp;
@@ -760,6 +1537,9 @@ int RESearch::Execute(CharacterIndexer &ci, int lp, int endp) {
 
 	Clear();
 
+	if ((*ap != END) && (*ap != EOL) && program && program->Usable())
+		return program->Match(ci, lp, endp, bopat, eopat) ? 1 : 0;
+
 	switch (*ap) {
 
 	case BOL:			/* anchored: match from BOL only */
@@ -798,6 +1578,38 @@ int RESearch::Execute(CharacterIndexer &ci, int lp, int endp) {
 	return 1;
 }
 
+/*
+ * ExecuteLast:
+ *	find the match which starts last between lp and endp, using
+ *	the reversed automaton rather than trying each match in turn.
+ *	The beginning of line stays at lp so "^" and "\<" are only
+ *	matched where they would be when searching forwards.
+ */
+int RESearch::ExecuteLast(CharacterIndexer &ci, Sci_Position lp, Sci_Position endp) {
+	char *ap = nfa;
+
+	bol = lp;
+	failure = 0;
+
+	Clear();
+
+	if ((*ap == END) || (*ap == BOL) || (*ap == EOL))
+		return Execute(ci, lp, endp);
+
+	if (program && program->Usable())
+		return program->MatchLast(ci, lp, endp, bopat, eopat) ? 1 : 0;
+
+	for (Sci_Position start = endp - 1; start >= lp; start--) {
+		const Sci_Position ep = PMatch(ci, start, endp, ap);
+		if (ep != NOTFOUND) {
+			bopat[0] = start;
+			eopat[0] = ep;
+			return 1;
+		}
+	}
+	return 0;
+}
+
 /*
  * PMatch: internal routine for the hard part
  *
@@ -839,12 +1651,12 @@ extern void re_fail(char *,char);
 #define CHRSKIP 3	/* [CLO] CHR chr END      */
 #define CCLSKIP 34	/* [CLO] CCL 32 bytes END */
 
-int RESearch::PMatch(CharacterIndexer &ci, int lp, int endp, char *ap) {
+Sci_Position RESearch::PMatch(CharacterIndexer &ci, Sci_Position lp, Sci_Position endp, char *ap) {
 	int op, c, n;
-	int e;		/* extra pointer for CLO  */
-	int bp;		/* beginning of subpat... */
-	int ep;		/* ending of subpat...    */
-	int are;	/* to save the line ptr.  */
+	Sci_Position e;		/* extra pointer for CLO  */
+	Sci_Position bp;	/* beginning of subpat... */
+	Sci_Position ep;	/* ending of subpat...    */
+	Sci_Position are;	/* to save the line ptr.  */
 
 	while ((op = *ap++) != END)
 		switch (op) {
@@ -949,8 +1761,8 @@ int RESearch::PMatch(CharacterIndexer &ci, int lp, int endp, char *ap) {
 int RESearch::Substitute(CharacterIndexer &ci, char *src, char *dst) {
 	unsigned char c;
 	int  pin;
-	int bp;
-	int ep;
+	Sci_Position bp;
+	Sci_Position ep;
 
 	if (!*src || !bopat[0])
 		return 0;
@@ -23,11 +23,19 @@ namespace Scintilla {
 
 class CharacterIndexer {
 public:
-	virtual char CharAt(int index)=0;
+	virtual char CharAt(Sci_Position index)=0;
+	/// Contiguous text from index and its length or NULL to read with CharAt.
+	virtual const char *SegmentPointer(Sci_Position, Sci_Position &lengthSegment) {
+		lengthSegment = 0;
+		return 0;
+	}
 	virtual ~CharacterIndexer() {
 	}
 };
 
+class REProgram;
+class RECache;
+
 class RESearch {
 
 public:
@@ -35,33 +43,46 @@ public:
 	~RESearch();
 	bool GrabMatches(CharacterIndexer &ci);
 	const char *Compile(const char *pattern, int length, bool caseSensitive, bool posix);
-	int Execute(CharacterIndexer &ci, int lp, int endp);
+	int Execute(CharacterIndexer &ci, Sci_Position lp, Sci_Position endp);
+	int ExecuteLast(CharacterIndexer &ci, Sci_Position lp, Sci_Position endp);
 	int Substitute(CharacterIndexer &ci, char *src, char *dst);
+	/// Number of compiles which found the pattern in the cache of compiled patterns.
+	int CacheHits() const { return cacheHits; }
+	/// Number of compiles which had to compile the pattern.
+	int CacheMisses() const { return cacheMisses; }
 
 	enum { MAXTAG=10 };
 	enum { MAXNFA=2048 };
 	enum { NOTFOUND=-1 };
 
-	int bopat[MAXTAG];
-	int eopat[MAXTAG];
+	Sci_Position bopat[MAXTAG];
+	Sci_Position eopat[MAXTAG];
 	char *pat[MAXTAG];
 
 private:
+	// Private so RESearch objects can not be copied
+	RESearch(const RESearch &);
+	RESearch &operator=(const RESearch &);
+
 	void Init();
 	void Clear();
 	void ChSet(unsigned char c);
 	void ChSetWithCase(unsigned char c, bool caseSensitive);
 	int GetBackslashExpression(const char *pattern, int &incr);
 
-	int PMatch(CharacterIndexer &ci, int lp, int endp, char *ap);
+	Sci_Position PMatch(CharacterIndexer &ci, Sci_Position lp, Sci_Position endp, char *ap);
 
-	int bol;
+	Sci_Position bol;
 	int tagstk[MAXTAG];  /* subpat tag stack */
 	char nfa[MAXNFA];    /* automaton */
 	int sta;
 	unsigned char bittab[BITBLK]; /* bit table for CCL pre-set bits */
 	int failure;
 	CharClassify *charClass;
+	RECache *cache;
+	REProgram *program;
+	int cacheHits;
+	int cacheMisses;
 	bool iswordc(unsigned char x) {
 		return charClass->IsWord(x);
 	}
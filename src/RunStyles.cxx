@@ -11,6 +11,7 @@
 
 #include "Platform.h"
 
+#include "Sci_Position.h"
 #include "Scintilla.h"
 #include "SplitVector.h"
 #include "Partitioning.h"
@@ -21,8 +22,8 @@ using namespace Scintilla;
 #endif
 
 // Find the first run at a position
-int RunStyles::RunFromPosition(int position) {
-	int run = starts->PartitionFromPosition(position);
+Sci_Position RunStyles::RunFromPosition(Sci_Position position) {
+	Sci_Position run = starts->PartitionFromPosition(position);
 	// Go to first element with this position
 	while ((run > 0) && (position == starts->PositionFromPartition(run-1))) {
 		run--;
@@ -31,9 +32,9 @@ int RunStyles::RunFromPosition(int position) {
 }
 
 // If there is no run boundary at position, insert one continuing style.
-int RunStyles::SplitRun(int position) {
-	int run = RunFromPosition(position);
-	int posRun = starts->PositionFromPartition(run);
+Sci_Position RunStyles::SplitRun(Sci_Position position) {
+	Sci_Position run = RunFromPosition(position);
+	Sci_Position posRun = starts->PositionFromPartition(run);
 	if (posRun < position) {
 		int runStyle = ValueAt(position);
 		run++;
@@ -43,12 +44,12 @@ int RunStyles::SplitRun(int position) {
 	return run;
 }
 
-void RunStyles::RemoveRun(int run) {
+void RunStyles::RemoveRun(Sci_Position run) {
 	starts->RemovePartition(run);
 	styles->DeleteRange(run, 1);
 }
 
-void RunStyles::RemoveRunIfEmpty(int run) {
+void RunStyles::RemoveRunIfEmpty(Sci_Position run) {
 	if ((run < starts->Partitions()) && (starts->Partitions() > 1)) {
 		if (starts->PositionFromPartition(run) == starts->PositionFromPartition(run+1)) {
 			RemoveRun(run);
@@ -56,7 +57,7 @@ void RunStyles::RemoveRunIfEmpty(int run) {
 	}
 }
 
-void RunStyles::RemoveRunIfSameAsPrevious(int run) {
+void RunStyles::RemoveRunIfSameAsPrevious(Sci_Position run) {
 	if ((run > 0) && (run < starts->Partitions())) {
 		if (styles->ValueAt(run-1) == styles->ValueAt(run)) {
 			RemoveRun(run);
@@ -77,21 +78,21 @@ RunStyles::~RunStyles() {
 	styles = NULL;
 }
 
-int RunStyles::Length() const {
+Sci_Position RunStyles::Length() const {
 	return starts->PositionFromPartition(starts->Partitions());
 }
 
-int RunStyles::ValueAt(int position) const {
+int RunStyles::ValueAt(Sci_Position position) const {
 	return styles->ValueAt(starts->PartitionFromPosition(position));
 }
 
-int RunStyles::FindNextChange(int position, int end) {
-	int run = starts->PartitionFromPosition(position);
+Sci_Position RunStyles::FindNextChange(Sci_Position position, Sci_Position end) {
+	Sci_Position run = starts->PartitionFromPosition(position);
 	if (run < starts->Partitions()) {
-		int runChange = starts->PositionFromPartition(run);
+		Sci_Position runChange = starts->PositionFromPartition(run);
 		if (runChange > position)
 			return runChange;
-		int nextChange = starts->PositionFromPartition(run + 1);
+		Sci_Position nextChange = starts->PositionFromPartition(run + 1);
 		if (nextChange > position) {
 			return nextChange;
 		} else if (position < end) {
@@ -104,17 +105,17 @@ int RunStyles::FindNextChange(int position, int end) {
 	}
 }
 
-int RunStyles::StartRun(int position) {
+Sci_Position RunStyles::StartRun(Sci_Position position) {
 	return starts->PositionFromPartition(starts->PartitionFromPosition(position));
 }
 
-int RunStyles::EndRun(int position) {
+Sci_Position RunStyles::EndRun(Sci_Position position) {
 	return starts->PositionFromPartition(starts->PartitionFromPosition(position) + 1);
 }
 
-bool RunStyles::FillRange(int &position, int value, int &fillLength) {
-	int end = position + fillLength;
-	int runEnd = RunFromPosition(end);
+bool RunStyles::FillRange(Sci_Position &position, int value, Sci_Position &fillLength) {
+	Sci_Position end = position + fillLength;
+	Sci_Position runEnd = RunFromPosition(end);
 	if (styles->ValueAt(runEnd) == value) {
 		// End already has value so trim range.
 		end = starts->PositionFromPartition(runEnd);
@@ -126,7 +127,7 @@ bool RunStyles::FillRange(int &position, int value, int &fillLength) {
 	} else {
 		runEnd = SplitRun(end);
 	}
-	int runStart = RunFromPosition(position);
+	Sci_Position runStart = RunFromPosition(position);
 	if (styles->ValueAt(runStart) == value) {
 		// Start is in expected value so trim range.
 		runStart++;
@@ -141,7 +142,7 @@ bool RunStyles::FillRange(int &position, int value, int &fillLength) {
 	if (runStart < runEnd) {
 		styles->SetValueAt(runStart, value);
 		// Remove each old run over the range
-		for (int run=runStart+1; run<runEnd; run++) {
+		for (Sci_Position run=runStart+1; run<runEnd; run++) {
 			RemoveRun(runStart+1);
 		}
 		runEnd = RunFromPosition(end);
@@ -151,13 +152,13 @@ bool RunStyles::FillRange(int &position, int value, int &fillLength) {
 	return true;
 }
 
-void RunStyles::SetValueAt(int position, int value) {
-	int len = 1;
+void RunStyles::SetValueAt(Sci_Position position, int value) {
+	Sci_Position len = 1;
 	FillRange(position, value, len);
 }
 
-void RunStyles::InsertSpace(int position, int insertLength) {
-	int runStart = RunFromPosition(position);
+void RunStyles::InsertSpace(Sci_Position position, Sci_Position insertLength) {
+	Sci_Position runStart = RunFromPosition(position);
 	if (starts->PositionFromPartition(runStart) == position) {
 		int runStyle = ValueAt(position);
 		// Inserting at start of run so make previous longer
@@ -194,10 +195,10 @@ void RunStyles::DeleteAll() {
 	styles->InsertValue(0, 2, 0);
 }
 
-void RunStyles::DeleteRange(int position, int deleteLength) {
-	int end = position + deleteLength;
-	int runStart = RunFromPosition(position);
-	int runEnd = RunFromPosition(end);
+void RunStyles::DeleteRange(Sci_Position position, Sci_Position deleteLength) {
+	Sci_Position end = position + deleteLength;
+	Sci_Position runStart = RunFromPosition(position);
+	Sci_Position runEnd = RunFromPosition(end);
 	if (runStart == runEnd) {
 		// Deleting from inside one run
 		starts->InsertText(runStart, -deleteLength);
@@ -206,7 +207,7 @@ void RunStyles::DeleteRange(int position, int deleteLength) {
 		runEnd = SplitRun(end);
 		starts->InsertText(runStart, -deleteLength);
 		// Remove each old run over the range
-		for (int run=runStart; run<runEnd; run++) {
+		for (Sci_Position run=runStart; run<runEnd; run++) {
 			RemoveRun(runStart);
 		}
 		RemoveRunIfEmpty(runStart);
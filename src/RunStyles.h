@@ -18,25 +18,25 @@ class RunStyles {
 public:
 	Partitioning *starts;
 	SplitVector<int> *styles;
-	int RunFromPosition(int position);
-	int SplitRun(int position);
-	void RemoveRun(int run);
-	void RemoveRunIfEmpty(int run);
-	void RemoveRunIfSameAsPrevious(int run);
+	Sci_Position RunFromPosition(Sci_Position position);
+	Sci_Position SplitRun(Sci_Position position);
+	void RemoveRun(Sci_Position run);
+	void RemoveRunIfEmpty(Sci_Position run);
+	void RemoveRunIfSameAsPrevious(Sci_Position run);
 public:
 	RunStyles();
 	~RunStyles();
-	int Length() const;
-	int ValueAt(int position) const;
-	int FindNextChange(int position, int end);
-	int StartRun(int position);
-	int EndRun(int position);
+	Sci_Position Length() const;
+	int ValueAt(Sci_Position position) const;
+	Sci_Position FindNextChange(Sci_Position position, Sci_Position end);
+	Sci_Position StartRun(Sci_Position position);
+	Sci_Position EndRun(Sci_Position position);
 	// Returns true if some values may have changed
-	bool FillRange(int &position, int value, int &fillLength);
-	void SetValueAt(int position, int value);
-	void InsertSpace(int position, int insertLength);
+	bool FillRange(Sci_Position &position, int value, Sci_Position &fillLength);
+	void SetValueAt(Sci_Position position, int value);
+	void InsertSpace(Sci_Position position, Sci_Position insertLength);
 	void DeleteAll();
-	void DeleteRange(int position, int deleteLength);
+	void DeleteRange(Sci_Position position, Sci_Position deleteLength);
 };
 
 #ifdef SCI_NAMESPACE
@@ -8,6 +8,7 @@
 #include <stdlib.h>
 
 #include <vector>
+#include <algorithm>
 
 #include "Platform.h"
 
@@ -156,7 +157,7 @@ void SelectionRange::MinimizeVirtualSpace() {
 	}
 }
 
-Selection::Selection() : mainRange(0), moveExtends(false), tentativeMain(false), selType(selStream) {
+Selection::Selection() : mainRange(0), moveExtends(false), tentativeMain(false), rangesIndexed(false), selType(selStream) {
 	AddSelection(SelectionPosition(0));
 }
 
@@ -214,10 +215,17 @@ void Selection::SetMain(size_t r) {
 }
 
 SelectionRange &Selection::Range(size_t r) {
+	// The caller may change the range
+	rangesIndexed = false;
+	return ranges[r];
+}
+
+const SelectionRange &Selection::Range(size_t r) const {
 	return ranges[r];
 }
 
 SelectionRange &Selection::RangeMain() {
+	rangesIndexed = false;
 	return ranges[mainRange];
 }
 
@@ -261,9 +269,16 @@ void Selection::MovePositions(bool insertion, int startChange, int length) {
 		ranges[i].caret.MoveForInsertDelete(insertion, startChange, length);
 		ranges[i].anchor.MoveForInsertDelete(insertion, startChange, length);
 	}
+	// Moving keeps positions in order so the index only needs its ends moved
+	for (size_t k=0; rangesIndexed && (k<endsReached.size()); k++) {
+		SelectionPosition endReached(endsReached[k]);
+		endReached.MoveForInsertDelete(insertion, startChange, length);
+		endsReached[k] = endReached.Position();
+	}
 }
 
 void Selection::TrimSelection(SelectionRange range) {
+	rangesIndexed = false;
 	for (size_t i=0; i<ranges.size();) {
 		if ((i != mainRange) && (ranges[i].Trim(range))) {
 			// Trimmed to empty so remove
@@ -280,12 +295,14 @@ void Selection::TrimSelection(SelectionRange range) {
 }
 
 void Selection::SetSelection(SelectionRange range) {
+	rangesIndexed = false;
 	ranges.clear();
 	ranges.push_back(range);
 	mainRange = ranges.size() - 1;
 }
 
 void Selection::AddSelection(SelectionRange range) {
+	rangesIndexed = false;
 	TrimSelection(range);
 	ranges.push_back(range);
 	mainRange = ranges.size() - 1;
@@ -296,6 +313,7 @@ void Selection::TentativeSelection(SelectionRange range) {
 		rangesSaved = ranges;
 	}
 	ranges = rangesSaved;
+	rangesIndexed = false;
 	AddSelection(range);
 	TrimSelection(ranges[mainRange]);
 	tentativeMain = true;
@@ -306,34 +324,95 @@ void Selection::CommitTentative() {
 	tentativeMain = false;
 }
 
+class RangeStartLess {
+	const std::vector<SelectionRange> &ranges;
+public:
+	explicit RangeStartLess(const std::vector<SelectionRange> &ranges_) : ranges(ranges_) {
+	}
+	bool operator()(size_t a, size_t b) const {
+		return ranges[a].Start().Position() < ranges[b].Start().Position();
+	}
+};
+
+// Returns how many ranges in rangesByStart start at or before pos. The ranges that
+// contain pos are among these and are found by stepping back while endsReached >= pos.
+size_t Selection::RangesStartingAtOrBefore(int pos) const {
+	if (!rangesIndexed) {
+		rangesByStart.resize(ranges.size());
+		for (size_t i=0; i<ranges.size(); i++) {
+			rangesByStart[i] = i;
+		}
+		std::sort(rangesByStart.begin(), rangesByStart.end(), RangeStartLess(ranges));
+		endsReached.resize(ranges.size());
+		int endFurthest = INVALID_POSITION;
+		for (size_t k=0; k<rangesByStart.size(); k++) {
+			endFurthest = Platform::Maximum(endFurthest, ranges[rangesByStart[k]].End().Position());
+			endsReached[k] = endFurthest;
+		}
+		rangesIndexed = true;
+	}
+	size_t lower = 0;
+	size_t upper = rangesByStart.size();
+	while (lower < upper) {
+		const size_t middle = (lower + upper) / 2;
+		if (ranges[rangesByStart[middle]].Start().Position() <= pos)
+			lower = middle + 1;
+		else
+			upper = middle;
+	}
+	return lower;
+}
+
 int Selection::CharacterInSelection(int posCharacter) const {
-	for (size_t i=0; i<ranges.size(); i++) {
-		if (ranges[i].ContainsCharacter(posCharacter))
-			return i == mainRange ? 1 : 2;
+	size_t rangeFirst = ranges.size();
+	for (size_t k=RangesStartingAtOrBefore(posCharacter); (k > 0) && (endsReached[k-1] > posCharacter); k--) {
+		const size_t i = rangesByStart[k-1];
+		if ((i < rangeFirst) && ranges[i].ContainsCharacter(posCharacter))
+			rangeFirst = i;
 	}
+	if (rangeFirst < ranges.size())
+		return rangeFirst == mainRange ? 1 : 2;
 	return 0;
 }
 
 int Selection::InSelectionForEOL(int pos) const {
-	for (size_t i=0; i<ranges.size(); i++) {
-		if (!ranges[i].Empty() && (pos > ranges[i].Start().Position()) && (pos <= ranges[i].End().Position()))
-			return i == mainRange ? 1 : 2;
+	size_t rangeFirst = ranges.size();
+	for (size_t k=RangesStartingAtOrBefore(pos - 1); (k > 0) && (endsReached[k-1] >= pos); k--) {
+		const size_t i = rangesByStart[k-1];
+		if ((i < rangeFirst) && !ranges[i].Empty() && (pos <= ranges[i].End().Position()))
+			rangeFirst = i;
 	}
+	if (rangeFirst < ranges.size())
+		return rangeFirst == mainRange ? 1 : 2;
 	return 0;
 }
 
 int Selection::VirtualSpaceFor(int pos) const {
 	int virtualSpace = 0;
-	for (size_t i=0; i<ranges.size(); i++) {
-		if ((ranges[i].caret.Position() == pos) && (virtualSpace < ranges[i].caret.VirtualSpace()))
-			virtualSpace = ranges[i].caret.VirtualSpace();
-		if ((ranges[i].anchor.Position() == pos) && (virtualSpace < ranges[i].anchor.VirtualSpace()))
-			virtualSpace = ranges[i].anchor.VirtualSpace();
+	for (size_t k=RangesStartingAtOrBefore(pos); (k > 0) && (endsReached[k-1] >= pos); k--) {
+		const SelectionRange &range = ranges[rangesByStart[k-1]];
+		if ((range.caret.Position() == pos) && (virtualSpace < range.caret.VirtualSpace()))
+			virtualSpace = range.caret.VirtualSpace();
+		if ((range.anchor.Position() == pos) && (virtualSpace < range.anchor.VirtualSpace()))
+			virtualSpace = range.anchor.VirtualSpace();
 	}
 	return virtualSpace;
 }
 
+// Set rangesFound to the numbers, in increasing order, of the ranges that start at or
+// before end and end at or after start.
+void Selection::RangesOverlapping(int start, int end, std::vector<size_t> &rangesFound) const {
+	rangesFound.clear();
+	for (size_t k=RangesStartingAtOrBefore(end); (k > 0) && (endsReached[k-1] >= start); k--) {
+		const size_t i = rangesByStart[k-1];
+		if (ranges[i].End().Position() >= start)
+			rangesFound.push_back(i);
+	}
+	std::sort(rangesFound.begin(), rangesFound.end());
+}
+
 void Selection::Clear() {
+	rangesIndexed = false;
 	ranges.clear();
 	ranges.push_back(SelectionRange());
 	mainRange = ranges.size() - 1;
@@ -344,6 +423,7 @@ void Selection::Clear() {
 }
 
 void Selection::RemoveDuplicates() {
+	rangesIndexed = false;
 	for (size_t i=0; i<ranges.size()-1; i++) {
 		if (ranges[i].Empty()) {
 			size_t j=i+1;
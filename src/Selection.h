@@ -137,6 +137,13 @@ class Selection {
 	size_t mainRange;
 	bool moveExtends;
 	bool tentativeMain;
+	// Range numbers ordered by start position and, for each of those, the furthest end
+	// of any range up to it so the ranges around a position are found without visiting
+	// every range. Rebuilt by the first query after the ranges may have been changed.
+	mutable std::vector<size_t> rangesByStart;
+	mutable std::vector<int> endsReached;
+	mutable bool rangesIndexed;
+	size_t RangesStartingAtOrBefore(int pos) const;
 public:
 	enum selTypes { noSel, selStream, selRectangle, selLines, selThin };
 	selTypes selType;
@@ -156,6 +163,7 @@ public:
 	size_t Main() const;
 	void SetMain(size_t r);
 	SelectionRange &Range(size_t r);
+	const SelectionRange &Range(size_t r) const;
 	SelectionRange &RangeMain();
 	bool MoveExtends() const;
 	void SetMoveExtends(bool moveExtends_);
@@ -171,6 +179,7 @@ public:
 	int CharacterInSelection(int posCharacter) const;
 	int InSelectionForEOL(int pos) const;
 	int VirtualSpaceFor(int pos) const;
+	void RangesOverlapping(int start, int end, std::vector<size_t> &rangesFound) const;
 	void Clear();
 	void RemoveDuplicates();
 	void RotateMain();
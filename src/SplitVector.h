@@ -13,16 +13,16 @@ template <typename T>
 class SplitVector {
 protected:
 	T *body;
-	int size;
-	int lengthBody;
-	int part1Length;
-	int gapLength;	/// invariant: gapLength == size - lengthBody
-	int growSize;
+	Sci_Position size;
+	Sci_Position lengthBody;
+	Sci_Position part1Length;
+	Sci_Position gapLength;	/// invariant: gapLength == size - lengthBody
+	Sci_Position growSize;
 
 	/// Move the gap to a particular position so that insertion and
 	/// deletion at that point will not require much copying and
 	/// hence be fast.
-	void GapTo(int position) {
+	void GapTo(Sci_Position position) {
 		if (position != part1Length) {
 			if (position < part1Length) {
 				memmove(
@@ -41,9 +41,11 @@ protected:
 
 	/// Check that there is room in the buffer for an insertion,
 	/// reallocating if more space needed.
-	void RoomFor(int insertionLength) {
+	/// The gap grows with the contents rather than the allocation so that a buffer
+	/// which has had most of its contents deleted does not keep growing quickly.
+	void RoomFor(Sci_Position insertionLength) {
 		if (gapLength <= insertionLength) {
-			while (growSize < size / 6)
+			while (growSize < lengthBody / 6)
 				growSize *= 2;
 			ReAllocate(size + insertionLength + growSize);
 		}
@@ -69,28 +71,31 @@ public:
 		body = 0;
 	}
 
-	int GetGrowSize() const {
+	Sci_Position GetGrowSize() const {
 		return growSize;
 	}
 
-	void SetGrowSize(int growSize_) {
+	void SetGrowSize(Sci_Position growSize_) {
 		growSize = growSize_;
 	}
 
 	/// Reallocate the storage for the buffer to be newSize and
 	/// copy exisiting contents to the new buffer.
 	/// Must not be used to decrease the size of the buffer.
-	void ReAllocate(int newSize) {
+	void ReAllocate(Sci_Position newSize) {
 		if (newSize > size) {
-			// Move the gap to the end
-			GapTo(lengthBody);
+			// Copy each part straight to its place in the new buffer, widening the gap
+			// where it is, rather than moving the gap to the end first
 			T *newBody = new T[newSize];
+			Sci_Position newGapLength = gapLength + newSize - size;
 			if ((size != 0) && (body != 0)) {
-				memmove(newBody, body, sizeof(T) * lengthBody);
+				memmove(newBody, body, sizeof(T) * part1Length);
+				memmove(newBody + part1Length + newGapLength, body + part1Length + gapLength,
+					sizeof(T) * (lengthBody - part1Length));
 				delete []body;
 			}
 			body = newBody;
-			gapLength += newSize - size;
+			gapLength = newGapLength;
 			size = newSize;
 		}
 	}
@@ -99,7 +104,7 @@ public:
 	/// Retrieving positions outside the range of the buffer returns 0.
 	/// The assertions here are disabled since calling code can be
 	/// simpler if out of range access works and returns 0.
-	T ValueAt(int position) const {
+	T ValueAt(Sci_Position position) const {
 		if (position < part1Length) {
 			//PLATFORM_ASSERT(position >= 0);
 			if (position < 0) {
@@ -117,7 +122,7 @@ public:
 		}
 	}
 
-	void SetValueAt(int position, T v) {
+	void SetValueAt(Sci_Position position, T v) {
 		if (position < part1Length) {
 			PLATFORM_ASSERT(position >= 0);
 			if (position < 0) {
@@ -135,7 +140,7 @@ public:
 		}
 	}
 
-	T &operator[](int position) const {
+	T &operator[](Sci_Position position) const {
 		PLATFORM_ASSERT(position >= 0 && position < lengthBody);
 		if (position < part1Length) {
 			return body[position];
@@ -145,13 +150,13 @@ public:
 	}
 
 	/// Retrieve the length of the buffer.
-	int Length() const {
+	Sci_Position Length() const {
 		return lengthBody;
 	}
 
 	/// Insert a single value into the buffer.
 	/// Inserting at positions outside the current range fails.
-	void Insert(int position, T v) {
+	void Insert(Sci_Position position, T v) {
 		PLATFORM_ASSERT((position >= 0) && (position <= lengthBody));
 		if ((position < 0) || (position > lengthBody)) {
 			return;
@@ -166,7 +171,7 @@ public:
 
 	/// Insert a number of elements into the buffer setting their value.
 	/// Inserting at positions outside the current range fails.
-	void InsertValue(int position, int insertLength, T v) {
+	void InsertValue(Sci_Position position, Sci_Position insertLength, T v) {
 		PLATFORM_ASSERT((position >= 0) && (position <= lengthBody));
 		if (insertLength > 0) {
 			if ((position < 0) || (position > lengthBody)) {
@@ -174,7 +179,7 @@ public:
 			}
 			RoomFor(insertLength);
 			GapTo(position);
-			for (int i = 0; i < insertLength; i++)
+			for (Sci_Position i = 0; i < insertLength; i++)
 				body[part1Length + i] = v;
 			lengthBody += insertLength;
 			part1Length += insertLength;
@@ -184,14 +189,46 @@ public:
 
 	/// Ensure at least length elements allocated,
 	/// appending zero valued elements if needed.
-	void EnsureLength(int wantedLength) {
+	void EnsureLength(Sci_Position wantedLength) {
 		if (Length() < wantedLength) {
 			InsertValue(Length(), wantedLength - Length(), 0);
 		}
 	}
 
+	/// Retrieve a range of elements into an array
+	void GetRange(T *buffer, Sci_Position position, Sci_Position retrieveLength) const {
+		// Split into up to 2 ranges, before and after the gap, then use memcpy on each.
+		Sci_Position range1Length = 0;
+		if (position < part1Length) {
+			Sci_Position part1AfterPosition = part1Length - position;
+			range1Length = retrieveLength;
+			if (range1Length > part1AfterPosition)
+				range1Length = part1AfterPosition;
+		}
+		memcpy(buffer, body + position, range1Length * sizeof(T));
+		buffer += range1Length;
+		position = position + range1Length + gapLength;
+		Sci_Position range2Length = retrieveLength - range1Length;
+		memcpy(buffer, body + position, range2Length * sizeof(T));
+	}
+
+	/// Return a pointer for reading from position up to the gap or the end without moving the gap.
+	/// lengthSegment receives the number of elements that may be read through the pointer.
+	const T *SegmentPointer(Sci_Position position, Sci_Position &lengthSegment) const {
+		if ((position < 0) || (position > lengthBody)) {
+			lengthSegment = 0;
+			return body;
+		}
+		if (position < part1Length) {
+			lengthSegment = part1Length - position;
+			return body + position;
+		}
+		lengthSegment = lengthBody - position;
+		return body + gapLength + position;
+	}
+
 	/// Insert text into the buffer from an array.
-	void InsertFromArray(int positionToInsert, const T s[], int positionFrom, int insertLength) {
+	void InsertFromArray(Sci_Position positionToInsert, const T s[], Sci_Position positionFrom, Sci_Position insertLength) {
 		PLATFORM_ASSERT((positionToInsert >= 0) && (positionToInsert <= lengthBody));
 		if (insertLength > 0) {
 			if ((positionToInsert < 0) || (positionToInsert > lengthBody)) {
@@ -207,7 +244,7 @@ public:
 	}
 
 	/// Delete one element from the buffer.
-	void Delete(int position) {
+	void Delete(Sci_Position position) {
 		PLATFORM_ASSERT((position >= 0) && (position < lengthBody));
 		if ((position < 0) || (position >= lengthBody)) {
 			return;
@@ -217,7 +254,7 @@ public:
 
 	/// Delete a range from the buffer.
 	/// Deleting positions outside the current range fails.
-	void DeleteRange(int position, int deleteLength) {
+	void DeleteRange(Sci_Position position, Sci_Position deleteLength) {
 		PLATFORM_ASSERT((position >= 0) && (position + deleteLength <= lengthBody));
 		if ((position < 0) || ((position + deleteLength) > lengthBody)) {
 			return;
@@ -244,6 +281,27 @@ public:
 		body[lengthBody] = 0;
 		return body;
 	}
+
+	/// Return a pointer to a range of elements, first moving the gap to the start of
+	/// the range if the gap is inside it, which moves fewer than rangeLength elements.
+	T *RangePointer(Sci_Position position, Sci_Position rangeLength) {
+		if (position < part1Length) {
+			if ((position + rangeLength) > part1Length) {
+				// Range overlaps gap, so move gap to start of range.
+				GapTo(position);
+				return body + position + gapLength;
+			} else {
+				return body + position;
+			}
+		} else {
+			return body + position + gapLength;
+		}
+	}
+
+	/// The position of the gap, where a range would have to be moved to be contiguous.
+	Sci_Position GapPosition() const {
+		return part1Length;
+	}
 };
 
 #endif
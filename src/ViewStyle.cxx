@@ -9,6 +9,7 @@
 
 #include "Platform.h"
 
+#include "Sci_Position.h"
 #include "Scintilla.h"
 #include "SplitVector.h"
 #include "Partitioning.h"
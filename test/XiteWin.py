@@ -130,6 +130,31 @@ class TEXTRANGE(ctypes.Structure):
 		('lpstrText', ctypes.POINTER(ctypes.c_char)),
 	)
 
+STREAMFN = ctypes.CFUNCTYPE(c_int, ctypes.c_void_p, ctypes.POINTER(ctypes.c_char), ctypes.c_long)
+
+class TEXTSTREAM(ctypes.Structure):
+	_fields_= (\
+		('cpMin', c_int),
+		('cpMax', c_int),
+		('fnStream', STREAMFN),
+		('context', ctypes.c_void_p),
+	)
+
+class Loader:
+	# Calls the ILoader returned by SCI_CREATELOADER through its vtable
+	def __init__(self, loader):
+		self._loader = loader
+		vtable = ctypes.cast(loader, ctypes.POINTER(ctypes.POINTER(ctypes.c_void_p)))[0]
+		self._release = ctypes.WINFUNCTYPE(c_int, ctypes.c_void_p)(vtable[0])
+		self._addData = ctypes.WINFUNCTYPE(c_int, ctypes.c_void_p, c_char_p, ctypes.c_ssize_t)(vtable[1])
+		self._convert = ctypes.WINFUNCTYPE(ctypes.c_void_p, ctypes.c_void_p)(vtable[2])
+	def Release(self):
+		return self._release(self._loader)
+	def AddData(self, data):
+		return self._addData(self._loader, data, len(data))
+	def ConvertToDocument(self):
+		return self._convert(self._loader)
+
 class FINDTEXT(ctypes.Structure):
 	_fields_= (\
 		('cpMin', c_int),
@@ -260,6 +285,19 @@ class Scintilla:
 		styledText = tr.lpstrText[:length]
 		styledText += b"\0" * (length - len(styledText))
 		return styledText
+	def StreamedRange(self, start, end, piecesWanted=-1):
+		# Returns the list of pieces passed to the stream function
+		pieces = []
+		def receive(context, text, length):
+			pieces.append(ctypes.string_at(text, length))
+			return 1 if len(pieces) == piecesWanted else 0
+		ts = TEXTSTREAM()
+		ts.cpMin = start
+		ts.cpMax = end
+		ts.fnStream = STREAMFN(receive)
+		ts.context = 0
+		self.StreamText(0, ctypes.byref(ts))
+		return pieces
 	def FindBytes(self, start, end, s, flags):
 		ft = FINDTEXT()
 		ft.cpMin = start
@@ -2,7 +2,7 @@
 
 from __future__ import with_statement
 
-import os, string, time, unittest
+import ctypes, os, string, time, unittest
 
 import XiteWin
 
@@ -49,6 +49,28 @@ class TestPerformance(unittest.TestCase):
 		self.xite.DoEvents()
 		self.assert_(self.ed.Length > 0)
 
+	def testHugeLoader(self):
+		# Loading in blocks as from a file compared with setting the text in one call
+		oneLine = (string.ascii_letters + string.digits + "\n").encode('utf-8')
+		data = oneLine * 1000000
+		start = time.time()
+		self.ed.SetText(0, data)
+		end = time.time()
+		print("%6.3f testHugeLoader SetText" % (end - start))
+		blockSize = 1024 * 1024
+		start = time.time()
+		loader = XiteWin.Loader(self.ed.CreateLoader(len(data)))
+		for block in range(0, len(data), blockSize):
+			self.assertEquals(loader.AddData(data[block:block + blockSize]), 0)
+		doc = loader.ConvertToDocument()
+		self.ed.SetDocPointer(0, doc)
+		self.ed.ReleaseDocument(0, doc)
+		end = time.time()
+		print("%6.3f testHugeLoader CreateLoader" % (end - start))
+		self.assertEquals(self.ed.Length, len(data))
+		self.assertEquals(self.ed.LineCount, 1000001)
+		self.xite.DoEvents()
+
 	def testHugeInserts(self):
 		data = (string.ascii_letters + string.digits + "\n").encode('utf-8')
 		data = data * 100000
@@ -79,5 +101,297 @@ class TestPerformance(unittest.TestCase):
 		self.xite.DoEvents()
 		self.assert_(self.ed.Length > 0)
 
+	def testHugeScatteredInserts(self):
+		# Inserts spread over the document defeat Partitioning's step
+		# so build with LINE_INDEX_BLOCKED=1 to compare with PartitioningBlocked
+		oneLine = (string.ascii_letters + string.digits + "\n").encode('utf-8')
+		data = oneLine * 1000000
+		insert = (string.digits).encode('utf-8')
+		start = time.time()
+		self.ed.AddText(len(data), data)
+		end = time.time()
+		print("%6.3f testHugeScatteredInserts load" % (end - start))
+		lines = self.ed.LineCount
+		start = time.time()
+		for i in range(10000):
+			line = (i * 7919) % lines
+			self.ed.InsertText(self.ed.PositionFromLine(line), insert)
+		end = time.time()
+		duration = end - start
+		print("%6.3f testHugeScatteredInserts" % duration)
+		# Adding and removing lines splits and drops blocks of the line index
+		start = time.time()
+		for i in range(10000):
+			line = (i * 7919) % lines
+			self.ed.InsertText(self.ed.PositionFromLine(line), oneLine * 3)
+		for i in range(10000):
+			line = (i * 104729) % (lines - 1)
+			lineStart = self.ed.PositionFromLine(line)
+			self.ed.DeleteRange(lineStart, self.ed.PositionFromLine(line + 1) - lineStart)
+		end = time.time()
+		print("%6.3f testHugeScatteredInserts lines" % (end - start))
+		self.assertEquals(self.ed.LineCount, lines + 20000)
+		self.xite.DoEvents()
+		self.assert_(self.ed.Length > 0)
+
+	def testHugeLineFromPosition(self):
+		oneLine = (string.ascii_letters + string.digits + "\n").encode('utf-8')
+		data = oneLine * 1000000
+		self.ed.AddText(len(data), data)
+		length = self.ed.Length
+		start = time.time()
+		for i in range(100000):
+			pos = (i * 7919) % length
+			self.assertEquals(self.ed.LineFromPosition(pos), pos // len(oneLine))
+		end = time.time()
+		duration = end - start
+		print("%6.3f testHugeLineFromPosition" % duration)
+		self.xite.DoEvents()
+		self.assert_(self.ed.Length > 0)
+
+	def testConvertEOLs(self):
+		oneLine = (string.ascii_letters + string.digits + "\r\n").encode('utf-8')
+		data = oneLine * 500000
+		self.ed.AddText(len(data), data)
+		start = time.time()
+		self.ed.ConvertEOLs(self.ed.SC_EOL_LF)
+		end = time.time()
+		duration = end - start
+		print("%6.3f testConvertEOLs" % duration)
+		self.xite.DoEvents()
+		self.assertEquals(self.ed.LineCount, 500001)
+		self.assertEquals(self.ed.Length, len(data) - 500000)
+
+	def testHugeWrapped(self):
+		# Adding text to a lexed document should cost about the same with wrapping
+		# on as off since only the lines being wrapped are lexed
+		oneLine = ("int x = 1; // " + string.ascii_letters + string.digits + "\n").encode('utf-8')
+		data = oneLine * 200000
+		self.ed.Lexer = self.ed.SCLEX_CPP
+		for wrapMode in [self.ed.SC_WRAP_NONE, self.ed.SC_WRAP_WORD]:
+			self.ed.ClearAll()
+			self.ed.WrapMode = wrapMode
+			start = time.time()
+			self.ed.AddText(len(data), data)
+			self.xite.DoEvents()
+			end = time.time()
+			duration = end - start
+			print("%6.3f testHugeWrapped %d" % (duration, wrapMode))
+		self.ed.WrapMode = self.ed.SC_WRAP_NONE
+		self.ed.Lexer = self.ed.SCLEX_CONTAINER
+		self.assert_(self.ed.Length > 0)
+
+	def testLexKeywords(self):
+		# Identifier streams checked against a large keyword list as in SQL or VHDL
+		keywords = [("k%d" % i).encode('utf-8') + string.ascii_lowercase[i % 26].encode('utf-8') for i in range(5000)]
+		oneLine = b" ".join(keywords[i * 7 % 5000] + b" ident" + str(i).encode('utf-8') for i in range(20)) + b"\n"
+		data = oneLine * 20000
+		self.ed.Lexer = self.ed.SCLEX_SQL
+		self.ed.SetKeyWords(0, b" ".join(keywords))
+		self.ed.AddText(len(data), data)
+		start = time.time()
+		self.ed.Colourise(0, -1)
+		end = time.time()
+		duration = end - start
+		print("%6.3f testLexKeywords" % duration)
+		self.ed.Lexer = self.ed.SCLEX_CONTAINER
+		self.xite.DoEvents()
+		self.assert_(self.ed.Length > 0)
+
+	def testHugeGetText(self):
+		# Copying a document out with the gap in the middle as when saving
+		oneLine = (string.ascii_letters + string.digits + "\n").encode('utf-8')
+		data = oneLine * 1000000
+		self.ed.AddText(len(data), data)
+		self.ed.InsertText(len(data) // 2, oneLine)
+		length = self.ed.Length
+		text = ctypes.create_string_buffer(length + 1)
+		start = time.time()
+		self.assertEquals(self.ed.GetText(length + 1, text), length)
+		end = time.time()
+		print("%6.3f testHugeGetText GetText" % (end - start))
+		start = time.time()
+		pieces = self.ed.StreamedRange(0, -1)
+		end = time.time()
+		print("%6.3f testHugeGetText StreamText" % (end - start))
+		self.assertEquals(b"".join(pieces), text.raw[:length])
+		self.xite.DoEvents()
+
+	def testManyIndicators(self):
+		# Short runs on several indicators as from spell checking, linting and
+		# search highlighting then edits and painting through them
+		oneLine = (string.ascii_letters + string.digits + "\n").encode('utf-8')
+		data = oneLine * 100000
+		self.ed.AddText(len(data), data)
+		length = self.ed.Length
+		start = time.time()
+		for indicator in range(8, 13):
+			self.ed.IndicatorCurrent = indicator
+			for pos in range(indicator, length - 4, 23):
+				self.ed.IndicatorValue = 1 + pos % 3
+				self.ed.IndicatorFillRange(pos, 4)
+		end = time.time()
+		print("%6.3f testManyIndicators fill" % (end - start))
+		start = time.time()
+		for i in range(10000):
+			self.ed.InsertText((i * 7919) % length, b"x")
+		end = time.time()
+		print("%6.3f testManyIndicators insert" % (end - start))
+		start = time.time()
+		for i in range(100):
+			self.ed.GotoLine((i * 7919) % 100000)
+			self.xite.DoEvents()
+		end = time.time()
+		print("%6.3f testManyIndicators paint" % (end - start))
+		self.assert_(self.ed.IndicatorAllOnFor(self.ed.IndicatorEnd(8, 0)) != 0)
+
+	def testManySelections(self):
+		# Painting and typing with a selection on every line as after selecting
+		# all occurrences of a word
+		oneLine = (string.ascii_letters + string.digits + "\n").encode('utf-8')
+		data = oneLine * 10000
+		self.ed.AddText(len(data), data)
+		self.ed.MultipleSelection = 1
+		self.ed.SetSelection(0, 3)
+		start = time.time()
+		for line in range(1, 10000):
+			self.ed.AddSelection(line * len(oneLine), line * len(oneLine) + 3)
+		end = time.time()
+		print("%6.3f testManySelections add" % (end - start))
+		self.assertEquals(self.ed.Selections, 10000)
+		start = time.time()
+		for i in range(100):
+			self.ed.LineScroll(0, 50)
+			self.xite.DoEvents()
+		end = time.time()
+		print("%6.3f testManySelections paint" % (end - start))
+		start = time.time()
+		for i in range(100):
+			self.ed.InsertText(0, b"x")
+			self.xite.DoEvents()
+		end = time.time()
+		print("%6.3f testManySelections insert" % (end - start))
+		self.assertEquals(self.ed.GetSelectionNStart(9999), 9999 * len(oneLine) + 100)
+		self.ed.MultipleSelection = 0
+
+	def testHugeSearch(self):
+		oneLine = (string.ascii_letters + string.digits + "\n").encode('utf-8')
+		data = oneLine * 1000000
+		self.ed.AddText(len(data), data)
+		searchString = b"NotPresentInText"
+		for flags in [self.ed.SCFIND_MATCHCASE, 0]:
+			self.ed.SearchFlags = flags
+			self.ed.TargetStart = 0
+			self.ed.TargetEnd = self.ed.Length
+			start = time.time()
+			self.assertEquals(self.ed.SearchInTarget(len(searchString), searchString), -1)
+			end = time.time()
+			duration = end - start
+			print("%6.3f testHugeSearch %d" % (duration, flags))
+		self.ed.SearchFlags = 0
+		self.xite.DoEvents()
+
+	def testHugeRegexSearch(self):
+		oneLine = (string.ascii_letters + string.digits + "\n").encode('utf-8')
+		data = oneLine * 1000000
+		self.ed.AddText(len(data), data)
+		for searchString in [b"NotPresent", b"[0-9]+x", b"\<abc.*Z9\>x", b"^xyz"]:
+			for flags in [self.ed.SCFIND_MATCHCASE, 0]:
+				self.ed.SearchFlags = flags | self.ed.SCFIND_REGEXP
+				self.ed.TargetStart = 0
+				self.ed.TargetEnd = self.ed.Length
+				start = time.time()
+				self.assertEquals(self.ed.SearchInTarget(len(searchString), searchString), -1)
+				end = time.time()
+				duration = end - start
+				print("%6.3f testHugeRegexSearch %s %d" % (duration, searchString, flags))
+		self.ed.SearchFlags = 0
+		self.xite.DoEvents()
+
+	def testHugeRegexSearchBackward(self):
+		# One long line with a match on each repetition and one near its start
+		oneLine = (string.ascii_letters + string.digits + " ").encode('utf-8')
+		data = b"zebra " + oneLine * 800000
+		self.ed.AddText(len(data), data)
+		for searchString, expected in [(b"z[a-z]*ra", 0), (b"[0-9]+ ", len(data) - 2), (b"NotPresent", -1)]:
+			for flags in [self.ed.SCFIND_MATCHCASE, 0]:
+				self.ed.SearchFlags = flags | self.ed.SCFIND_REGEXP
+				self.ed.TargetStart = self.ed.Length
+				self.ed.TargetEnd = 0
+				start = time.time()
+				self.assertEquals(self.ed.SearchInTarget(len(searchString), searchString), expected)
+				end = time.time()
+				duration = end - start
+				print("%6.3f testHugeRegexSearchBackward %s %d" % (duration, searchString, flags))
+		self.ed.SearchFlags = 0
+		self.xite.DoEvents()
+
+	def testCountInTarget(self):
+		oneLine = (string.ascii_letters + string.digits + "\n").encode('utf-8')
+		data = oneLine * 1000000
+		self.ed.AddText(len(data), data)
+		searchString = b"xyz"
+		for flags in [self.ed.SCFIND_MATCHCASE, 0]:
+			self.ed.SearchFlags = flags
+			self.ed.TargetStart = 0
+			self.ed.TargetEnd = self.ed.Length
+			start = time.time()
+			self.assertEquals(self.ed.CountInTarget(len(searchString), searchString),
+				1000000 if flags else 2000000)
+			end = time.time()
+			duration = end - start
+			print("%6.3f testCountInTarget %d" % (duration, flags))
+		self.ed.SearchFlags = 0
+		self.xite.DoEvents()
+
+	def testScaling(self):
+		# Time per operation in documents of 1K, 1M and 100M bytes exercises
+		# SplitVector gap moves and Partitioning steps as they grow
+		oneLine = (string.ascii_letters + string.digits + "\n").encode('utf-8')
+		insert = (string.digits + "\n").encode('utf-8')
+		for size in [1000, 1000000, 100000000]:
+			self.ed.ClearAll()
+			self.ed.EmptyUndoBuffer()
+			data = oneLine * (size // len(oneLine))
+			self.ed.AddText(len(data), data)
+			length = self.ed.Length
+			operations = 1000
+			start = time.time()
+			for i in range(operations):
+				self.ed.InsertText((i * 7919) % length, insert)
+			end = time.time()
+			print("%9.0f ns testScaling insert %d" % ((end - start) * 1e9 / operations, size))
+			start = time.time()
+			for i in range(operations):
+				self.ed.LineFromPosition((i * 7919) % length)
+			end = time.time()
+			print("%9.0f ns testScaling LineFromPosition %d" % ((end - start) * 1e9 / operations, size))
+		self.xite.DoEvents()
+		self.assert_(self.ed.Length > 0)
+
+	def testUndoTyping(self):
+		# Cost and memory per undo action when typing coalesces and when
+		# large replacements each record a separate action
+		operations = 1000000
+		start = time.time()
+		for i in range(operations):
+			self.ed.AddText(1, b"x")
+		end = time.time()
+		print("%9.0f ns testUndoTyping typing" % ((end - start) * 1e9 / operations))
+		data = b"y" * 1000
+		operations = 100000
+		self.ed.SetSel(0, 0)
+		start = time.time()
+		for i in range(operations):
+			self.ed.BeginUndoAction()
+			self.ed.TargetStart = 0
+			self.ed.TargetEnd = len(data)
+			self.ed.ReplaceTarget(len(data), data)
+			self.ed.EndUndoAction()
+		end = time.time()
+		print("%9.0f ns testUndoTyping replace" % ((end - start) * 1e9 / operations))
+		self.xite.DoEvents()
+		self.assert_(self.ed.CanUndo())
+
 if __name__ == '__main__':
 	XiteWin.main("performanceTests")
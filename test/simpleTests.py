@@ -123,6 +123,136 @@ class TestSimple(unittest.TestCase):
 		self.ed.Null()
 		self.assertEquals(self.ed.Contents(), b"xx")
 
+	def testAttachReadOnlyText(self):
+		self.ed.AddText(12, b"0123456789xy")
+		self.ed.SetSel(10, 12)
+		data = ctypes.create_string_buffer(b"ab\r\ncd\ne")
+		self.ed.AttachReadOnlyText(9, ctypes.addressof(data))
+		self.assertEquals(self.ed.CurrentPos, 0)
+		self.assertEquals(self.ed.Anchor, 0)
+		self.assertEquals(self.ed.FirstVisibleLine, 0)
+		self.assertEquals(self.ed.Length, 9)
+		self.assertEquals(self.ed.LineCount, 3)
+		self.assertEquals(self.ed.PositionFromLine(1), 4)
+		self.assertEquals(self.ed.PositionFromLine(2), 7)
+		self.assertEquals(self.ed.Contents(), b"ab\r\ncd\ne")
+		self.assertEquals(self.ed.ReadOnly, 1)
+		self.assertEquals(self.ed.CanUndo(), 0)
+		self.ed.AddText(1, b"x")
+		self.assertEquals(self.ed.Length, 9)
+		self.ed.StartStyling(4, 0xff)
+		self.ed.SetStyling(2, 3)
+		self.assertEquals(self.ed.GetStyleAt(5), 3)
+		self.assertEquals(self.ed.GetStyleAt(7), 0)
+		self.assertEquals(self.ed.GetRangePointer(8, 2), 0)
+		self.ed.AttachReadOnlyText(0, 0)
+		self.assertEquals(self.ed.Length, 0)
+		self.assertEquals(self.ed.ReadOnly, 0)
+		self.ed.AddText(1, b"x")
+		self.assertEquals(self.ed.Contents(), b"x")
+
+	def testRangePointer(self):
+		self.ed.AddText(8, b"abcdefgh")
+		self.ed.InsertText(4, b"12")
+		gap = self.ed.GapPosition
+		self.assertEquals(gap, 6)
+		length = self.ed.Length
+		before = ctypes.string_at(self.ed.GetRangePointer(0, gap), gap)
+		after = ctypes.string_at(self.ed.GetRangePointer(gap, length - gap), length - gap)
+		self.assertEquals(before + after, b"abcd12efgh")
+		self.assertEquals(self.ed.GapPosition, 6)
+		# A range containing the gap moves it to the start of the range
+		self.assertEquals(ctypes.string_at(self.ed.GetRangePointer(2, 6), 6), b"cd12ef")
+		self.assertEquals(self.ed.GapPosition, 2)
+
+	def testGetTextAroundGap(self):
+		self.ed.AddText(8, b"abcdefgh")
+		self.ed.InsertText(4, b"12\n")
+		self.assertEquals(self.ed.GapPosition, 7)
+		text = ctypes.create_string_buffer(20)
+		self.assertEquals(self.ed.GetText(12, text), 11)
+		self.assertEquals(text.value, b"abcd12\nefgh")
+		self.assertEquals(self.ed.GetLine(1, text), 4)
+		self.assertEquals(text.raw[:4], b"efgh")
+		self.ed.SetSel(2, 9)
+		self.assertEquals(self.ed.GetSelText(0, text), 8)
+		self.assertEquals(text.value, b"cd12\nef")
+		self.ed.GotoPos(3)
+		self.assertEquals(self.ed.GetCurLine(4, text), 3)
+		self.assertEquals(text.value, b"abc")
+		self.assertEquals(self.ed.GapPosition, 7)
+
+	def testStreamText(self):
+		self.ed.AddText(8, b"abcdefgh")
+		self.ed.InsertText(4, b"12")
+		self.assertEquals(self.ed.StreamedRange(0, -1), [b"abcd12", b"efgh"])
+		self.assertEquals(self.ed.StreamedRange(2, 8), [b"cd12", b"ef"])
+		self.assertEquals(self.ed.StreamedRange(7, 9), [b"fg"])
+		# Stopping after the first piece
+		self.assertEquals(self.ed.StreamedRange(0, -1, 1), [b"abcd12"])
+		self.assertEquals(self.ed.StreamedRange(8, 20), [])
+		self.assertEquals(self.ed.GapPosition, 6)
+
+	def testLoader(self):
+		loader = XiteWin.Loader(self.ed.CreateLoader(100))
+		for data in [b"ab\r", b"\ncd\r", b"", b"ef\n", b"g"]:
+			self.assertEquals(loader.AddData(data), self.ed.SC_STATUS_OK)
+		doc = loader.ConvertToDocument()
+		self.ed.SetDocPointer(0, doc)
+		self.ed.ReleaseDocument(0, doc)
+		self.assertEquals(self.ed.Contents(), b"ab\r\ncd\ref\ng")
+		self.assertEquals(self.ed.LineCount, 4)
+		self.assertEquals(self.ed.PositionFromLine(2), 7)
+		self.assertEquals(self.ed.CanUndo(), 0)
+		self.assertEquals(self.ed.Modify, 0)
+		self.ed.AddText(1, b"x")
+		self.assertEquals(self.ed.CanUndo(), 1)
+		self.assertEquals(self.ed.Modify, 1)
+		# An abandoned load frees its document
+		loader = XiteWin.Loader(self.ed.CreateLoader(10))
+		self.assertEquals(loader.AddData(b"abc"), self.ed.SC_STATUS_OK)
+		self.assertEquals(loader.Release(), 0)
+
+	def testUndoMemoryLimit(self):
+		self.assertEquals(self.ed.UndoMemoryLimit, 0)
+		self.ed.UndoMemoryLimit = 100000
+		self.assertEquals(self.ed.UndoMemoryLimit, 100000)
+		data = b"x" * 10000
+		for i in range(50):
+			self.ed.BeginUndoAction()
+			self.ed.AddText(len(data), data)
+			self.ed.EndUndoAction()
+		self.assertEquals(self.ed.Length, 500000)
+		undos = 0
+		while self.ed.CanUndo():
+			self.ed.Undo()
+			undos += 1
+		self.assert_(0 < undos < 50)
+		self.assertEquals(self.ed.Length, (50 - undos) * 10000)
+		self.ed.Redo()
+		self.assertEquals(self.ed.Length, (51 - undos) * 10000)
+		self.ed.UndoMemoryLimit = 0
+
+	def testUndoMemoryLimitAfterManyActions(self):
+		# Many small actions grow the action array past the limit, then once they
+		# have been dropped there is room again for larger actions
+		self.ed.UndoMemoryLimit = 100000
+		for i in range(20000):
+			self.ed.BeginUndoAction()
+			self.ed.AddText(1, b"x")
+			self.ed.EndUndoAction()
+		data = b"y" * 1000
+		for i in range(20):
+			self.ed.BeginUndoAction()
+			self.ed.AddText(len(data), data)
+			self.ed.EndUndoAction()
+		self.assertEquals(self.ed.Length, 40000)
+		for i in range(20):
+			self.assert_(self.ed.CanUndo())
+			self.ed.Undo()
+		self.assertEquals(self.ed.Length, 20000)
+		self.ed.UndoMemoryLimit = 0
+
 	def testAddLine(self):
 		data = b"x" * 70 + b"\n"
 		for i in range(5):
@@ -272,6 +402,41 @@ class TestSimple(unittest.TestCase):
 			self.assertEquals(self.ed.Contents(), b"x" + lineEnds[lineEndType] + b"y")
 			self.assertEquals(self.ed.LineLength(0), 1 + len(lineEnds[lineEndType]))
 
+	def testConvertEOLsUndo(self):
+		self.ed.AddText(11, b"a\r\nb\rc\nd\n\re")
+		self.ed.MarkerAdd(2, 1)
+		self.ed.ConvertEOLs(self.ed.SC_EOL_LF)
+		self.assertEquals(self.ed.Contents(), b"a\nb\nc\nd\n\ne")
+		self.assertEquals(self.ed.LineCount, 6)
+		self.assertEquals(self.ed.MarkerGet(2), 2)
+		self.ed.Undo()
+		self.assertEquals(self.ed.Contents(), b"a\r\nb\rc\nd\n\re")
+		self.assertEquals(self.ed.MarkerGet(2), 2)
+		self.ed.Redo()
+		self.assertEquals(self.ed.Contents(), b"a\nb\nc\nd\n\ne")
+
+	def testConvertEOLsKeepsIndicatorAndCaret(self):
+		self.ed.AddText(12, b"a\r\nbcd\r\nef\rg")
+		self.ed.IndicatorCurrent = 8
+		self.ed.IndicatorFillRange(3, 3)
+		self.ed.SetSel(4, 9)
+		self.ed.ConvertEOLs(self.ed.SC_EOL_LF)
+		self.assertEquals(self.ed.Contents(), b"a\nbcd\nef\ng")
+		self.assertEquals(self.ed.IndicatorStart(8, 3), 2)
+		self.assertEquals(self.ed.IndicatorEnd(8, 3), 5)
+		self.assertEquals(self.ed.Anchor, 3)
+		self.assertEquals(self.ed.CurrentPos, 7)
+		self.ed.Undo()
+		self.assertEquals(self.ed.Contents(), b"a\r\nbcd\r\nef\rg")
+		self.assertEquals(self.ed.IndicatorStart(8, 4), 3)
+		self.assertEquals(self.ed.IndicatorEnd(8, 4), 6)
+		self.assertEquals(self.ed.Anchor, 4)
+		self.assertEquals(self.ed.CurrentPos, 9)
+		self.ed.Redo()
+		self.assertEquals(self.ed.IndicatorStart(8, 3), 2)
+		self.assertEquals(self.ed.IndicatorEnd(8, 3), 5)
+		self.assertEquals(self.ed.CurrentPos, 7)
+
 	def testGoto(self):
 		self.ed.AddText(5, b"a\nb\nc")
 		self.assertEquals(self.ed.CurrentPos, 5)
@@ -343,6 +508,46 @@ class TestSimple(unittest.TestCase):
 		self.assertEquals(self.ed.TargetStart, 4)
 		self.assertEquals(self.ed.TargetEnd, 5)
 
+	def testSearchAcrossGap(self):
+		text = b"xy" * 100000 + b"Needle in a haystack" + b"xy" * 100000
+		self.ed.SetText(len(text), text)
+		# Split the needle with the gap by inserting then deleting inside it
+		self.ed.InsertText(200003, b"q")
+		self.ed.TargetStart = 200003
+		self.ed.TargetEnd = 200004
+		self.ed.ReplaceTarget(0, b"")
+		searchString = b"needle IN a haystack"
+		for flags in [0, self.ed.SCFIND_MATCHCASE]:
+			self.ed.SearchFlags = flags
+			expected = -1 if flags else 200000
+			self.ed.TargetStart = 0
+			self.ed.TargetEnd = self.ed.Length
+			self.assertEquals(self.ed.SearchInTarget(len(searchString), searchString), expected)
+			self.ed.TargetStart = self.ed.Length
+			self.ed.TargetEnd = 0
+			self.assertEquals(self.ed.SearchInTarget(len(searchString), searchString), expected)
+		self.ed.SearchFlags = 0
+
+	def testSearchAllInTarget(self):
+		self.ed.SetText(0, b"one Two one two twos")
+		self.ed.IndicatorCurrent = 8
+		self.ed.IndicatorValue = 3
+		self.ed.TargetStart = 4
+		self.ed.TargetEnd = self.ed.Length
+		self.ed.SearchFlags = 0
+		self.assertEquals(self.ed.CountInTarget(3, b"two"), 3)
+		self.assertEquals(self.ed.TargetStart, 4)
+		self.assertEquals(self.ed.TargetEnd, self.ed.Length)
+		self.assertEquals(self.ed.IndicatorValueAt(8, 4), 0)
+		self.ed.SearchFlags = self.ed.SCFIND_MATCHCASE | self.ed.SCFIND_WHOLEWORD
+		self.assertEquals(self.ed.SearchAllInTarget(3, b"two"), 1)
+		self.assertEquals(self.ed.IndicatorValueAt(8, 4), 0)
+		self.assertEquals(self.ed.IndicatorValueAt(8, 12), 3)
+		self.assertEquals(self.ed.IndicatorStart(8, 13), 12)
+		self.assertEquals(self.ed.IndicatorEnd(8, 13), 15)
+		self.ed.SearchFlags = 0
+		self.assertEquals(self.ed.CountInTarget(0, b""), 0)
+
 	def testTargetEscape(self):
 		# Checks that a literal \ can be in the replacement. Bug #2959876
 		self.ed.SetText(0, b"abcd")
@@ -679,6 +884,26 @@ class TestMarkers(unittest.TestCase):
 		self.assertEquals(self.ed.MarkerPrevious(1, 2), 0)
 		self.assertEquals(self.ed.MarkerPrevious(2, 2), 2)
 
+	def testMarkerNextAfterEdits(self):
+		h1 = self.ed.MarkerAdd(1,1)
+		h2 = self.ed.MarkerAdd(2,3)
+		self.ed.InsertText(0, b"a\nb\n")
+		self.assertEquals(self.ed.MarkerLineFromHandle(h1), 3)
+		self.assertEquals(self.ed.MarkerLineFromHandle(h2), 4)
+		self.assertEquals(self.ed.MarkerNext(0, 2), 3)
+		self.assertEquals(self.ed.MarkerNext(0, 8), 4)
+		self.assertEquals(self.ed.MarkerNext(4, 2), -1)
+		self.assertEquals(self.ed.MarkerPrevious(10, 10), 4)
+		# Deleting a line end combines the marks of both lines
+		self.ed.TargetStart = self.ed.PositionFromLine(4) - 1
+		self.ed.TargetEnd = self.ed.PositionFromLine(4)
+		self.ed.ReplaceTarget(0, b"")
+		self.assertEquals(self.ed.MarkerLineFromHandle(h2), 3)
+		self.assertEquals(self.ed.MarkerGet(3), 10)
+		self.assertEquals(self.ed.MarkerNext(0, 8), 3)
+		self.assertEquals(self.ed.MarkerPrevious(10, 2), 3)
+		self.assertEquals(self.ed.MarkerAdd(0, 32), -1)
+
 	def testLineState(self):
 		self.assertEquals(self.ed.MaxLineState, 0)
 		self.assertEquals(self.ed.GetLineState(0), 0)
@@ -690,6 +915,16 @@ class TestMarkers(unittest.TestCase):
 		self.assertEquals(self.ed.GetLineState(1), 100)
 		self.assertEquals(self.ed.GetLineState(2), 0)
 
+	def testIdleStyling(self):
+		self.assertEquals(self.ed.IdleStyling, self.ed.SC_IDLESTYLING_NONE)
+		self.ed.IdleStyling = self.ed.SC_IDLESTYLING_ALL
+		self.assertEquals(self.ed.IdleStyling, self.ed.SC_IDLESTYLING_ALL)
+		data = b"x = 1\n" * 10000
+		self.ed.AddText(len(data), data)
+		self.xite.DoEvents()
+		self.ed.IdleStyling = self.ed.SC_IDLESTYLING_NONE
+		self.assertEquals(self.ed.IdleStyling, self.ed.SC_IDLESTYLING_NONE)
+
 	def testSymbolRetrieval(self):
 		self.ed.MarkerDefine(1,3)
 		self.assertEquals(self.ed.MarkerSymbolDefined(1), 3)
@@ -710,6 +945,38 @@ class TestIndicators(unittest.TestCase):
 		self.assertEquals(self.ed.IndicGetStyle(0), 2)
 		self.assertEquals(self.ed.IndicGetFore(0), 0xff0080)
 
+	def testIndicatorFill(self):
+		self.ed.InsertText(0, b"abcdefghijkl")
+		self.ed.IndicatorCurrent = 8
+		self.ed.IndicatorValue = 1
+		self.ed.IndicatorFillRange(2, 3)
+		self.ed.IndicatorValue = 2
+		self.ed.IndicatorFillRange(5, 2)
+		self.ed.IndicatorCurrent = 9
+		self.ed.IndicatorFillRange(4, 4)
+		# Adjacent runs with different values stay separate
+		self.assertEquals(self.ed.IndicatorValueAt(8, 4), 1)
+		self.assertEquals(self.ed.IndicatorValueAt(8, 5), 2)
+		self.assertEquals(self.ed.IndicatorStart(8, 5), 5)
+		self.assertEquals(self.ed.IndicatorEnd(8, 4), 5)
+		self.assertEquals(self.ed.IndicatorAllOnFor(4), (1 << 8) | (1 << 9))
+		self.assertEquals(self.ed.IndicatorAllOnFor(1), 0)
+		# Text inserted inside a run is covered but not text at its start or end
+		self.ed.InsertText(3, b"x")
+		self.assertEquals(self.ed.IndicatorValueAt(8, 3), 1)
+		self.ed.InsertText(2, b"x")
+		self.assertEquals(self.ed.IndicatorValueAt(8, 2), 0)
+		self.assertEquals(self.ed.IndicatorStart(8, 4), 3)
+		self.assertEquals(self.ed.IndicatorEnd(9, 6), 10)
+		self.ed.InsertText(10, b"x")
+		self.assertEquals(self.ed.IndicatorValueAt(9, 10), 0)
+		self.ed.IndicatorClearRange(0, self.ed.Length)
+		self.assertEquals(self.ed.IndicatorAllOnFor(8), 1 << 8)
+		self.ed.IndicatorCurrent = 8
+		self.ed.IndicatorClearRange(0, self.ed.Length)
+		self.assertEquals(self.ed.IndicatorAllOnFor(8), 0)
+		self.assertEquals(self.ed.IndicatorEnd(8, 0), 0)
+
 class TestScrolling(unittest.TestCase):
 
 	def setUp(self):
@@ -733,6 +1000,19 @@ class TestScrolling(unittest.TestCase):
 		self.ed.FirstVisibleLine = 7
 		self.assertEquals(self.ed.FirstVisibleLine, 7)
 
+	def testPositionCacheStatistics(self):
+		self.ed.PositionCache = 0x400
+		self.assertEquals(self.ed.PositionCache, 0x400)
+		self.assertEquals(self.ed.GetPositionCacheStatistic(self.ed.SC_POSITIONCACHE_HITS), 0)
+		self.assertEquals(self.ed.GetPositionCacheStatistic(self.ed.SC_POSITIONCACHE_MISSES), 0)
+		self.assertEquals(self.ed.GetPositionCacheStatistic(self.ed.SC_POSITIONCACHE_ENTRIES), 0)
+		# Identical lines are measured once then found in the cache when painted
+		self.ed.InsertText(0, b"xyzzy\n" * 100)
+		self.xite.DoEvents()
+		self.assert_(self.ed.GetPositionCacheStatistic(self.ed.SC_POSITIONCACHE_HITS) > 0)
+		entries = self.ed.GetPositionCacheStatistic(self.ed.SC_POSITIONCACHE_ENTRIES)
+		self.assert_(0 < entries < 0x400)
+
 class TestSearch(unittest.TestCase):
 
 	def setUp(self):
@@ -804,6 +1084,63 @@ class TestSearch(unittest.TestCase):
 		self.assertEquals(0, self.ed.FindBytes(0, self.ed.Length, "\S", flags))
 		self.assertEquals(2, self.ed.FindBytes(0, self.ed.Length, "\x62", flags))
 
+	def testREClosureTags(self):
+		# Closures are greedy but give back what the rest of the pattern needs
+		text = b"xaaabb aab"
+		self.ed.SetText(len(text), text)
+		self.ed.SearchFlags = self.ed.SCFIND_REGEXP
+		for searchString, start, end, tags in [
+			(b"\(a*\)\(a*b\)", 1, 5, [b"aaa", b"b"]),
+			(b"\(a*\)\(a*b\)\>", 5, 6, [b"", b"b"]),
+			(b"\(a.*\)\(a*b\)", 1, 10, [b"aaabb aa", b"b"])]:
+			self.ed.TargetStart = 0
+			self.ed.TargetEnd = self.ed.Length
+			self.assertEquals(start, self.ed.SearchInTarget(len(searchString), searchString))
+			self.assertEquals(end, self.ed.TargetEnd)
+			for tag in range(len(tags)):
+				tagString = b"\0" * 20
+				lenTag = self.ed.GetTag(tag + 1, tagString)
+				self.assertEquals(tagString[:lenTag], tags[tag])
+		# Nested closures on a long line take linear time when there is no match
+		text = b"a" * 100000
+		self.ed.SetText(len(text), text)
+		searchString = b"a*a*a*a*c"
+		self.ed.TargetStart = 0
+		self.ed.TargetEnd = self.ed.Length
+		self.assertEquals(-1, self.ed.SearchInTarget(len(searchString), searchString))
+		self.ed.SearchFlags = 0
+
+	def testREBackward(self):
+		text = b"ab ab\nab ab"
+		self.ed.SetText(len(text), text)
+		flags = self.ed.SCFIND_REGEXP
+		self.assertEquals(9, self.ed.FindBytes(self.ed.Length, 0, b"a", flags))
+		self.assertEquals(3, self.ed.FindBytes(6, 0, b"a", flags))
+		# Line and word starts are only found where they are when searching forwards
+		self.assertEquals(6, self.ed.FindBytes(self.ed.Length, 0, b"^.", flags))
+		self.assertEquals(9, self.ed.FindBytes(self.ed.Length, 0, b"\<.", flags))
+		self.assertEquals(-1, self.ed.FindBytes(self.ed.Length, 0, b"\<b", flags))
+		# The last match is found however many matches precede it on the line
+		text = b"a" * 5000
+		self.ed.SetText(len(text), text)
+		self.assertEquals(4999, self.ed.FindBytes(self.ed.Length, 0, b"a", flags))
+		self.assertEquals(4998, self.ed.FindBytes(self.ed.Length, 0, b"a\(a\)", flags))
+
+	def testRECache(self):
+		flags = self.ed.SCFIND_REGEXP
+		hits = self.ed.RegexCacheHits
+		misses = self.ed.RegexCacheMisses
+		self.assertEquals(2, self.ed.FindBytes(0, self.ed.Length, b"bi*g", flags))
+		self.assertEquals(2, self.ed.FindBytes(0, self.ed.Length, b"bi*g", flags))
+		self.assertEquals(-1, self.ed.FindBytes(0, self.ed.Length, b"BI*G", flags | self.ed.SCFIND_MATCHCASE))
+		self.assertEquals(hits + 1, self.ed.RegexCacheHits)
+		self.assertEquals(misses + 2, self.ed.RegexCacheMisses)
+		# Changing the word characters is seen by patterns compiled before
+		self.assertEquals(-1, self.ed.FindBytes(0, self.ed.Length, b"\w\w\w\w\w", flags))
+		self.ed.WordChars = b"abcdefghijklmnopqrstuvwxyz "
+		self.assertEquals(2, self.ed.FindBytes(0, self.ed.Length, b"\w\w\w\w\w", flags))
+		self.ed.SetCharsDefault()
+
 class TestProperties(unittest.TestCase):
 
 	def setUp(self):
@@ -991,6 +1328,25 @@ class TestMultiSelection(unittest.TestCase):
 		self.ed.RotateSelection()
 		self.assertEquals(self.ed.MainSelection, 1)
 
+	def testSelectionsMovedByEdits(self):
+		# Selections added out of document order move with text changes before them
+		self.ed.SetSelection(9, 10)
+		self.ed.AddSelection(1, 2)
+		self.ed.AddSelection(5, 6)
+		self.ed.InsertText(0, b"ab")
+		self.assertEquals(self.ed.GetSelectionNStart(0), 11)
+		self.assertEquals(self.ed.GetSelectionNStart(1), 3)
+		self.assertEquals(self.ed.GetSelectionNStart(2), 7)
+		self.ed.TargetStart = 2
+		self.ed.TargetEnd = 6
+		self.ed.ReplaceTarget(0, b"")
+		self.assertEquals(self.ed.GetSelectionNStart(0), 7)
+		self.assertEquals(self.ed.GetSelectionNEnd(0), 8)
+		self.assertEquals(self.ed.GetSelectionNStart(1), 2)
+		self.assertEquals(self.ed.GetSelectionNEnd(1), 2)
+		self.assertEquals(self.ed.GetSelectionNStart(2), 3)
+		self.assertEquals(self.ed.GetSelectionNEnd(2), 4)
+
 	def testRectangularSelection(self):
 		self.ed.RectangularSelectionAnchor = 1
 		self.assertEquals(self.ed.RectangularSelectionAnchor, 1)
@@ -1191,6 +1547,33 @@ class TestCaseInsensitiveSearch(unittest.TestCase):
 		self.assertEquals(firstPosition, pos)
 		self.assertEquals(firstPosition+1, self.ed.TargetEnd)
 
+	def testUTFBackward(self):
+		self.ed.SetCodePage(65001)
+		text = ("Frånd Åå " + "xy" * 1000 + " åÅ xy").encode("UTF-8")
+		searchString = "å".encode("UTF-8")
+		self.ed.SetText(len(text), text)
+		self.ed.SearchFlags = 0
+		self.ed.TargetStart = self.ed.Length
+		self.ed.TargetEnd = 0
+		pos = self.ed.SearchInTarget(len(searchString), searchString)
+		self.assertEquals(len(text) - 5, pos)
+		self.ed.TargetStart = len(text) - 8
+		self.ed.TargetEnd = 0
+		pos = self.ed.SearchInTarget(len(searchString), searchString)
+		self.assertEquals(9, pos)
+
+	def testUTFBackwardFromInsideCharacter(self):
+		# The range starts inside "é" so is empty once moved to the start of the character
+		self.ed.SetCodePage(65001)
+		text = b"\xc3\xa9xyz"
+		searchString = b"abc"
+		self.ed.SetText(len(text), text)
+		self.ed.SearchFlags = 0
+		self.ed.TargetStart = 1
+		self.ed.TargetEnd = 0
+		pos = self.ed.SearchInTarget(len(searchString), searchString)
+		self.assertEquals(-1, pos)
+
 class TestLexer(unittest.TestCase):
 	def setUp(self):
 		self.xite = XiteWin.xiteFrame
@@ -70,6 +70,14 @@ CXXFLAGS=$(CXXFLAGS) $(NOLOGO)
 LDFLAGS=$(LDFLAGS) $(NOLOGO)
 !ENDIF
 
+!IFDEF LARGE_FILE_SUPPORT
+CXXFLAGS=$(CXXFLAGS) -DSCI_LARGE_FILE_SUPPORT
+!ENDIF
+
+!IFDEF LINE_INDEX_BLOCKED
+CXXFLAGS=$(CXXFLAGS) -DSCI_LINE_INDEX_BLOCKED
+!ENDIF
+
 !IFDEF DEBUG
 CXXFLAGS=$(CXXFLAGS) $(CXXDEBUG)
 LDFLAGS=$(LDDEBUG) $(LDFLAGS)